@@ -35,17 +35,28 @@ struct DMFileInfo {
     uint64_t fileSize;
     uint64_t modifyTime;
     bool isDirectory;
+    bool hasMetadata;   // fileSize/modifyTime 是否已加载 (延迟元数据模式)
     
-    DMFileInfo() : fileSize(0), modifyTime(0), isDirectory(false) {}
+    DMFileInfo() : fileSize(0), modifyTime(0), isDirectory(false), hasMetadata(false) {}
 };
 
 typedef std::vector<DMFileInfo> DMFileList;
 typedef std::vector<std::string> DMStringList;
 
+// 索引的构建进度, 首次构建过程中发布的部分索引 complete 为 false
+struct DMIndexProgress {
+    bool complete;
+    uint64_t crawledDirs;   // 已遍历的目录数
+    uint64_t pendingDirs;   // 已发现但尚未遍历的目录数
+    
+    DMIndexProgress() : complete(true), crawledDirs(0), pendingDirs(0) {}
+};
+
 // 搜索选项
 struct DMSearchOptions {
     bool caseSensitive;
     bool wholeWord;
+    bool prefixMatch;   // 名称以模式开头
     bool useRegex;
     bool searchInPath;
     bool includeHidden;
@@ -53,7 +64,7 @@ struct DMSearchOptions {
     bool filesOnly;
     uint32_t maxResults;
     
-    DMSearchOptions() : caseSensitive(false), wholeWord(false), useRegex(false), 
+    DMSearchOptions() : caseSensitive(false), wholeWord(false), prefixMatch(false), useRegex(false),
                        searchInPath(false), includeHidden(false), dirsOnly(false),
                        filesOnly(false), maxResults(1000) {}
 };
@@ -73,13 +84,36 @@ struct DMConfigFilters {
     std::set<std::string> excludeExtensions;
     std::set<std::string> includeExtensions;
     std::set<std::string> excludeDirectories;
+    bool useIgnoreFiles = false;    // 遵循 .gitignore/.ignore/.esignore
+    // 遍历时跳过的文件系统类型 (挂载点), 默认为伪文件系统
+    std::set<std::string> excludeFsTypes = {
+        "proc", "sysfs", "devtmpfs", "devpts", "tmpfs", "cgroup", "cgroup2",
+        "securityfs", "debugfs", "tracefs", "pstore", "bpf", "configfs",
+        "fusectl", "mqueue", "hugetlbfs", "autofs", "binfmt_misc",
+        "rpc_pipefs", "nsfs", "efivarfs", "selinuxfs",
+    };
 };
 
 struct DMConfigIndex {
     bool autoSave = true;
     std::string indexFile = "~/.es_index.dat";
     bool autoLoad = true;
-    uint32_t rebuildInterval = 3600; // 秒
+    uint32_t rebuildInterval = 3600; // 仅监视模式使用: 每隔多少秒增量刷新一次, 0 表示不刷新
+    uint32_t crawlThreads = 0;       // 索引线程数, 0 表示使用CPU核心数
+    uint32_t deviceThreads = 0;      // 同一设备上同时遍历的线程数上限, 0 表示不限制
+    uint32_t networkFsThreads = 0;   // 网络/FUSE 挂载上同时遍历的线程数上限, 0 表示同 deviceThreads
+    bool oneFileSystem = false;      // 不跨越文件系统 (比较 st_dev)
+    bool lazyMetadata = false;       // 只索引名称和类型, 大小和修改时间按需加载
+    bool batchStat = false;          // 遍历后批量采集元数据 (Linux 上使用 io_uring)
+    uint32_t statQueueDepth = 256;   // 批量采集的队列深度
+    uint32_t watchBatchMs = 200;     // 监视模式下合并文件变更的时间窗口 (毫秒)
+    std::string watchBackend = "inotify";   // 监视后端: inotify, fanotify, poll
+    uint32_t watchPollInterval = 60; // poll 后端比较目录时间戳的间隔 (秒)
+    uint32_t progressiveInterval = 1000;    // 首次构建时发布部分索引的间隔 (毫秒), 0 表示构建完成后才可搜索
+    std::vector<std::string> priorityDirectories;   // 优先遍历的目录, 首次构建时最先可搜索
+    uint32_t checkpointInterval = 60;   // 完整构建时写检查点的间隔 (秒), 0 表示不写
+    std::string checkpointFile;         // 检查点文件, 为空时不写; 构建中断后以相同根路径和过滤条件重建时从此处继续
+    std::string searchEngine = "auto";  // 子串搜索引擎: scan (扫描名称区), trigram (三元组倒排索引), suffix (名称后缀数组), auto (按索引大小选择 scan 或 trigram)
 };
 
 struct DMConfigData {
@@ -118,9 +152,20 @@ public:
     // 索引管理
     virtual void DMAPI ClearIndex() = 0;
     virtual uint32_t DMAPI GetIndexedFileCount() = 0;
+    virtual void DMAPI PrintIndexStats() = 0;
     virtual bool DMAPI SaveIndex(const std::string& indexFile) = 0;
     virtual bool DMAPI LoadIndex(const std::string& indexFile) = 0;
     
+    // 监视模式: 监听文件系统变更并增量更新索引
+    virtual bool DMAPI StartWatch() = 0;
+    virtual void DMAPI StopWatch() = 0;
+    // 增量刷新: 只 stat 目录, 重新列出时间戳变化的目录并就地更新索引
+    virtual bool DMAPI Refresh() = 0;
+    // 索引每次构建、加载或增量更新后递增
+    virtual uint64_t DMAPI GetIndexGeneration() = 0;
+    // 当前可搜索的索引的构建进度
+    virtual DMIndexProgress DMAPI GetIndexProgress() = 0;
+    
     // 过滤器
     virtual void DMAPI AddIncludeExtension(const std::string& extension) = 0;
     virtual void DMAPI AddExcludeExtension(const std::string& extension) = 0;
@@ -131,6 +176,10 @@ public:
     virtual void DMAPI SetSearchOptions(const DMSearchOptions& options) = 0;
     virtual DMSearchOptions DMAPI GetSearchOptions() = 0;
     
+    // 配置设置 (命令行可覆盖配置文件中的选项)
+    virtual void DMAPI SetConfig(const DMConfigData& config) = 0;
+    virtual DMConfigData DMAPI GetConfig() = 0;
+    
     // 结果处理
     virtual void DMAPI PrintResults(const DMFileList& results) = 0;
     virtual void DMAPI SortResults(DMFileList& results, const std::string& sortBy) = 0;
@@ -0,0 +1,216 @@
+﻿// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "libdmfilesearch_checkpoint.h"
+#include "libdmfilesearch_serialize.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace fs = std::filesystem;
+
+static const uint32_t DM_CHECKPOINT_MAGIC = 0x4B434D44;     // "DMCK"
+static const uint32_t DM_CHECKPOINT_VERSION = 1;
+static const uint32_t DM_CHECKPOINT_SEGMENT = 0x4753434D;   // "MCSG", 段开始
+static const uint32_t DM_CHECKPOINT_SEGMENT_END = 0x4445434D;   // "MCED", 段结束
+
+DMCrawlCheckpoint::DMCrawlCheckpoint(const std::string& file, const std::string& signature)
+    : m_file(file), m_signature(signature) {
+}
+
+// 读取一段, 任何字段不完整都视为该段无效
+static bool DMReadSegment(std::istream& is, std::vector<DMFileInfo>& entries, DMCheckpointSegment& segment) {
+    uint32_t marker = 0;
+    if (!DMReadValue(is, marker) || marker != DM_CHECKPOINT_SEGMENT) {
+        return false;
+    }
+
+    uint32_t count = 0;
+    if (!DMReadValue(is, count)) {
+        return false;
+    }
+    entries.resize(count);
+    for (auto& fileInfo : entries) {
+        if (!DMReadFileInfo(is, fileInfo)) {
+            return false;
+        }
+    }
+
+    if (!DMReadValue(is, count)) {
+        return false;
+    }
+    segment.dirStamps.resize(count);
+    for (auto& dirStamp : segment.dirStamps) {
+        if (!DMReadString(is, dirStamp.first) || !DMReadValue(is, dirStamp.second.mtime) ||
+            !DMReadValue(is, dirStamp.second.ctime)) {
+            return false;
+        }
+    }
+
+    if (!DMReadValue(is, count)) {
+        return false;
+    }
+    segment.visited.resize(count);
+    for (auto& key : segment.visited) {
+        if (!DMReadValue(is, key.device) || !DMReadValue(is, key.inode)) {
+            return false;
+        }
+    }
+
+    if (!DMReadValue(is, count)) {
+        return false;
+    }
+    segment.mounts.resize(count);
+    for (auto& mount : segment.mounts) {
+        if (!DMReadString(is, mount.mountPoint) || !DMReadString(is, mount.fsType) ||
+            !DMReadValue(is, mount.device) || !DMReadValue(is, mount.entryCount)) {
+            return false;
+        }
+    }
+
+    if (!DMReadValue(is, count)) {
+        return false;
+    }
+    segment.frontier.resize(count);
+    for (auto& path : segment.frontier) {
+        if (!DMReadString(is, path)) {
+            return false;
+        }
+    }
+
+    return DMReadValue(is, marker) && marker == DM_CHECKPOINT_SEGMENT_END;
+}
+
+bool DMCrawlCheckpoint::Load(DMFileTable& fileIndex, DMCheckpointSegment& state) {
+    m_validSize = 0;
+    std::ifstream ifs(m_file, std::ios::binary);
+    if (!ifs) {
+        return false;
+    }
+
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    std::string signature;
+    if (!DMReadValue(ifs, magic) || magic != DM_CHECKPOINT_MAGIC || !DMReadValue(ifs, version) ||
+        version != DM_CHECKPOINT_VERSION || !DMReadString(ifs, signature) || signature != m_signature) {
+        return false;
+    }
+    uint64_t validSize = static_cast<uint64_t>(ifs.tellg());
+
+    bool loaded = false;
+    for (;;) {
+        std::vector<DMFileInfo> entries;
+        DMCheckpointSegment segment;
+        if (!DMReadSegment(ifs, entries, segment)) {
+            break;
+        }
+        for (const auto& fileInfo : entries) {
+            fileIndex.Append(fileInfo);
+        }
+        std::move(segment.dirStamps.begin(), segment.dirStamps.end(), std::back_inserter(state.dirStamps));
+        state.visited.insert(state.visited.end(), segment.visited.begin(), segment.visited.end());
+        state.mounts = std::move(segment.mounts);
+        state.frontier = std::move(segment.frontier);
+        validSize = static_cast<uint64_t>(ifs.tellg());
+        loaded = true;
+    }
+    ifs.close();
+
+    if (!loaded) {
+        return false;
+    }
+    // 截掉不完整的最后一段, 之后的段接着追加
+    std::error_code ec;
+    fs::resize_file(m_file, validSize, ec);
+    if (ec) {
+        return false;
+    }
+    m_validSize = validSize;
+    return true;
+}
+
+bool DMCrawlCheckpoint::Append(const DMFileTable& fileIndex, size_t firstEntry,
+    const DMCheckpointSegment& segment) {
+    std::ofstream ofs;
+    if (m_validSize == 0) {
+        ofs.open(m_file, std::ios::binary | std::ios::trunc);
+        DMWriteValue(ofs, DM_CHECKPOINT_MAGIC);
+        DMWriteValue(ofs, DM_CHECKPOINT_VERSION);
+        DMWriteString(ofs, m_signature);
+    } else {
+        ofs.open(m_file, std::ios::binary | std::ios::app);
+    }
+    if (!ofs) {
+        return false;
+    }
+
+    DMWriteValue(ofs, DM_CHECKPOINT_SEGMENT);
+    DMWriteValue(ofs, static_cast<uint32_t>(fileIndex.size() - firstEntry));
+    for (size_t i = firstEntry; i < fileIndex.size(); ++i) {
+        DMWriteFileInfo(ofs, fileIndex.Get(static_cast<uint32_t>(i)));
+    }
+
+    DMWriteValue(ofs, static_cast<uint32_t>(segment.dirStamps.size()));
+    for (const auto& dirStamp : segment.dirStamps) {
+        DMWriteString(ofs, dirStamp.first);
+        DMWriteValue(ofs, dirStamp.second.mtime);
+        DMWriteValue(ofs, dirStamp.second.ctime);
+    }
+
+    DMWriteValue(ofs, static_cast<uint32_t>(segment.visited.size()));
+    for (const auto& key : segment.visited) {
+        DMWriteValue(ofs, key.device);
+        DMWriteValue(ofs, key.inode);
+    }
+
+    DMWriteValue(ofs, static_cast<uint32_t>(segment.mounts.size()));
+    for (const auto& mount : segment.mounts) {
+        DMWriteString(ofs, mount.mountPoint);
+        DMWriteString(ofs, mount.fsType);
+        DMWriteValue(ofs, mount.device);
+        DMWriteValue(ofs, mount.entryCount);
+    }
+
+    DMWriteValue(ofs, static_cast<uint32_t>(segment.frontier.size()));
+    for (const auto& path : segment.frontier) {
+        DMWriteString(ofs, path);
+    }
+
+    DMWriteValue(ofs, DM_CHECKPOINT_SEGMENT_END);
+    ofs.flush();
+    if (!ofs) {
+        // 写入失败时去掉残缺的段, 下次从上一个完整段之后继续
+        ofs.close();
+        std::error_code ec;
+        if (m_validSize > 0) {
+            fs::resize_file(m_file, m_validSize, ec);
+        }
+        return false;
+    }
+    m_validSize = static_cast<uint64_t>(ofs.tellp());
+    return true;
+}
+
+void DMCrawlCheckpoint::Remove() {
+    std::error_code ec;
+    fs::remove(m_file, ec);
+    m_validSize = 0;
+}
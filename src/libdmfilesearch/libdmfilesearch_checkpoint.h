@@ -0,0 +1,62 @@
+// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef __LIBDMFILESEARCH_CHECKPOINT_H_INCLUDE__
+#define __LIBDMFILESEARCH_CHECKPOINT_H_INCLUDE__
+#include "dmfilesearch.h"
+#include "libdmfilesearch_crawler.h"
+#include "libdmfilesearch_filetable.h"
+#include "libdmfilesearch_mount.h"
+#include <string>
+#include <vector>
+
+// 检查点段中除索引项以外的部分
+struct DMCheckpointSegment {
+    std::vector<std::pair<std::string, DMDirStamp>> dirStamps;  // 上一段之后遍历完成的目录
+    std::vector<DMCrawlDirKey> visited;     // 上一段之后标记为已访问的目录 (多根路径去重)
+    std::vector<DMIndexMount> mounts;       // 截至本段各挂载点的累计项数
+    std::vector<std::string> frontier;      // 尚未遍历的目录
+};
+
+// 完整构建的检查点文件: 文件头记录根路径和过滤条件的签名, 之后是追加写入的段,
+// 每段包含上一段之后新增的索引项. 进程中途被杀时最后一段可能不完整, 读取时丢弃
+class DMCrawlCheckpoint
+{
+public:
+    DMCrawlCheckpoint(const std::string& file, const std::string& signature);
+
+    // 读取所有完整的段: 索引项、目录时间戳和已访问目录累加, 挂载点和待遍历目录取最后一段.
+    // 文件不存在、签名不符或没有完整的段时返回 false
+    bool Load(DMFileTable& fileIndex, DMCheckpointSegment& state);
+
+    // 追加一段, 索引项取 fileIndex 中 firstEntry 之后的部分
+    bool Append(const DMFileTable& fileIndex, size_t firstEntry, const DMCheckpointSegment& segment);
+
+    void Remove();
+
+    const std::string& File() const { return m_file; }
+
+private:
+    std::string m_file;
+    std::string m_signature;
+    uint64_t m_validSize = 0;   // 文件中最后一个完整段的结束位置, 0 表示尚未写入文件头
+};
+
+#endif
@@ -0,0 +1,1169 @@
+﻿// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <thread>
+#include <algorithm>
+#include <iterator>
+#include <chrono>
+#include <filesystem>
+#include <sstream>
+
+#include "libdmfilesearch_impl.h"
+#include "libdmfilesearch_stat.h"
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+#endif
+
+namespace fs = std::filesystem;
+
+#ifdef __linux__
+// getdents64 返回的目录项布局
+struct DMLinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+static const size_t DM_DIRENT_BUFFER_SIZE = 256 * 1024;
+#endif
+
+void DMFillFileInfo(DMFileInfo& fileInfo, bool isRegular, uint64_t fileSize, uint64_t modifyTime) {
+    fileInfo.fileSize = isRegular ? fileSize : 0;
+    fileInfo.modifyTime = modifyTime;
+    fileInfo.hasMetadata = true;
+}
+
+#ifndef _WIN32
+DMDirStamp DMDirStampFromStat(const struct stat& st) {
+    DMDirStamp stamp;
+#ifdef __APPLE__
+    stamp.mtime = static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000LL + st.st_mtimespec.tv_nsec;
+    stamp.ctime = static_cast<int64_t>(st.st_ctimespec.tv_sec) * 1000000000LL + st.st_ctimespec.tv_nsec;
+#else
+    stamp.mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+    stamp.ctime = static_cast<int64_t>(st.st_ctim.tv_sec) * 1000000000LL + st.st_ctim.tv_nsec;
+#endif
+    return stamp;
+}
+#endif
+
+void DMCrawlDeque::Push(DMCrawlItem&& item) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_items.push_back(std::move(item));
+}
+
+bool DMCrawlDeque::Pop(DMCrawlItem& item) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_items.empty()) {
+        return false;
+    }
+    item = std::move(m_items.back());
+    m_items.pop_back();
+    return true;
+}
+
+bool DMCrawlDeque::Steal(DMCrawlItem& item) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_items.empty()) {
+        return false;
+    }
+    item = std::move(m_items.front());
+    m_items.pop_front();
+    return true;
+}
+
+void DMCrawlDeque::CollectPaths(std::vector<std::string>& paths) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    for (const auto& item : m_items) {
+        paths.push_back(item.path);
+    }
+}
+
+DMCrawlContext::DMCrawlContext(uint32_t threadCount) : m_running(threadCount) {
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        workers.emplace_back(new DMCrawlWorker());
+    }
+}
+
+// path 就是 dir 或位于 dir 之下
+static bool DMIsWithin(const std::string& path, const std::string& dir) {
+    return path.size() >= dir.size() && path.compare(0, dir.size(), dir) == 0 &&
+        (path.size() == dir.size() || dir.back() == '/' || path[dir.size()] == '/');
+}
+
+void DMCrawlWorker::HandOff() {
+    if (entries.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(handoffLock);
+    handoff.Append(entries);
+    entries.clear();
+}
+
+void DMCrawlWorker::TakeHandOff(DMFileTable& fileIndex) {
+    std::lock_guard<std::mutex> lock(handoffLock);
+    fileIndex.Append(handoff);
+    handoff.clear();
+}
+
+void DMCrawlContext::Push(uint32_t workerId, DMCrawlItem&& item) {
+    ++pending;
+    if (item.priority != DM_CRAWL_NORMAL) {
+        ++priorityPending;
+        {
+            std::lock_guard<std::mutex> lock(m_priorityLock);
+            m_priorityItems.push_back(std::move(item));
+            ++m_priorityCount;
+        }
+        SignalWork(false);
+        return;
+    }
+    workers[workerId]->queue.Push(std::move(item));
+    SignalWork(false);
+}
+
+bool DMCrawlContext::Next(uint32_t workerId, DMCrawlItem& item) {
+    const size_t count = workers.size();
+    for (;;) {
+        if (m_pauseRequested.load()) {
+            Park();
+        }
+        // 先记下序号再查找, 查找期间入队的目录会改变序号, 不会错过
+        const uint64_t epoch = m_workEpoch.load();
+        if (TakeDeferred(item)) {
+            return true;
+        }
+
+        bool found = TakePriority(item) || workers[workerId]->queue.Pop(item);
+
+        // 自己的队列为空，从其他线程窃取
+        for (size_t i = 1; i < count && !found; ++i) {
+            found = workers[(workerId + i) % count]->queue.Steal(item);
+        }
+
+        if (found) {
+            if (AcquireDevice(item.device)) {
+                return true;
+            }
+            // 优先目录排在同一设备暂缓队列的前面
+            std::lock_guard<std::mutex> lock(m_deviceLock);
+            auto& deferred = m_deferred[item.device];
+            if (item.priority != DM_CRAWL_NORMAL) {
+                deferred.push_front(std::move(item));
+            } else {
+                deferred.push_back(std::move(item));
+            }
+            ++m_deferredCount;
+            continue;
+        }
+
+        // 没有任何目录在处理中，遍历结束
+        if (pending.load() == 0) {
+            {
+                std::lock_guard<std::mutex> lock(m_pauseLock);
+                --m_running;
+            }
+            m_pauseChanged.notify_all();
+            return false;
+        }
+
+        // 其他线程仍在处理目录 (或暂缓的目录所在设备已满), 等到有新目录、设备让出名额、遍历结束或要求暂停
+        std::unique_lock<std::mutex> lock(m_pauseLock);
+        ++m_idle;
+        m_workChanged.wait(lock, [&] {
+            return m_workEpoch.load() != epoch || m_pauseRequested.load() || pending.load() == 0;
+        });
+        --m_idle;
+    }
+}
+
+void DMCrawlContext::SignalWork(bool all) {
+    ++m_workEpoch;
+    if (m_idle.load() == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_pauseLock);
+    if (all) {
+        m_workChanged.notify_all();
+    } else {
+        m_workChanged.notify_one();
+    }
+}
+
+void DMCrawlContext::Done(const DMCrawlItem& item) {
+    ReleaseDevice(item.device);
+    ++crawled;
+    if (item.priority != DM_CRAWL_NORMAL) {
+        --priorityPending;
+    }
+    if (--pending == 0) {
+        {
+            std::lock_guard<std::mutex> lock(m_finishLock);
+            m_finished.notify_all();
+        }
+        SignalWork(true);
+    }
+}
+
+bool DMCrawlContext::WaitFinished(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(m_finishLock);
+    return m_finished.wait_for(lock, timeout, [this] { return pending.load() == 0; });
+}
+
+bool DMCrawlContext::Pause() {
+    std::unique_lock<std::mutex> lock(m_pauseLock);
+    m_pauseRequested = true;
+    m_workChanged.notify_all();
+    m_pauseChanged.wait(lock, [this] { return m_parked == m_running; });
+    return pending.load() > 0;
+}
+
+void DMCrawlContext::Resume() {
+    {
+        std::lock_guard<std::mutex> lock(m_pauseLock);
+        m_pauseRequested = false;
+    }
+    m_pauseChanged.notify_all();
+}
+
+void DMCrawlContext::Park() {
+    std::unique_lock<std::mutex> lock(m_pauseLock);
+    ++m_parked;
+    m_pauseChanged.notify_all();
+    m_pauseChanged.wait(lock, [this] { return !m_pauseRequested.load(); });
+    --m_parked;
+}
+
+void DMCrawlContext::CollectFrontier(std::vector<std::string>& paths) {
+    for (auto& worker : workers) {
+        worker->queue.CollectPaths(paths);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_priorityLock);
+        for (const auto& item : m_priorityItems) {
+            paths.push_back(item.path);
+        }
+    }
+    std::lock_guard<std::mutex> lock(m_deviceLock);
+    for (const auto& deferred : m_deferred) {
+        for (const auto& item : deferred.second) {
+            paths.push_back(item.path);
+        }
+    }
+}
+
+bool DMCrawlContext::TakePriority(DMCrawlItem& item) {
+    if (m_priorityCount.load() == 0) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_priorityLock);
+    if (m_priorityItems.empty()) {
+        return false;
+    }
+    item = std::move(m_priorityItems.back());
+    m_priorityItems.pop_back();
+    --m_priorityCount;
+    return true;
+}
+
+uint8_t DMCrawlContext::ClassifyPriority(const std::string& path) const {
+    uint8_t priority = DM_CRAWL_NORMAL;
+    for (const auto& dir : priorityDirs) {
+        if (DMIsWithin(path, dir)) {
+            return DM_CRAWL_PRIORITY;
+        }
+        if (DMIsWithin(dir, path)) {
+            priority = DM_CRAWL_ANCESTOR;
+        }
+    }
+    return priority;
+}
+
+uint8_t DMCrawlContext::ChildPriority(const DMCrawlItem& parent, const std::string& path) const {
+    if (parent.priority == DM_CRAWL_ANCESTOR) {
+        return ClassifyPriority(path);
+    }
+    return parent.priority;
+}
+
+uint32_t DMCrawlContext::DeviceLimit(uint64_t device) const {
+    auto it = deviceLimits.find(device);
+    return it == deviceLimits.end() ? deviceLimit : it->second;
+}
+
+bool DMCrawlContext::AcquireDevice(uint64_t device) {
+    if (deviceLimit == 0 && deviceLimits.empty()) {
+        return true;
+    }
+    uint32_t limit = DeviceLimit(device);
+    std::lock_guard<std::mutex> lock(m_deviceLock);
+    uint32_t& active = m_deviceActive[device];
+    if (limit != 0 && active >= limit) {
+        return false;
+    }
+    ++active;
+    return true;
+}
+
+void DMCrawlContext::ReleaseDevice(uint64_t device) {
+    if (deviceLimit == 0 && deviceLimits.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_deviceLock);
+        --m_deviceActive[device];
+    }
+    if (m_deferredCount.load() != 0) {
+        SignalWork(false);
+    }
+}
+
+bool DMCrawlContext::TakeDeferred(DMCrawlItem& item) {
+    if (m_deferredCount.load() == 0) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_deviceLock);
+    for (auto& deferred : m_deferred) {
+        if (deferred.second.empty()) {
+            continue;
+        }
+        uint32_t limit = DeviceLimit(deferred.first);
+        uint32_t& active = m_deviceActive[deferred.first];
+        if (limit != 0 && active >= limit) {
+            continue;
+        }
+        ++active;
+        item = std::move(deferred.second.front());
+        deferred.second.pop_front();
+        --m_deferredCount;
+        return true;
+    }
+    return false;
+}
+
+bool DMCrawlContext::MarkVisited(uint64_t device, uint64_t inode) {
+    DMCrawlDirKey key{ device, inode };
+    size_t shard = DMCrawlDirKeyHash()(key) % VISITED_SHARDS;
+    std::lock_guard<std::mutex> lock(m_visitedLock[shard]);
+    if (!m_visited[shard].insert(key).second) {
+        ++duplicates;
+        return false;
+    }
+    return true;
+}
+
+uint32_t DmfilesearchImpl::GetCrawlThreadCount() const {
+    uint32_t threadCount = m_config.index.crawlThreads;
+    if (threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    return std::max<uint32_t>(threadCount, 1);
+}
+
+void DmfilesearchImpl::BuildIndexRecursive(const std::string& directory, bool progressive,
+    DMCrawlCheckpoint* checkpoint) {
+    CrawlRoots(DMStringList{ directory }, progressive, checkpoint);
+}
+
+// 优先目录换算成各根路径下的遍历路径 (根路径 + 相对部分), 不在任何根路径下的忽略
+static void DMResolvePriorityDirs(const DMStringList& priorityDirectories, const std::vector<DMCrawlRoot>& roots,
+    std::vector<std::string>& priorityDirs) {
+    for (const auto& priorityDirectory : priorityDirectories) {
+        std::error_code ec;
+        std::string absolutePath = fs::absolute(priorityDirectory, ec).lexically_normal().string();
+        while (absolutePath.size() > 1 && absolutePath.back() == '/') {
+            absolutePath.pop_back();
+        }
+        for (const auto& root : roots) {
+            if (!DMIsWithin(absolutePath, root.absolutePath)) {
+                continue;
+            }
+            std::string dir = root.path;
+            while (dir.size() > 1 && dir.back() == '/') {
+                dir.pop_back();
+            }
+            std::string relative = absolutePath.substr(root.absolutePath.size());
+            if (!relative.empty() && relative[0] == '/' && dir.back() == '/') {
+                relative.erase(0, 1);
+            } else if (!relative.empty() && relative[0] != '/' && dir.back() != '/') {
+                dir.push_back('/');
+            }
+            priorityDirs.push_back(dir + relative);
+        }
+    }
+}
+
+// 各挂载点的索引项数累加到 mounts, 遍历结束时合并到索引, 写检查点时合并到副本
+static void DMMergeMountEntries(const DMCrawlContext& ctx, std::vector<DMIndexMount>& mounts) {
+    const auto& mountEntries = ctx.mounts.Entries();
+    for (size_t i = 0; i < mountEntries.size(); ++i) {
+        uint64_t count = 0;
+        for (const auto& worker : ctx.workers) {
+            count += worker->mountEntries[i];
+        }
+        if (count == 0) {
+            continue;
+        }
+        auto it = std::find_if(mounts.begin(), mounts.end(),
+            [&](const DMIndexMount& mount) { return mount.mountPoint == mountEntries[i].mountPoint; });
+        if (it == mounts.end()) {
+            DMIndexMount mount;
+            mount.mountPoint = mountEntries[i].mountPoint;
+            mount.fsType = mountEntries[i].fsType;
+            mount.device = mountEntries[i].device;
+            it = mounts.insert(mounts.end(), mount);
+        }
+        it->entryCount += count;
+    }
+}
+
+// progressive 为 true 或指定 checkpoint 时当前线程不参与遍历, 而是定期把已遍历部分发布为
+// 不完整的索引快照或写入检查点. 检查点中有上次中断的进度时从中恢复, 只遍历剩余的目录
+void DmfilesearchImpl::CrawlRoots(const DMStringList& rootPaths, bool progressive, DMCrawlCheckpoint* checkpoint) {
+    uint32_t threadCount = GetCrawlThreadCount();
+    DMCrawlContext ctx(threadCount);
+    ctx.deviceLimit = m_config.index.deviceThreads;
+    ctx.dedupe = rootPaths.size() > 1;
+    ctx.progressive = progressive;
+    ctx.checkpoint = checkpoint != nullptr;
+    const size_t firstNew = m_index->fileIndex.size();
+
+    // 读取挂载表, 网络挂载使用单独的并发上限
+    ctx.mounts.Load();
+    const auto& mountEntries = ctx.mounts.Entries();
+    if (m_config.index.networkFsThreads > 0) {
+        for (const auto& mount : mountEntries) {
+            if (DMMountTable::IsNetworkFs(mount.fsType)) {
+                ctx.deviceLimits[mount.device] = m_config.index.networkFsThreads;
+            }
+        }
+    }
+    for (auto& worker : ctx.workers) {
+        worker->mountEntries.assign(mountEntries.size(), 0);
+    }
+
+    // 所有根路径同时入队, 分散到各线程的队列中
+    std::vector<DMCrawlItem> rootItems;
+    DMIgnoreCache ignoreCache;
+    for (const auto& rootPath : rootPaths) {
+        DMCrawlItem item;
+        item.path = rootPath;
+        if (m_excludeMatcher.Scan(rootPath.data(), rootPath.size(), item.excludeState)) {
+            continue;
+        }
+
+        DMCrawlRoot root;
+        root.path = rootPath;
+        std::error_code ec;
+        root.absolutePath = fs::absolute(rootPath, ec).lexically_normal().string();
+        while (root.absolutePath.size() > 1 && root.absolutePath.back() == '/') {
+            root.absolutePath.pop_back();
+        }
+#ifndef _WIN32
+        struct stat st;
+        if (stat(rootPath.c_str(), &st) == 0) {
+            root.device = static_cast<uint64_t>(st.st_dev);
+        }
+#endif
+        item.device = root.device;
+        item.mountId = ctx.mounts.FindContaining(root.absolutePath);
+        item.rootId = static_cast<uint32_t>(ctx.roots.size());
+        // 增量更新时遍历的是索引根路径下的子目录, 需要继承上级目录的忽略规则
+        item.ignoreRules = LoadParentIgnoreRules(rootPath, ignoreCache);
+        ctx.roots.push_back(root);
+        rootItems.push_back(std::move(item));
+    }
+
+    // 优先目录及其上级目录进入共享的优先队列, 所有线程先遍历它们
+    DMResolvePriorityDirs(m_config.index.priorityDirectories, ctx.roots, ctx.priorityDirs);
+    for (auto& item : rootItems) {
+        std::string rootPath = item.path;
+        while (rootPath.size() > 1 && rootPath.back() == '/') {
+            rootPath.pop_back();
+        }
+        item.priority = ctx.ClassifyPriority(rootPath);
+    }
+
+    // 从检查点恢复时以其中的待遍历目录代替根路径
+    if (checkpoint && ResumeCrawl(ctx, *checkpoint, rootItems)) {
+        std::cout << "从检查点恢复: 已索引 " << m_index->fileIndex.size() << " 项，待遍历 "
+                  << rootItems.size() << " 个目录" << std::endl;
+    }
+    const size_t checkpointedEntries = m_index->fileIndex.size();
+
+    uint32_t nextWorker = 0;
+    for (auto& item : rootItems) {
+        ctx.Push(nextWorker, std::move(item));
+        nextWorker = (nextWorker + 1) % threadCount;
+    }
+
+    const bool supervised = progressive || checkpoint;
+    std::vector<std::thread> threads;
+    for (uint32_t i = supervised ? 0 : 1; i < threadCount; ++i) {
+        threads.emplace_back(&DmfilesearchImpl::CrawlWorkerLoop, this, std::ref(ctx), i);
+    }
+    if (supervised) {
+        SuperviseCrawl(ctx, checkpoint, checkpointedEntries);
+    } else {
+        CrawlWorkerLoop(ctx, 0);
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // 合并各线程的结果
+    size_t total = m_index->fileIndex.size();
+    for (const auto& worker : ctx.workers) {
+        total += worker->entries.size() + worker->handoff.size();
+    }
+    m_index->fileIndex.reserve(total);
+
+    for (auto& worker : ctx.workers) {
+        worker->TakeHandOff(m_index->fileIndex);
+        m_index->fileIndex.Append(worker->entries);
+        worker->entries = DMFileTable();
+        for (auto& dirStamp : worker->dirStamps) {
+            m_index->dirStamps[std::move(dirStamp.first)] = dirStamp.second;
+        }
+        worker->dirStamps.clear();
+    }
+    // 完整构建的结果分批追加, 容量可能远大于实际项数; 同时释放只在追加时需要的目录查找表
+    if (firstNew == 0) {
+        m_index->fileIndex.shrink_to_fit();
+    }
+
+    if (ctx.pruned.load() > 0) {
+        std::cout << "跳过被排除或隐藏的子目录树 " << ctx.pruned.load() << " 个" << std::endl;
+    }
+    if (ctx.duplicates.load() > 0) {
+        std::cout << "跳过重叠根路径中的重复目录 " << ctx.duplicates.load() << " 个" << std::endl;
+    }
+    if (ctx.skippedMounts.load() > 0) {
+        std::cout << "跳过其他文件系统的挂载点 " << ctx.skippedMounts.load() << " 个" << std::endl;
+    }
+
+    // 记录本次遍历涉及的挂载点
+    DMMergeMountEntries(ctx, m_index->mounts);
+
+    if (m_config.index.batchStat && !m_config.index.lazyMetadata) {
+        CollectMetadata(firstNew, threadCount);
+    }
+
+    // 构建已完成, 不再需要检查点
+    if (checkpoint) {
+        checkpoint->Remove();
+    }
+}
+
+// 渐进构建时每隔 progressiveInterval 取走各线程已移交的结果并发布; 每次发布都要复制已遍历部分,
+// 因此规模翻倍后才再次发布, 复制总量不超过最终索引的两倍. 优先目录遍历完时立即发布.
+// 指定 checkpoint 时每隔 checkpointInterval 写一次检查点
+void DmfilesearchImpl::SuperviseCrawl(DMCrawlContext& ctx, DMCrawlCheckpoint* checkpoint, size_t checkpointedEntries) {
+    const auto interval = std::chrono::milliseconds(m_config.index.progressiveInterval);
+    const auto checkpointInterval = std::chrono::seconds(m_config.index.checkpointInterval);
+    auto lastPublish = std::chrono::steady_clock::now();
+    auto lastCheckpoint = lastPublish;
+    size_t publishedEntries = 0;
+    bool priorityPublished = ctx.priorityDirs.empty();
+
+    while (!ctx.WaitFinished(std::chrono::milliseconds(50))) {
+        if (checkpoint && std::chrono::steady_clock::now() - lastCheckpoint >= checkpointInterval) {
+            // 写入失败 (如磁盘已满) 时本次构建不再写检查点, 已写入的部分仍可用于恢复
+            if (!WriteCrawlCheckpoint(ctx, *checkpoint, checkpointedEntries)) {
+                checkpoint = nullptr;
+            }
+            lastCheckpoint = std::chrono::steady_clock::now();
+        }
+        if (!ctx.progressive) {
+            continue;
+        }
+
+        bool priorityDone = !priorityPublished && ctx.priorityPending.load() == 0;
+        if (!priorityDone && std::chrono::steady_clock::now() - lastPublish < interval) {
+            continue;
+        }
+        for (auto& worker : ctx.workers) {
+            worker->TakeHandOff(m_index->fileIndex);
+        }
+        if (!priorityDone && m_index->fileIndex.size() < std::max<size_t>(publishedEntries * 2, 1)) {
+            continue;
+        }
+
+        std::shared_ptr<DMIndexSnapshot> partial = std::make_shared<DMIndexSnapshot>();
+        partial->fileIndex = m_index->fileIndex;
+        partial->rootPaths = m_index->rootPaths;
+        partial->progress.complete = false;
+        partial->progress.crawledDirs = ctx.crawled.load();
+        partial->progress.pendingDirs = ctx.pending.load();
+        PublishSnapshot(partial);
+
+        std::cout << (priorityDone ? "优先目录已可搜索" : "已发布部分索引") << ": " << partial->fileIndex.size()
+                  << " 项 (已遍历 " << partial->progress.crawledDirs << " 个目录，待遍历 "
+                  << partial->progress.pendingDirs << " 个)" << std::endl;
+        priorityPublished = priorityPublished || priorityDone;
+        publishedEntries = partial->fileIndex.size();
+        lastPublish = std::chrono::steady_clock::now();
+    }
+}
+
+// 检查点只在完整构建且指定了文件时启用
+std::unique_ptr<DMCrawlCheckpoint> DmfilesearchImpl::CreateCheckpoint() const {
+    if (m_config.index.checkpointInterval == 0 || m_config.index.checkpointFile.empty()) {
+        return nullptr;
+    }
+    return std::unique_ptr<DMCrawlCheckpoint>(
+        new DMCrawlCheckpoint(m_config.index.checkpointFile, CheckpointSignature()));
+}
+
+// 根路径和影响遍历结果的选项, 任何一项不同时检查点不可复用
+std::string DmfilesearchImpl::CheckpointSignature() const {
+    std::ostringstream oss;
+    auto appendSorted = [&oss](const char* name, std::vector<std::string> values) {
+        std::sort(values.begin(), values.end());
+        oss << name << "=";
+        for (const auto& value : values) {
+            oss << value << "\n";
+        }
+        oss << "\n";
+    };
+    appendSorted("roots", m_index->rootPaths);
+    appendSorted("include_extensions",
+        std::vector<std::string>(m_includeExtensions.begin(), m_includeExtensions.end()));
+    appendSorted("exclude_extensions",
+        std::vector<std::string>(m_excludeExtensions.begin(), m_excludeExtensions.end()));
+    appendSorted("exclude_directories",
+        std::vector<std::string>(m_excludeDirectories.begin(), m_excludeDirectories.end()));
+    appendSorted("exclude_fs_types", std::vector<std::string>(m_config.filters.excludeFsTypes.begin(),
+        m_config.filters.excludeFsTypes.end()));
+    oss << "include_hidden=" << m_searchOptions.includeHidden << "\n"
+        << "use_ignore_files=" << m_config.filters.useIgnoreFiles << "\n"
+        << "one_file_system=" << m_config.index.oneFileSystem << "\n"
+        << "lazy_metadata=" << m_config.index.lazyMetadata << "\n"
+        << "batch_stat=" << m_config.index.batchStat << "\n";
+    return oss.str();
+}
+
+// 调用方持有 m_indexLock. 返回 path 所在目录继承的忽略规则, 从包含它的最长的索引根路径起读取;
+// 未启用忽略文件、不在任何根路径之下或本身就是根路径时为空
+std::shared_ptr<const DMIgnoreRules> DmfilesearchImpl::LoadParentIgnoreRules(const std::string& path,
+    DMIgnoreCache& cache) const {
+    if (!m_config.filters.useIgnoreFiles) {
+        return nullptr;
+    }
+    std::string rootDir;
+    for (const auto& rootPath : m_index->rootPaths) {
+        std::string dir = rootPath;
+        while (dir.size() > 1 && dir.back() == '/') {
+            dir.pop_back();
+        }
+        if (DMIsWithin(path, dir) && dir.size() > rootDir.size()) {
+            rootDir = std::move(dir);
+        }
+    }
+    if (rootDir.empty() || path.size() <= rootDir.size()) {
+        return nullptr;
+    }
+    size_t pos = path.find_last_of('/');
+    return DMIgnoreRules::LoadChain(rootDir, pos == 0 ? std::string("/") : path.substr(0, pos), cache);
+}
+
+// 载入检查点中已遍历的结果, 并把其中的待遍历目录还原为遍历项. 遍历项中的排除状态、忽略规则、
+// 设备和挂载点都可以由路径重新推出, 因此检查点只记录路径
+bool DmfilesearchImpl::ResumeCrawl(DMCrawlContext& ctx, DMCrawlCheckpoint& checkpoint,
+    std::vector<DMCrawlItem>& items) {
+    std::error_code ec;
+    bool exists = fs::exists(checkpoint.File(), ec);
+    DMCheckpointSegment state;
+    if (!checkpoint.Load(m_index->fileIndex, state)) {
+        if (exists) {
+            std::cout << "检查点与本次构建不符或已损坏，重新开始遍历: " << checkpoint.File() << std::endl;
+        }
+        return false;
+    }
+
+    for (auto& dirStamp : state.dirStamps) {
+        m_index->dirStamps[std::move(dirStamp.first)] = dirStamp.second;
+    }
+    m_index->mounts = std::move(state.mounts);
+    for (const auto& key : state.visited) {
+        ctx.MarkVisited(key.device, key.inode);
+    }
+
+    std::vector<std::string> rootDirs;
+    for (const auto& root : ctx.roots) {
+        std::string rootDir = root.path;
+        while (rootDir.size() > 1 && rootDir.back() == '/') {
+            rootDir.pop_back();
+        }
+        rootDirs.push_back(rootDir);
+    }
+
+    DMIgnoreCache ignoreCache;
+    items.clear();
+    for (auto& path : state.frontier) {
+        DMCrawlItem item;
+        item.path = std::move(path);
+
+        // 所属根路径取最长的匹配
+        size_t rootId = ctx.roots.size();
+        for (size_t i = 0; i < ctx.roots.size(); ++i) {
+            if (DMIsWithin(item.path, rootDirs[i]) &&
+                (rootId == ctx.roots.size() || rootDirs[i].size() > rootDirs[rootId].size())) {
+                rootId = i;
+            }
+        }
+        if (rootId == ctx.roots.size() || m_excludeMatcher.Scan(item.path.data(), item.path.size(), item.excludeState)) {
+            continue;
+        }
+        const DMCrawlRoot& root = ctx.roots[rootId];
+        item.rootId = static_cast<uint32_t>(rootId);
+        item.device = root.device;
+#ifndef _WIN32
+        struct stat st;
+        if (stat(item.path.c_str(), &st) == 0) {
+            item.device = static_cast<uint64_t>(st.st_dev);
+        }
+#endif
+        item.mountId = ctx.mounts.FindContaining(root.path == root.absolutePath ? item.path :
+            root.absolutePath + item.path.substr(rootDirs[rootId].size()));
+        if (m_config.filters.useIgnoreFiles && item.path != root.path) {
+            size_t pos = item.path.find_last_of('/');
+            item.ignoreRules = DMIgnoreRules::LoadChain(rootDirs[rootId],
+                pos == 0 ? std::string("/") : item.path.substr(0, pos), ignoreCache);
+        }
+        item.priority = ctx.ClassifyPriority(item.path);
+        items.push_back(std::move(item));
+    }
+    return true;
+}
+
+// 暂停遍历, 取走已完成的结果和待遍历目录后立即恢复, 再把新增部分追加到检查点文件
+bool DmfilesearchImpl::WriteCrawlCheckpoint(DMCrawlContext& ctx, DMCrawlCheckpoint& checkpoint,
+    size_t& checkpointedEntries) {
+    auto startTime = std::chrono::high_resolution_clock::now();
+    if (!ctx.Pause()) {
+        ctx.Resume();
+        return true;
+    }
+
+    DMCheckpointSegment segment;
+    for (auto& worker : ctx.workers) {
+        worker->TakeHandOff(m_index->fileIndex);
+        m_index->fileIndex.Append(worker->entries);
+        worker->entries.clear();
+        std::move(worker->dirStamps.begin(), worker->dirStamps.end(), std::back_inserter(segment.dirStamps));
+        worker->dirStamps.clear();
+        segment.visited.insert(segment.visited.end(), worker->visited.begin(), worker->visited.end());
+        worker->visited.clear();
+    }
+    segment.mounts = m_index->mounts;
+    DMMergeMountEntries(ctx, segment.mounts);
+    ctx.CollectFrontier(segment.frontier);
+    ctx.Resume();
+    auto pauseTime = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::high_resolution_clock::now() - startTime);
+
+    bool written = checkpoint.Append(m_index->fileIndex, checkpointedEntries, segment);
+    for (auto& dirStamp : segment.dirStamps) {
+        m_index->dirStamps[std::move(dirStamp.first)] = dirStamp.second;
+    }
+    if (!written) {
+        std::cerr << "写入检查点失败: " << checkpoint.File() << std::endl;
+        return false;
+    }
+    checkpointedEntries = m_index->fileIndex.size();
+
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::high_resolution_clock::now() - startTime);
+    std::cout << "已写入检查点: " << checkpointedEntries << " 项，待遍历 " << segment.frontier.size()
+              << " 个目录 (暂停遍历 " << pauseTime.count() << "ms，共耗时 " << duration.count() << "ms)" << std::endl;
+    return true;
+}
+
+void DmfilesearchImpl::CollectMetadata(size_t firstEntry, uint32_t threadCount) {
+    if (firstEntry >= m_index->fileIndex.size()) {
+        return;
+    }
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+    DMStatBackend backend = DMCollectMetadata(m_index->fileIndex, firstEntry, m_config.index.statQueueDepth, threadCount,
+        [this](DMFileInfo& fileInfo) { LoadMetadata(fileInfo); });
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::high_resolution_clock::now() - startTime);
+
+    std::cout << "元数据采集完成 (" << (backend == DM_STAT_BACKEND_IO_URING ? "io_uring" : "线程池")
+              << ")，耗时 " << duration.count() << "ms" << std::endl;
+}
+
+// 子目录是挂载点时按文件系统策略决定是否进入; 开启 oneFileSystem 时不跨越设备.
+// deviceKnown 为 false 时 device 继承自父目录, 若为已知挂载点则替换为挂载表中的设备号.
+bool DmfilesearchImpl::ShouldEnterDirectory(DMCrawlContext& ctx, const DMCrawlItem& parent, const std::string& dirPath,
+    bool deviceKnown, uint64_t& device, uint32_t& mountId) const {
+    mountId = parent.mountId;
+    if (!deviceKnown) {
+        device = parent.device;
+    }
+
+    if (!ctx.mounts.Empty()) {
+        const DMCrawlRoot& root = ctx.roots[parent.rootId];
+        uint32_t id;
+        if (root.path == root.absolutePath) {
+            id = ctx.mounts.FindMountPoint(dirPath);
+        } else {
+            id = ctx.mounts.FindMountPoint(root.absolutePath + dirPath.substr(root.path.size()));
+        }
+
+        if (id != DMMountTable::INVALID_MOUNT) {
+            const DMMountEntry& mount = ctx.mounts.Entries()[id];
+            if (m_config.filters.excludeFsTypes.count(mount.fsType)) {
+                ++ctx.skippedMounts;
+                return false;
+            }
+            mountId = id;
+            if (!deviceKnown) {
+                device = mount.device;
+            }
+        }
+    }
+
+    if (m_config.index.oneFileSystem && device != ctx.roots[parent.rootId].device) {
+        ++ctx.skippedMounts;
+        return false;
+    }
+    return true;
+}
+
+void DmfilesearchImpl::CrawlWorkerLoop(DMCrawlContext& ctx, uint32_t workerId) {
+    DMCrawlItem item;
+    while (ctx.Next(workerId, item)) {
+        try {
+            CrawlDirectory(ctx, workerId, item);
+        } catch (const std::exception& e) {
+            std::cerr << "访问目录出错 " << item.path << ": " << e.what() << std::endl;
+        }
+        if (ctx.progressive) {
+            ctx.workers[workerId]->HandOff();
+        }
+        ctx.Done(item);
+    }
+}
+
+void DmfilesearchImpl::CrawlDirectory(DMCrawlContext& ctx, uint32_t workerId, const DMCrawlItem& item) {
+#ifdef __linux__
+    CrawlDirectoryLinux(ctx, workerId, item);
+#else
+    CrawlDirectoryGeneric(ctx, workerId, item);
+#endif
+}
+
+void DmfilesearchImpl::CrawlDirectoryGeneric(DMCrawlContext& ctx, uint32_t workerId, const DMCrawlItem& item) {
+    DMCrawlWorker& worker = *ctx.workers[workerId];
+
+    std::string directory = item.path;
+    while (directory.size() > 1 && directory.back() == '/') {
+        directory.pop_back();
+    }
+
+#ifndef _WIN32
+    struct stat dirStat;
+    if (stat(item.path.c_str(), &dirStat) == 0) {
+        if (ctx.dedupe && !ctx.MarkVisited(static_cast<uint64_t>(dirStat.st_dev), static_cast<uint64_t>(dirStat.st_ino))) {
+            return;
+        }
+        if (ctx.dedupe && ctx.checkpoint) {
+            worker.visited.push_back(DMCrawlDirKey{ static_cast<uint64_t>(dirStat.st_dev),
+                static_cast<uint64_t>(dirStat.st_ino) });
+        }
+        worker.dirStamps.emplace_back(directory, DMDirStampFromStat(dirStat));
+    }
+#else
+    DMDirStamp stamp;
+    if (ReadDirStamp(directory, stamp)) {
+        worker.dirStamps.emplace_back(directory, stamp);
+    }
+#endif
+
+    std::error_code ec;
+    fs::directory_iterator it(item.path, fs::directory_options::skip_permission_denied, ec);
+    if (ec) {
+        std::cerr << "访问目录出错 " << item.path << ": " << ec.message() << std::endl;
+        return;
+    }
+
+    std::shared_ptr<const DMIgnoreRules> ignoreRules = item.ignoreRules;
+    if (m_config.filters.useIgnoreFiles) {
+        ignoreRules = DMIgnoreRules::Load(item.ignoreRules, item.path, -1);
+    }
+
+    for (; it != fs::directory_iterator(); it.increment(ec)) {
+        if (ec) {
+            std::cerr << "访问目录出错 " << item.path << ": " << ec.message() << std::endl;
+            break;
+        }
+
+        const auto& entry = *it;
+        const auto& path = entry.path();
+        std::string pathStr = path.string();
+        std::string fileName = path.filename().string();
+
+        std::error_code typeEc;
+        bool isDirectory = entry.is_directory(typeEc);
+        // 与 recursive_directory_iterator 一致: 不跟随目录符号链接
+        bool descend = isDirectory && !entry.is_symlink(typeEc);
+
+        // 跳过隐藏文件（除非设置包含）, 被拒绝的目录整棵子树都不再打开
+        if (!m_searchOptions.includeHidden && fileName[0] == '.') {
+            if (descend) {
+                ++ctx.pruned;
+            }
+            continue;
+        }
+
+        if (isDirectory) {
+            uint32_t excludeState = DMExcludeMatcher::ROOT_STATE;
+            if (!ShouldIncludeSubdirectory(item, pathStr, fileName, ignoreRules.get(), excludeState)) {
+                if (descend) {
+                    ++ctx.pruned;
+                }
+                continue;
+            }
+            if (descend) {
+                uint64_t device = item.device;
+                bool deviceKnown = false;
+#ifndef _WIN32
+                struct stat st;
+                if (m_config.index.oneFileSystem && stat(pathStr.c_str(), &st) == 0) {
+                    device = static_cast<uint64_t>(st.st_dev);
+                    deviceKnown = true;
+                }
+#endif
+                // 被跳过的挂载点本身仍然索引, 只是不再进入
+                uint32_t mountId;
+                if (ShouldEnterDirectory(ctx, item, pathStr, deviceKnown, device, mountId)) {
+                    ctx.Push(workerId, DMCrawlItem{ pathStr, device, excludeState, ignoreRules, mountId, item.rootId,
+                        ctx.ChildPriority(item, pathStr) });
+                }
+            }
+        } else {
+            if (!ShouldIncludeFile(pathStr, fileName, ignoreRules.get())) {
+                continue;
+            }
+        }
+
+        DMFileInfo fileInfo;
+        fileInfo.fullPath = pathStr;
+        fileInfo.fileName = fileName;
+        fileInfo.directory = path.parent_path().string();
+        fileInfo.isDirectory = isDirectory;
+
+        // 延迟或批量采集元数据时只记录名称和类型
+        if (!m_config.index.lazyMetadata && !m_config.index.batchStat) {
+            DMFillFileInfo(fileInfo, !isDirectory, isDirectory ? 0 : GetFileSize(pathStr), GetFileModifyTime(pathStr));
+        }
+
+        worker.entries.Append(fileInfo);
+        if (item.mountId != DMMountTable::INVALID_MOUNT) {
+            ++worker.mountEntries[item.mountId];
+        }
+    }
+}
+
+#ifdef __linux__
+// 基于 openat/getdents64 的遍历: 目录只按路径打开一次,
+// 每个目录项最多一次相对于目录fd的 fstatat, 类型优先取自 d_type
+void DmfilesearchImpl::CrawlDirectoryLinux(DMCrawlContext& ctx, uint32_t workerId, const DMCrawlItem& item) {
+    DMCrawlWorker& worker = *ctx.workers[workerId];
+    const bool deferMetadata = m_config.index.lazyMetadata || m_config.index.batchStat;
+    const bool oneFileSystem = m_config.index.oneFileSystem;
+
+    int dirFd = open(item.path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0) {
+        if (errno != EACCES && errno != EPERM) {
+            std::cerr << "访问目录出错 " << item.path << ": " << strerror(errno) << std::endl;
+        }
+        return;
+    }
+
+    // 与 fs::path::parent_path() 保持一致, 去掉末尾多余的分隔符
+    std::string directory = item.path;
+    while (directory.size() > 1 && directory.back() == '/') {
+        directory.pop_back();
+    }
+
+    // 同一次 fstat 用于多根路径去重和记录目录时间戳 (增量刷新)
+    struct stat dirStat;
+    if (fstat(dirFd, &dirStat) == 0) {
+        if (ctx.dedupe &&
+            !ctx.MarkVisited(static_cast<uint64_t>(dirStat.st_dev), static_cast<uint64_t>(dirStat.st_ino))) {
+            close(dirFd);
+            return;
+        }
+        if (ctx.dedupe && ctx.checkpoint) {
+            worker.visited.push_back(DMCrawlDirKey{ static_cast<uint64_t>(dirStat.st_dev),
+                static_cast<uint64_t>(dirStat.st_ino) });
+        }
+        worker.dirStamps.emplace_back(directory, DMDirStampFromStat(dirStat));
+    }
+    const bool needSeparator = directory.back() != '/';
+    const uint32_t dirId = worker.entries.AddDirectory(directory, needSeparator ? '/' : 0);
+
+    std::shared_ptr<const DMIgnoreRules> ignoreRules = item.ignoreRules;
+    if (m_config.filters.useIgnoreFiles) {
+        ignoreRules = DMIgnoreRules::Load(item.ignoreRules, directory, dirFd);
+    }
+
+    if (worker.direntBuffer.size() < DM_DIRENT_BUFFER_SIZE) {
+        worker.direntBuffer.resize(DM_DIRENT_BUFFER_SIZE);
+    }
+    char* buffer = worker.direntBuffer.data();
+
+    for (;;) {
+        long bytes = syscall(SYS_getdents64, dirFd, buffer, worker.direntBuffer.size());
+        if (bytes < 0) {
+            std::cerr << "访问目录出错 " << item.path << ": " << strerror(errno) << std::endl;
+            break;
+        }
+        if (bytes == 0) {
+            break;
+        }
+
+        for (long offset = 0; offset < bytes;) {
+            const DMLinuxDirent64* dirent = reinterpret_cast<const DMLinuxDirent64*>(buffer + offset);
+            offset += dirent->d_reclen;
+
+            const char* name = dirent->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+
+            struct stat st;
+            bool hasStat = false;
+            bool statFailed = false;
+            bool isDirectory = false;
+            bool isSymlink = false;
+
+            switch (dirent->d_type) {
+            case DT_DIR:
+                isDirectory = true;
+                break;
+            case DT_LNK:
+                isSymlink = true;
+                break;
+            case DT_UNKNOWN:
+                if (fstatat(dirFd, name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+                    isSymlink = S_ISLNK(st.st_mode);
+                    isDirectory = S_ISDIR(st.st_mode);
+                    hasStat = !isSymlink;
+                }
+                break;
+            default:
+                break;
+            }
+
+            // 与 fs::directory_entry 一致: 符号链接按其目标判断类型, 但不进入
+            if (isSymlink) {
+                hasStat = fstatat(dirFd, name, &st, 0) == 0;
+                statFailed = !hasStat;
+                isDirectory = hasStat && S_ISDIR(st.st_mode);
+            }
+
+            std::string pathStr;
+            pathStr.reserve(directory.size() + 1 + strlen(name));
+            pathStr.append(directory);
+            if (needSeparator) {
+                pathStr.push_back('/');
+            }
+            pathStr.append(name);
+
+            const bool descend = isDirectory && !isSymlink;
+
+            // 跳过隐藏文件（除非设置包含）, 被拒绝的目录整棵子树都不再打开
+            if (!m_searchOptions.includeHidden && name[0] == '.') {
+                if (descend) {
+                    ++ctx.pruned;
+                }
+                continue;
+            }
+
+            std::string fileName(name);
+            if (isDirectory) {
+                uint32_t excludeState = DMExcludeMatcher::ROOT_STATE;
+                if (!ShouldIncludeSubdirectory(item, pathStr, fileName, ignoreRules.get(), excludeState)) {
+                    if (descend) {
+                        ++ctx.pruned;
+                    }
+                    continue;
+                }
+                if (descend) {
+                    // 需要元数据或不跨文件系统时提前 stat, 取得子目录真实的设备号
+                    if (!hasStat && !statFailed && (!deferMetadata || oneFileSystem)) {
+                        hasStat = fstatat(dirFd, name, &st, AT_SYMLINK_NOFOLLOW) == 0;
+                        statFailed = !hasStat;
+                    }
+                    uint64_t device = hasStat ? static_cast<uint64_t>(st.st_dev) : item.device;
+                    // 被跳过的挂载点本身仍然索引, 只是不再进入
+                    uint32_t mountId;
+                    if (ShouldEnterDirectory(ctx, item, pathStr, hasStat, device, mountId)) {
+                        ctx.Push(workerId, DMCrawlItem{ pathStr, device, excludeState, ignoreRules, mountId, item.rootId,
+                            ctx.ChildPriority(item, pathStr) });
+                    }
+                }
+            } else {
+                if (!ShouldIncludeFile(pathStr, fileName, ignoreRules.get())) {
+                    continue;
+                }
+            }
+
+            // 延迟或批量采集元数据时 d_type 已足够, 不再 stat
+            if (!hasStat && !statFailed && !deferMetadata) {
+                hasStat = fstatat(dirFd, name, &st, AT_SYMLINK_NOFOLLOW) == 0;
+                statFailed = !hasStat;
+            }
+
+            uint32_t id = worker.entries.Append(dirId, fileName, isDirectory ? DM_FILE_DIRECTORY : 0, 0, 0);
+            if (hasStat) {
+                worker.entries.FillMetadata(id, S_ISREG(st.st_mode), static_cast<uint64_t>(st.st_size),
+                    static_cast<uint64_t>(st.st_mtim.tv_sec));
+            } else if (statFailed) {
+                worker.entries.FillMetadata(id, false, 0, 0);
+            }
+
+            if (item.mountId != DMMountTable::INVALID_MOUNT) {
+                ++worker.mountEntries[item.mountId];
+            }
+        }
+    }
+
+    close(dirFd);
+}
+#endif
@@ -0,0 +1,209 @@
+// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef __LIBDMFILESEARCH_CRAWLER_H_INCLUDE__
+#define __LIBDMFILESEARCH_CRAWLER_H_INCLUDE__
+#include "dmfilesearch.h"
+#include "libdmfilesearch_filetable.h"
+#include "libdmfilesearch_ignore.h"
+#include "libdmfilesearch_mount.h"
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+// 将 stat 结果写入 DMFileInfo, 遍历和按需加载元数据共用
+void DMFillFileInfo(DMFileInfo& fileInfo, bool isRegular, uint64_t fileSize, uint64_t modifyTime);
+
+// 目录的修改时间和状态改变时间 (纳秒), 子项增删改名时都会变化
+struct DMDirStamp {
+    int64_t mtime = 0;
+    int64_t ctime = 0;
+
+    bool operator==(const DMDirStamp& other) const { return mtime == other.mtime && ctime == other.ctime; }
+    bool operator!=(const DMDirStamp& other) const { return !(*this == other); }
+};
+
+#ifndef _WIN32
+DMDirStamp DMDirStampFromStat(const struct stat& st);
+#endif
+
+// 目录与优先目录的关系
+enum DMCrawlPriority {
+    DM_CRAWL_NORMAL = 0,
+    DM_CRAWL_ANCESTOR = 1,  // 优先目录的上级目录, 先遍历才能到达优先目录
+    DM_CRAWL_PRIORITY = 2,  // 优先目录本身或其子目录
+};
+
+// 待遍历的目录
+struct DMCrawlItem {
+    std::string path;
+    uint64_t device = 0;    // 所在设备, 用于按设备限制并发
+    uint32_t excludeState = 0;  // 排除目录匹配器扫描完 path 后的状态
+    std::shared_ptr<const DMIgnoreRules> ignoreRules;   // 从父目录继承的忽略规则
+    uint32_t mountId = DMMountTable::INVALID_MOUNT;     // 所在挂载点
+    uint32_t rootId = 0;    // 所属根路径
+    uint8_t priority = DM_CRAWL_NORMAL;
+};
+
+// 根路径, 相对路径的根在查找挂载点时换算成绝对路径
+struct DMCrawlRoot {
+    std::string path;
+    std::string absolutePath;
+    uint64_t device = 0;
+};
+
+// 目录的设备号和inode, 用于多根路径去重
+struct DMCrawlDirKey {
+    uint64_t device;
+    uint64_t inode;
+
+    bool operator==(const DMCrawlDirKey& other) const {
+        return device == other.device && inode == other.inode;
+    }
+};
+
+struct DMCrawlDirKeyHash {
+    size_t operator()(const DMCrawlDirKey& key) const {
+        return std::hash<uint64_t>()(key.inode * 0x9E3779B97F4A7C15ULL ^ key.device);
+    }
+};
+
+// 工作窃取队列: 所属线程从尾部存取, 其他线程从头部窃取
+class DMCrawlDeque
+{
+public:
+    void Push(DMCrawlItem&& item);
+    bool Pop(DMCrawlItem& item);
+    bool Steal(DMCrawlItem& item);
+    void CollectPaths(std::vector<std::string>& paths);
+
+private:
+    std::mutex m_lock;
+    std::deque<DMCrawlItem> m_items;
+};
+
+// 每个遍历线程私有的队列和结果缓冲区
+struct DMCrawlWorker {
+    DMCrawlDeque queue;
+    DMFileTable entries;
+    std::vector<char> direntBuffer;     // getdents64 缓冲区, 线程内复用
+    std::vector<uint64_t> mountEntries; // 各挂载点的索引项数量
+    std::vector<std::pair<std::string, DMDirStamp>> dirStamps;  // 遍历过的目录的时间戳
+    std::vector<DMCrawlDirKey> visited; // 写检查点时新标记为已访问的目录
+
+    // 渐进构建时每遍历完一个目录就把 entries 移交出去, 由发布线程定期取走
+    std::mutex handoffLock;
+    DMFileTable handoff;
+
+    void HandOff();
+    void TakeHandOff(DMFileTable& fileIndex);
+};
+
+struct DMCrawlContext {
+    std::vector<std::unique_ptr<DMCrawlWorker>> workers;
+    std::atomic<uint64_t> pending{0};   // 已入队但尚未遍历完成的目录数
+    std::atomic<uint64_t> duplicates{0};// 因重复而跳过的目录数
+    std::atomic<uint64_t> pruned{0};    // 被排除或隐藏而整体跳过的子目录树数
+    std::atomic<uint64_t> skippedMounts{0}; // 因文件系统策略跳过的挂载点数
+    std::atomic<uint64_t> crawled{0};   // 已遍历完成的目录数
+    std::atomic<uint64_t> priorityPending{0};   // 优先目录及其上级中尚未遍历完成的目录数
+    uint32_t deviceLimit = 0;           // 同一设备上同时遍历的线程数上限, 0 表示不限制
+    std::unordered_map<uint64_t, uint32_t> deviceLimits;    // 单独设置上限的设备 (网络挂载)
+    bool dedupe = false;                // 按设备和inode去重目录 (多根路径)
+    bool progressive = false;           // 遍历线程把结果移交给发布线程 (渐进构建)
+    bool checkpoint = false;            // 记录已访问的目录, 写入检查点
+    std::vector<DMCrawlRoot> roots;
+    std::vector<std::string> priorityDirs;  // 优先目录, 已换算成与遍历路径相同的写法
+    DMMountTable mounts;
+
+    explicit DMCrawlContext(uint32_t threadCount);
+
+    void Push(uint32_t workerId, DMCrawlItem&& item);
+    bool Next(uint32_t workerId, DMCrawlItem& item);
+    void Done(const DMCrawlItem& item);
+
+    // 首次访问返回 true, 已被其他根路径访问过返回 false
+    bool MarkVisited(uint64_t device, uint64_t inode);
+
+    // 根据优先目录判断 path 的优先级; 子目录只在父目录位于优先路径上时才需要比较
+    uint8_t ClassifyPriority(const std::string& path) const;
+    uint8_t ChildPriority(const DMCrawlItem& parent, const std::string& path) const;
+
+    // 等待遍历结束, 超时返回 false
+    bool WaitFinished(std::chrono::milliseconds timeout);
+
+    // 写检查点: 让所有遍历线程在取下一个目录前停下, 此时已完成的结果和待遍历目录构成一致的切面.
+    // 遍历已经结束时返回 false
+    bool Pause();
+    void Resume();
+    // 暂停期间收集所有尚未遍历的目录
+    void CollectFrontier(std::vector<std::string>& paths);
+
+private:
+    static const size_t VISITED_SHARDS = 64;
+
+    uint32_t DeviceLimit(uint64_t device) const;
+    bool AcquireDevice(uint64_t device);
+    void ReleaseDevice(uint64_t device);
+    bool TakeDeferred(DMCrawlItem& item);
+    bool TakePriority(DMCrawlItem& item);
+    void Park();
+    // 有新的目录可取 (入队或设备让出名额) 或遍历结束时唤醒空闲的线程
+    void SignalWork(bool all);
+
+    // 优先目录不进入各线程的队列, 所有线程先处理完它们
+    std::mutex m_priorityLock;
+    std::deque<DMCrawlItem> m_priorityItems;
+    std::atomic<uint64_t> m_priorityCount{0};
+
+    std::mutex m_finishLock;
+    std::condition_variable m_finished;
+
+    std::atomic<bool> m_pauseRequested{false};
+    std::mutex m_pauseLock;
+    std::condition_variable m_pauseChanged;
+    uint32_t m_running = 0;     // 尚未退出的遍历线程数
+    uint32_t m_parked = 0;      // 已停下的遍历线程数
+
+    // 空闲线程在 m_pauseLock 上等待 m_workChanged, m_workEpoch 变化表示可能有新的目录可取
+    std::condition_variable m_workChanged;
+    std::atomic<uint64_t> m_workEpoch{0};
+    std::atomic<uint32_t> m_idle{0};
+
+    // 因设备并发已满而暂缓的目录, 按设备分组
+    std::mutex m_deviceLock;
+    std::unordered_map<uint64_t, uint32_t> m_deviceActive;
+    std::unordered_map<uint64_t, std::deque<DMCrawlItem>> m_deferred;
+    std::atomic<uint64_t> m_deferredCount{0};
+
+    std::mutex m_visitedLock[VISITED_SHARDS];
+    std::unordered_set<DMCrawlDirKey, DMCrawlDirKeyHash> m_visited[VISITED_SHARDS];
+};
+
+#endif
@@ -0,0 +1,126 @@
+﻿// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <deque>
+#include <algorithm>
+#include <iterator>
+
+#include "libdmfilesearch_exclude.h"
+
+void DMExcludeMatcher::Clear() {
+    std::fill(std::begin(m_classes), std::end(m_classes), 0);
+    m_classCount = 1;
+    m_delta.assign(1, ROOT_STATE);
+    m_output.assign(1, 0);
+    m_empty = true;
+}
+
+void DMExcludeMatcher::Build(const std::unordered_set<std::string>& patterns) {
+    Clear();
+    if (patterns.empty()) {
+        return;
+    }
+    m_empty = false;
+
+    // 只为规则中出现过的字节分配字符类, 压缩转移表
+    for (const auto& pattern : patterns) {
+        for (unsigned char c : pattern) {
+            if (m_classes[c] == 0) {
+                m_classes[c] = static_cast<uint8_t>(m_classCount++);
+            }
+        }
+    }
+
+    const uint32_t classCount = m_classCount;
+    m_delta.assign(classCount, ROOT_STATE);
+    m_output.assign(1, 0);
+
+    // 构建 trie, 0 表示没有子节点 (根节点不会是任何节点的子节点)
+    for (const auto& pattern : patterns) {
+        uint32_t state = ROOT_STATE;
+        for (unsigned char c : pattern) {
+            uint32_t& next = m_delta[state * classCount + m_classes[c]];
+            if (next == ROOT_STATE) {
+                next = static_cast<uint32_t>(m_output.size());
+                m_output.push_back(0);
+                m_delta.resize(m_delta.size() + classCount, ROOT_STATE);
+            }
+            state = m_delta[state * classCount + m_classes[c]];
+        }
+        // 空规则与 find("") 一致, 匹配任何路径
+        m_output[state] = 1;
+    }
+
+    // 按层计算失败链接, 同时把缺失的转移补全为完整的 DFA
+    std::vector<uint32_t> fail(m_output.size(), ROOT_STATE);
+    std::deque<uint32_t> queue;
+    for (uint32_t c = 0; c < classCount; ++c) {
+        uint32_t child = m_delta[c];
+        if (child != ROOT_STATE) {
+            queue.push_back(child);
+        }
+    }
+
+    while (!queue.empty()) {
+        uint32_t state = queue.front();
+        queue.pop_front();
+        m_output[state] |= m_output[fail[state]];
+
+        for (uint32_t c = 0; c < classCount; ++c) {
+            uint32_t& next = m_delta[state * classCount + c];
+            uint32_t fallback = m_delta[fail[state] * classCount + c];
+            if (next != ROOT_STATE) {
+                fail[next] = fallback;
+                queue.push_back(next);
+            } else {
+                next = fallback;
+            }
+        }
+    }
+}
+
+bool DMExcludeMatcher::Scan(const char* text, size_t length, uint32_t& state) const {
+    if (m_empty) {
+        return false;
+    }
+    if (m_output[state]) {
+        return true;
+    }
+
+    const uint32_t classCount = m_classCount;
+    const uint32_t* delta = m_delta.data();
+    const uint8_t* output = m_output.data();
+
+    uint32_t current = state;
+    for (size_t i = 0; i < length; ++i) {
+        current = delta[current * classCount + m_classes[static_cast<unsigned char>(text[i])]];
+        if (output[current]) {
+            state = current;
+            return true;
+        }
+    }
+    state = current;
+    return false;
+}
+
+bool DMExcludeMatcher::Match(const std::string& text) const {
+    uint32_t state = ROOT_STATE;
+    return Scan(text.data(), text.size(), state);
+}
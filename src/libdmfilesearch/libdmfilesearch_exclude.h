@@ -0,0 +1,52 @@
+// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef __LIBDMFILESEARCH_EXCLUDE_H_INCLUDE__
+#define __LIBDMFILESEARCH_EXCLUDE_H_INCLUDE__
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_set>
+
+// 排除目录匹配器: 把所有排除规则编译成 Aho-Corasick 自动机,
+// 与原先逐条 find 的子串语义相同, 但每个路径只需扫描一遍.
+// 扫描状态可以保存下来, 子目录只需从父目录的状态继续扫描新增部分.
+class DMExcludeMatcher
+{
+public:
+    static constexpr uint32_t ROOT_STATE = 0;
+
+    void Build(const std::unordered_set<std::string>& patterns);
+    void Clear();
+    bool Empty() const { return m_empty; }
+
+    // 从 state 开始继续扫描, 命中任一规则返回 true, state 更新为扫描后的状态
+    bool Scan(const char* text, size_t length, uint32_t& state) const;
+    bool Match(const std::string& text) const;
+
+private:
+    uint8_t m_classes[256] = {};        // 字节 -> 字符类, 未出现在规则中的字节为 0
+    uint32_t m_classCount = 1;
+    std::vector<uint32_t> m_delta;      // 状态转移表 [状态 * m_classCount + 字符类]
+    std::vector<uint8_t> m_output;      // 状态是否命中规则
+    bool m_empty = true;
+};
+
+#endif
@@ -0,0 +1,300 @@
+﻿// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "libdmfilesearch_filetable.h"
+
+#include <stdexcept>
+
+// 名称区用 32 位偏移, 单个索引的名称总量不能超过 4GB
+static const uint64_t DM_NAME_ARENA_LIMIT = 0xFFFFFFFFULL;
+
+void DMFileTable::reserve(size_t count) {
+    m_fileSizes.reserve(count);
+    m_modifyTimes.reserve(count);
+    m_parents.reserve(count);
+    m_nameOffsets.reserve(count);
+    m_nameLengths.reserve(count);
+    m_foldedOffsets.reserve(count);
+    m_flags.reserve(count);
+}
+
+void DMFileTable::clear() {
+    m_fileSizes.clear();
+    m_modifyTimes.clear();
+    m_parents.clear();
+    m_nameOffsets.clear();
+    m_nameLengths.clear();
+    m_foldedOffsets.clear();
+    m_flags.clear();
+    m_names.clear();
+    m_garbage = 0;
+    m_foldedNames.clear();
+    m_foldedGarbage = 0;
+    m_dirs.clear();
+    m_dirPaths.clear();
+    m_foldedDirPaths.clear();
+    ++m_dirEpoch;
+    m_dirLookup.clear();
+    m_dirLookupReady = true;
+}
+
+// 构建完成后调用: 释放多余容量和目录查找表, 之后追加时再重建查找表
+void DMFileTable::shrink_to_fit() {
+    m_fileSizes.shrink_to_fit();
+    m_modifyTimes.shrink_to_fit();
+    m_parents.shrink_to_fit();
+    m_nameOffsets.shrink_to_fit();
+    m_nameLengths.shrink_to_fit();
+    m_foldedOffsets.shrink_to_fit();
+    m_flags.shrink_to_fit();
+    m_names.shrink_to_fit();
+    m_foldedNames.shrink_to_fit();
+    m_dirs.shrink_to_fit();
+    m_dirPaths.shrink_to_fit();
+    m_foldedDirPaths.shrink_to_fit();
+    m_dirLookup.clear();
+    m_dirLookupReady = m_dirs.empty();
+}
+
+void DMFileTable::EnsureDirLookup() {
+    if (m_dirLookupReady) {
+        return;
+    }
+    for (size_t i = 0; i < m_dirs.size(); ++i) {
+        m_dirLookup[std::string(DirPath(static_cast<uint32_t>(i)))] = static_cast<uint32_t>(i);
+    }
+    m_dirLookupReady = true;
+}
+
+uint32_t DMFileTable::AddDirectory(std::string_view path, char separator) {
+    EnsureDirLookup();
+    std::string key(path);
+    if (const uint32_t* dirId = m_dirLookup.Find(key)) {
+        return *dirId;
+    }
+    uint32_t dirId = static_cast<uint32_t>(m_dirs.size());
+    m_dirLookup[key] = dirId;
+    DMDirRecord dir;
+    dir.pathOffset = m_dirPaths.size();
+    dir.pathLength = static_cast<uint32_t>(path.size());
+    dir.separator = separator;
+    m_dirPaths.append(path);
+    m_foldedDirPaths.AppendFolded(path);
+    m_dirs.push_back(dir);
+    return dirId;
+}
+
+uint32_t DMFileTable::Append(uint32_t dirId, std::string_view name, uint8_t flags, uint64_t fileSize,
+    uint64_t modifyTime) {
+    if (m_names.size() + name.size() > DM_NAME_ARENA_LIMIT ||
+        m_foldedNames.size() + name.size() > DM_NAME_ARENA_LIMIT) {
+        throw std::length_error("索引名称总长度超过 4GB");
+    }
+    flags &= ~DM_FILE_MIXED_CASE;
+    if (DMHasUpperCase(name)) {
+        flags |= DM_FILE_MIXED_CASE;
+        m_foldedOffsets.push_back(static_cast<uint32_t>(m_foldedNames.size()));
+        m_foldedNames.AppendFolded(name);
+    } else {
+        m_foldedOffsets.push_back(0);
+    }
+    m_fileSizes.push_back(fileSize);
+    m_modifyTimes.push_back(modifyTime);
+    m_parents.push_back(dirId);
+    m_nameOffsets.push_back(static_cast<uint32_t>(m_names.size()));
+    m_nameLengths.push_back(static_cast<uint32_t>(name.size()));
+    m_flags.push_back(flags);
+    m_names.append(name);
+    return static_cast<uint32_t>(m_flags.size() - 1);
+}
+
+// 完整路径应为 目录 + [分隔符] + 名称; 不符合时以完整路径去掉名称的部分作为目录, 保证完整路径不变
+uint32_t DMFileTable::Append(const DMFileInfo& fileInfo) {
+    const std::string& fullPath = fileInfo.fullPath;
+    const std::string& name = fileInfo.fileName;
+    std::string_view directory = fileInfo.directory;
+    char separator = 0;
+    bool endsWithName = fullPath.size() >= name.size() &&
+        fullPath.compare(fullPath.size() - name.size(), name.size(), name) == 0;
+    if (endsWithName && fullPath.size() == directory.size() + 1 + name.size() &&
+        fullPath.compare(0, directory.size(), directory.data(), directory.size()) == 0) {
+        separator = fullPath[directory.size()];
+    } else if (!endsWithName || fullPath.size() != directory.size() + name.size() ||
+        fullPath.compare(0, directory.size(), directory.data(), directory.size()) != 0) {
+        directory = std::string_view(fullPath.data(), endsWithName ? fullPath.size() - name.size() : 0);
+    }
+
+    uint8_t flags = (fileInfo.isDirectory ? DM_FILE_DIRECTORY : 0) | (fileInfo.hasMetadata ? DM_FILE_METADATA : 0);
+    return Append(AddDirectory(directory, separator), endsWithName ? std::string_view(name) : std::string_view(fullPath),
+        flags, fileInfo.fileSize, fileInfo.modifyTime);
+}
+
+void DMFileTable::Append(const DMFileTable& other) {
+    std::vector<uint32_t> dirMap(other.m_dirs.size());
+    for (size_t i = 0; i < other.m_dirs.size(); ++i) {
+        dirMap[i] = AddDirectory(other.DirPath(static_cast<uint32_t>(i)), other.m_dirs[i].separator);
+    }
+    reserve(size() + other.size());
+    m_names.reserve(m_names.size() + other.m_names.size() - other.m_garbage);
+    for (uint32_t id = 0; id < other.size(); ++id) {
+        Append(dirMap[other.m_parents[id]], other.Name(id), other.m_flags[id], other.m_fileSizes[id],
+            other.m_modifyTimes[id]);
+    }
+}
+
+void DMFileTable::RemoveSwap(uint32_t id) {
+    m_garbage += m_nameLengths[id];
+    if (m_flags[id] & DM_FILE_MIXED_CASE) {
+        m_foldedGarbage += m_nameLengths[id];
+    }
+    size_t last = size() - 1;
+    if (id != last) {
+        m_fileSizes.Set(id, m_fileSizes[last]);
+        m_modifyTimes.Set(id, m_modifyTimes[last]);
+        m_parents.Set(id, m_parents[last]);
+        m_nameOffsets.Set(id, m_nameOffsets[last]);
+        m_nameLengths.Set(id, m_nameLengths[last]);
+        m_foldedOffsets.Set(id, m_foldedOffsets[last]);
+        m_flags.Set(id, m_flags[last]);
+    }
+    m_fileSizes.pop_back();
+    m_modifyTimes.pop_back();
+    m_parents.pop_back();
+    m_nameOffsets.pop_back();
+    m_nameLengths.pop_back();
+    m_foldedOffsets.pop_back();
+    m_flags.pop_back();
+    if (m_garbage > 4096 && m_garbage > m_names.size() / 2) {
+        Compact();
+    }
+}
+
+// 重写名称区并去掉不再被引用的目录; 各列的所有块都会改写, 复制量与表大小成正比,
+// 只在废弃的名称超过一半时发生
+void DMFileTable::Compact() {
+    const uint32_t unused = 0xFFFFFFFF;
+    std::vector<uint32_t> dirMap(m_dirs.size(), unused);
+    DMSharedArray<DMDirRecord> dirs;
+    DMSharedArena dirPaths;
+    DMSharedArena foldedDirPaths;
+    DMSharedArena names;
+    DMSharedArena foldedNames;
+    names.reserve(m_names.size() - m_garbage);
+    foldedNames.reserve(m_foldedNames.size() - m_foldedGarbage);
+    for (size_t id = 0; id < size(); ++id) {
+        uint32_t& dirId = dirMap[m_parents[id]];
+        if (dirId == unused) {
+            DMDirRecord dir = m_dirs[m_parents[id]];
+            std::string_view path = DirPath(m_parents[id]);
+            dir.pathOffset = dirPaths.size();
+            dirPaths.append(path);
+            foldedDirPaths.append(FoldedDirPath(m_parents[id]));
+            dirId = static_cast<uint32_t>(dirs.size());
+            dirs.push_back(dir);
+        }
+        m_parents.Set(id, dirId);
+        uint32_t offset = static_cast<uint32_t>(names.size());
+        names.append(Name(static_cast<uint32_t>(id)));
+        m_nameOffsets.Set(id, offset);
+        if (m_flags[id] & DM_FILE_MIXED_CASE) {
+            offset = static_cast<uint32_t>(foldedNames.size());
+            foldedNames.append(FoldedName(static_cast<uint32_t>(id)));
+            m_foldedOffsets.Set(id, offset);
+        }
+    }
+    m_names.swap(names);
+    m_garbage = 0;
+    m_foldedNames.swap(foldedNames);
+    m_foldedGarbage = 0;
+    m_dirs.swap(dirs);
+    m_dirPaths.swap(dirPaths);
+    m_foldedDirPaths.swap(foldedDirPaths);
+    ++m_dirEpoch;
+    m_dirLookup.clear();
+    m_dirLookupReady = m_dirs.empty();
+}
+
+void DMFileTable::FullPath(uint32_t id, std::string& path) const {
+    const DMDirRecord& dir = m_dirs[m_parents[id]];
+    path.assign(m_dirPaths.data() + dir.pathOffset, dir.pathLength);
+    if (dir.separator != 0) {
+        path.push_back(dir.separator);
+    }
+    path.append(Name(id));
+}
+
+void DMFileTable::FoldedFullPath(uint32_t id, std::string& path) const {
+    const DMDirRecord& dir = m_dirs[m_parents[id]];
+    path.assign(m_foldedDirPaths.data() + dir.pathOffset, dir.pathLength);
+    if (dir.separator != 0) {
+        path.push_back(dir.separator);
+    }
+    path.append(FoldedName(id));
+}
+
+std::string DMFileTable::FullPath(uint32_t id) const {
+    std::string path;
+    FullPath(id, path);
+    return path;
+}
+
+DMFileInfo DMFileTable::Get(uint32_t id) const {
+    DMFileInfo fileInfo;
+    FullPath(id, fileInfo.fullPath);
+    fileInfo.fileName.assign(Name(id));
+    fileInfo.directory.assign(DirPath(m_parents[id]));
+    fileInfo.fileSize = m_fileSizes[id];
+    fileInfo.modifyTime = m_modifyTimes[id];
+    fileInfo.isDirectory = (m_flags[id] & DM_FILE_DIRECTORY) != 0;
+    fileInfo.hasMetadata = (m_flags[id] & DM_FILE_METADATA) != 0;
+    return fileInfo;
+}
+
+void DMFileTable::FillMetadata(uint32_t id, bool isRegular, uint64_t fileSize, uint64_t modifyTime) {
+    SetMetadata(id, isRegular ? fileSize : 0, modifyTime);
+}
+
+void DMFileTable::SetMetadata(uint32_t id, uint64_t fileSize, uint64_t modifyTime) {
+    m_fileSizes.Set(id, fileSize);
+    m_modifyTimes.Set(id, modifyTime);
+    m_flags.Set(id, m_flags[id] | DM_FILE_METADATA);
+}
+
+void DMFileTable::ResetType(uint32_t id, bool isDirectory) {
+    m_fileSizes.Set(id, 0);
+    m_modifyTimes.Set(id, 0);
+    m_flags.Set(id, (m_flags[id] & DM_FILE_MIXED_CASE) | (isDirectory ? DM_FILE_DIRECTORY : 0));
+}
+
+// 共享的块在每个副本中都计入
+size_t DMFileTable::MemoryUsage() const {
+    size_t bytes = m_fileSizes.MemoryUsage() + m_modifyTimes.MemoryUsage();
+    bytes += m_parents.MemoryUsage() + m_nameOffsets.MemoryUsage() + m_nameLengths.MemoryUsage() +
+        m_foldedOffsets.MemoryUsage();
+    bytes += m_flags.MemoryUsage();
+    bytes += m_names.capacity() + m_foldedNames.capacity();
+    bytes += m_dirs.MemoryUsage();
+    bytes += m_dirPaths.capacity() + m_foldedDirPaths.capacity();
+    bytes += m_dirLookup.MemoryUsage();
+    m_dirLookup.ForEach([&](const std::string& path, uint32_t) {
+        bytes += DMStringHeap(path);
+    });
+    return bytes;
+}
@@ -0,0 +1,183 @@
+// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef __LIBDMFILESEARCH_FILETABLE_H_INCLUDE__
+#define __LIBDMFILESEARCH_FILETABLE_H_INCLUDE__
+#include "dmfilesearch.h"
+#include "libdmfilesearch_shared.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+
+// 短字符串存放在对象内部, 只统计单独分配的缓冲区
+inline size_t DMStringHeap(const std::string& str) {
+    const char* data = str.data();
+    const char* self = reinterpret_cast<const char*>(&str);
+    if (data >= self && data < self + sizeof(str)) {
+        return 0;
+    }
+    return str.capacity() + 1;
+}
+
+// 哈希表按节点 (键值 + next 指针 + 缓存的哈希值) 和桶数组估算
+template <typename Map>
+inline size_t DMHashMapHeap(const Map& map) {
+    return map.size() * (sizeof(typename Map::value_type) + 2 * sizeof(void*)) +
+        map.bucket_count() * sizeof(void*);
+}
+
+enum DMFileFlags : uint8_t {
+    DM_FILE_DIRECTORY = 0x01,
+    DM_FILE_METADATA = 0x02,    // fileSize/modifyTime 已加载
+    DM_FILE_MIXED_CASE = 0x04,  // 名称含大写字母, 小写副本另存
+};
+
+// 不区分大小写的比较只折叠 ASCII 字母, 与 ToLower 在 C locale 下的结果相同
+inline char DMFoldCase(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+inline bool DMHasUpperCase(std::string_view text) {
+    for (char c : text) {
+        if (c >= 'A' && c <= 'Z') {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 一个目录, 完整路径存放在 DMFileTable 的目录路径区中
+struct DMDirRecord {
+    uint64_t pathOffset = 0;
+    uint32_t pathLength = 0;
+    char separator = 0;         // 目录路径与子项名称之间的分隔符, 目录以分隔符结尾时为 0
+};
+
+// 紧凑的索引项表: 所有名称连续存放, 每个目录的完整路径只存一份, 每项只记录目录编号、
+// 名称位置和元数据. 完整路径和 DMFileInfo 只在需要时拼出.
+// 各字段按列分别存放, 按类型、大小、时间过滤时只顺序扫描用到的列.
+// 构建时同时保存名称和目录路径的小写副本, 不区分大小写的搜索直接比较副本; 名称本身不含大写字母时不另存.
+// 各列、名称区和目录表都是共享存储, 复制一张表只复制块指针, 增量更新只复制改到的块.
+// 按目录路径查找编号的表只在追加时建立, shrink_to_fit 时释放
+class DMFileTable
+{
+public:
+
+    size_t size() const { return m_flags.size(); }
+    bool empty() const { return m_flags.empty(); }
+    void reserve(size_t count);
+    void clear();
+    void shrink_to_fit();
+
+    // 登记目录并返回编号, 同一路径只登记一次
+    uint32_t AddDirectory(std::string_view path, char separator);
+    uint32_t Append(uint32_t dirId, std::string_view name, uint8_t flags, uint64_t fileSize, uint64_t modifyTime);
+    uint32_t Append(const DMFileInfo& fileInfo);
+    // 追加另一张表的所有项, 目录编号重新映射
+    void Append(const DMFileTable& other);
+
+    // 用最后一项覆盖 id 处的项并删除最后一项; 废弃的名称过多时整理名称区, 下标不变
+    void RemoveSwap(uint32_t id);
+
+    std::string_view Name(uint32_t id) const {
+        return std::string_view(m_names.data() + m_nameOffsets[id], m_nameLengths[id]);
+    }
+    // 小写的名称
+    std::string_view FoldedName(uint32_t id) const {
+        if ((m_flags[id] & DM_FILE_MIXED_CASE) == 0) {
+            return Name(id);
+        }
+        return std::string_view(m_foldedNames.data() + m_foldedOffsets[id], m_nameLengths[id]);
+    }
+    uint32_t Directory(uint32_t id) const { return m_parents[id]; }
+    std::string_view DirectoryPath(uint32_t id) const { return DirPath(m_parents[id]); }
+    uint8_t Flags(uint32_t id) const { return m_flags[id]; }
+    bool IsDirectory(uint32_t id) const { return (m_flags[id] & DM_FILE_DIRECTORY) != 0; }
+    bool HasMetadata(uint32_t id) const { return (m_flags[id] & DM_FILE_METADATA) != 0; }
+    uint64_t FileSize(uint32_t id) const { return m_fileSizes[id]; }
+    uint64_t ModifyTime(uint32_t id) const { return m_modifyTimes[id]; }
+
+    // 名称区和目录路径区, 连续扫描用; 名称区中可能夹有已删除项的名称
+    std::string_view NameArena() const { return m_names.View(); }
+    uint32_t NameOffset(uint32_t id) const { return m_nameOffsets[id]; }
+    std::string_view DirPathArena() const { return m_dirPaths.View(); }
+
+    // 按列访问, 长度均为 size()
+    const DMSharedArray<uint8_t>& FlagColumn() const { return m_flags; }
+    const DMSharedArray<uint32_t>& DirectoryColumn() const { return m_parents; }
+    const DMSharedArray<uint64_t>& FileSizeColumn() const { return m_fileSizes; }
+    const DMSharedArray<uint64_t>& ModifyTimeColumn() const { return m_modifyTimes; }
+
+    // 拼出完整路径, 写入 path 以便复用缓冲区
+    void FullPath(uint32_t id, std::string& path) const;
+    std::string FullPath(uint32_t id) const;
+    // 拼出小写的完整路径
+    void FoldedFullPath(uint32_t id, std::string& path) const;
+    DMFileInfo Get(uint32_t id) const;
+
+    // 与 DMFillFileInfo 相同: 非普通文件的大小记为 0
+    void FillMetadata(uint32_t id, bool isRegular, uint64_t fileSize, uint64_t modifyTime);
+    // 原样写入已加载的元数据
+    void SetMetadata(uint32_t id, uint64_t fileSize, uint64_t modifyTime);
+    // 更新类型并清除已加载的元数据 (增量更新时文件可能已被替换)
+    void ResetType(uint32_t id, bool isDirectory);
+
+    // 目录表; 整理名称区时目录重新编号, DirEpoch 随之改变
+    size_t DirCount() const { return m_dirs.size(); }
+    uint64_t DirEpoch() const { return m_dirEpoch; }
+    std::string_view DirPath(uint32_t dirId) const {
+        const DMDirRecord& dir = m_dirs[dirId];
+        return std::string_view(m_dirPaths.data() + dir.pathOffset, dir.pathLength);
+    }
+    char DirSeparator(uint32_t dirId) const { return m_dirs[dirId].separator; }
+    std::string_view FoldedDirPath(uint32_t dirId) const {
+        const DMDirRecord& dir = m_dirs[dirId];
+        return std::string_view(m_foldedDirPaths.data() + dir.pathOffset, dir.pathLength);
+    }
+
+    // 估算占用的堆内存 (字节)
+    size_t MemoryUsage() const;
+
+private:
+    void EnsureDirLookup();
+    void Compact();
+
+    // 索引项各列
+    DMSharedArray<uint64_t> m_fileSizes;
+    DMSharedArray<uint64_t> m_modifyTimes;
+    DMSharedArray<uint32_t> m_parents;  // 所在目录的编号
+    DMSharedArray<uint32_t> m_nameOffsets;
+    DMSharedArray<uint32_t> m_nameLengths;
+    DMSharedArray<uint32_t> m_foldedOffsets;    // 小写副本在 m_foldedNames 中的位置, 仅 DM_FILE_MIXED_CASE 项有效
+    DMSharedArray<uint8_t> m_flags;     // DMFileFlags
+    DMSharedArena m_names;              // 所有名称首尾相接, 不含结束符
+    size_t m_garbage = 0;               // 已删除项仍占用的名称字节数
+    DMSharedArena m_foldedNames;        // 含大写字母的名称的小写副本
+    size_t m_foldedGarbage = 0;
+    DMSharedArray<DMDirRecord> m_dirs;
+    DMSharedArena m_dirPaths;           // 所有目录路径首尾相接
+    DMSharedArena m_foldedDirPaths;     // 目录路径的小写副本, 与 m_dirPaths 逐字节对应
+    uint64_t m_dirEpoch = 0;
+    DMSharedMap<std::string, uint32_t> m_dirLookup;
+    bool m_dirLookupReady = true;       // 空表的查找表是完整的
+};
+
+#endif
@@ -0,0 +1,89 @@
+﻿// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "libdmfilesearch_filter.h"
+
+void DMBitmap::Assign(size_t size, bool value) {
+    m_size = size;
+    m_words.assign((size + 63) / 64, value ? ~uint64_t(0) : 0);
+    if (value && (size & 63) != 0) {
+        m_words.back() = (uint64_t(1) << (size & 63)) - 1;
+    }
+}
+
+size_t DMBitmap::Count() const {
+    size_t count = 0;
+    for (uint64_t word : m_words) {
+#ifdef _MSC_VER
+        count += static_cast<size_t>(__popcnt64(word));
+#else
+        count += static_cast<size_t>(__builtin_popcountll(word));
+#endif
+    }
+    return count;
+}
+
+// 每次处理 64 项, 内层循环没有分支, 编译器可以向量化. 列按 4096 项分块存放, 64 项总在同一块内
+template <typename T, typename Predicate>
+static void DMFilterColumn(const DMSharedArray<T>& column, DMBitmap& candidates, Predicate&& predicate) {
+    static_assert(DMSharedArray<T>::CHUNK_SIZE % 64 == 0, "列的分块必须是 64 的倍数");
+    const size_t count = column.size();
+    std::vector<uint64_t>& words = candidates.Words();
+    for (size_t w = 0; w < words.size(); ++w) {
+        if (words[w] == 0) {
+            continue;
+        }
+        size_t base = w << 6;
+        size_t n = count - base < 64 ? count - base : 64;
+        const T* values = column.Run(base);
+        uint64_t mask = 0;
+        for (size_t bit = 0; bit < n; ++bit) {
+            mask |= static_cast<uint64_t>(predicate(values[bit])) << bit;
+        }
+        words[w] &= mask;
+    }
+}
+
+void DMSelectEntries(const DMFileTable& table, const DMEntryFilter& filter, DMBitmap& candidates) {
+    const size_t count = table.size();
+    candidates.Assign(count, true);
+
+    if (filter.HasFlagFilter()) {
+        const uint8_t flagMask = filter.flagMask;
+        const uint8_t flagValue = filter.flagValue;
+        DMFilterColumn(table.FlagColumn(), candidates, [=](uint8_t flags) {
+            return (flags & flagMask) == flagValue;
+        });
+    }
+    if (filter.HasSizeFilter()) {
+        const uint64_t minSize = filter.minFileSize;
+        const uint64_t maxSize = filter.maxFileSize;
+        DMFilterColumn(table.FileSizeColumn(), candidates, [=](uint64_t size) {
+            return size >= minSize && size <= maxSize;
+        });
+    }
+    if (filter.HasTimeFilter()) {
+        const uint64_t minTime = filter.minModifyTime;
+        const uint64_t maxTime = filter.maxModifyTime;
+        DMFilterColumn(table.ModifyTimeColumn(), candidates, [=](uint64_t time) {
+            return time >= minTime && time <= maxTime;
+        });
+    }
+}
@@ -0,0 +1,91 @@
+// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef __LIBDMFILESEARCH_FILTER_H_INCLUDE__
+#define __LIBDMFILESEARCH_FILTER_H_INCLUDE__
+#include "libdmfilesearch_filetable.h"
+#include <cstdint>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+inline uint32_t DMCountTrailingZeros(uint64_t word) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return static_cast<uint32_t>(index);
+#else
+    return static_cast<uint32_t>(__builtin_ctzll(word));
+#endif
+}
+
+// 按索引项编号的位图, 每 64 项一个字
+class DMBitmap
+{
+public:
+    void Assign(size_t size, bool value);
+    size_t size() const { return m_size; }
+
+    void Set(uint32_t id) { m_words[id >> 6] |= uint64_t(1) << (id & 63); }
+    void Reset(uint32_t id) { m_words[id >> 6] &= ~(uint64_t(1) << (id & 63)); }
+    bool Test(uint32_t id) const { return (m_words[id >> 6] >> (id & 63)) & 1; }
+    size_t Count() const;
+
+    std::vector<uint64_t>& Words() { return m_words; }
+    const std::vector<uint64_t>& Words() const { return m_words; }
+
+    // 按编号从小到大访问所有置位的项
+    template <typename Func>
+    void ForEach(Func&& func) const {
+        for (size_t w = 0; w < m_words.size(); ++w) {
+            uint64_t word = m_words[w];
+            while (word != 0) {
+                func(static_cast<uint32_t>((w << 6) + DMCountTrailingZeros(word)));
+                word &= word - 1;
+            }
+        }
+    }
+
+private:
+    std::vector<uint64_t> m_words;
+    size_t m_size = 0;
+};
+
+// 只依赖元数据列的条件, 在匹配名称之前求值. 大小和时间条件只对已加载元数据的项有意义
+struct DMEntryFilter {
+    uint8_t flagMask = 0;           // (flags & flagMask) == flagValue
+    uint8_t flagValue = 0;
+    uint64_t minFileSize = 0;
+    uint64_t maxFileSize = UINT64_MAX;
+    uint64_t minModifyTime = 0;
+    uint64_t maxModifyTime = UINT64_MAX;
+
+    bool HasFlagFilter() const { return flagMask != 0; }
+    bool HasSizeFilter() const { return minFileSize != 0 || maxFileSize != UINT64_MAX; }
+    bool HasTimeFilter() const { return minModifyTime != 0 || maxModifyTime != UINT64_MAX; }
+    bool Empty() const { return !HasFlagFilter() && !HasSizeFilter() && !HasTimeFilter(); }
+};
+
+// 逐列扫描 table, 满足 filter 的项在 candidates 中置位
+void DMSelectEntries(const DMFileTable& table, const DMEntryFilter& filter, DMBitmap& candidates);
+
+#endif
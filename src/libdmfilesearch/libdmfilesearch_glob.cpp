@@ -0,0 +1,175 @@
+﻿// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "libdmfilesearch_glob.h"
+#include "libdmfilesearch_textscan.h"
+
+// UTF-8 的后续字节
+static inline bool DMIsContinuation(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+// segment 从 text 的 pos 处开始匹配, 返回匹配结束的位置, 不匹配时返回 npos
+static size_t DMMatchSegmentAt(std::string_view text, size_t pos, std::string_view segment) {
+    for (char c : segment) {
+        if (pos >= text.size()) {
+            return std::string_view::npos;
+        }
+        if (c == '?') {
+            ++pos;
+            while (pos < text.size() && DMIsContinuation(text[pos])) {
+                ++pos;
+            }
+        } else if (text[pos] == c) {
+            ++pos;
+        } else {
+            return std::string_view::npos;
+        }
+    }
+    return pos;
+}
+
+DMGlobMatcher::DMGlobMatcher(std::string_view pattern) {
+    if (pattern.find_first_of("*?") == std::string_view::npos) {
+        m_kind = DM_GLOB_LITERAL;
+        m_segments.emplace_back(pattern);
+        m_hasQuestion.push_back(false);
+        m_required = std::string(pattern);
+        return;
+    }
+
+    m_anchorStart = pattern.front() != '*';
+    m_anchorEnd = pattern.back() != '*';
+    size_t start = 0;
+    while (start <= pattern.size()) {
+        size_t star = pattern.find('*', start);
+        if (star == std::string_view::npos) {
+            star = pattern.size();
+        }
+        if (star > start) {
+            std::string_view segment = pattern.substr(start, star - start);
+            m_segments.emplace_back(segment);
+            m_hasQuestion.push_back(segment.find('?') != std::string_view::npos);
+            // 各段按 ? 再切开, 取最长的一段作为必须包含的字面文本
+            size_t pieceStart = 0;
+            while (pieceStart <= segment.size()) {
+                size_t question = segment.find('?', pieceStart);
+                if (question == std::string_view::npos) {
+                    question = segment.size();
+                }
+                if (question - pieceStart > m_required.size()) {
+                    m_required = std::string(segment.substr(pieceStart, question - pieceStart));
+                }
+                pieceStart = question + 1;
+            }
+        }
+        start = star + 1;
+    }
+
+    bool plain = m_segments.size() == 1 && !m_hasQuestion[0];
+    if (m_segments.empty()) {
+        m_kind = DM_GLOB_ANY;
+    } else if (plain && m_anchorStart && !m_anchorEnd) {
+        m_kind = DM_GLOB_PREFIX;
+    } else if (plain && !m_anchorStart && m_anchorEnd) {
+        m_kind = DM_GLOB_SUFFIX;
+    } else if (plain && !m_anchorStart && !m_anchorEnd) {
+        m_kind = DM_GLOB_CONTAINS;
+    } else {
+        m_kind = DM_GLOB_GENERAL;
+    }
+}
+
+bool DMGlobMatcher::Match(std::string_view text) const {
+    switch (m_kind) {
+    case DM_GLOB_LITERAL:
+        return text == m_segments[0];
+    case DM_GLOB_ANY:
+        return true;
+    case DM_GLOB_PREFIX:
+        return text.substr(0, m_segments[0].size()) == m_segments[0];
+    case DM_GLOB_SUFFIX:
+        return text.size() >= m_segments[0].size() &&
+            text.substr(text.size() - m_segments[0].size()) == m_segments[0];
+    case DM_GLOB_CONTAINS:
+        return DMFindText(text, 0, m_segments[0], false) != std::string_view::npos;
+    default:
+        return MatchGeneral(text);
+    }
+}
+
+bool DMGlobMatcher::MatchGeneral(std::string_view text) const {
+    size_t first = 0;
+    size_t last = m_segments.size();
+    size_t pos = 0;
+
+    // 不含 * 时整个文本只能匹配这一段
+    if (m_anchorStart && m_anchorEnd && m_segments.size() == 1) {
+        return DMMatchSegmentAt(text, 0, m_segments[0]) == text.size();
+    }
+    if (m_anchorStart) {
+        pos = DMMatchSegmentAt(text, 0, m_segments[0]);
+        if (pos == std::string_view::npos) {
+            return false;
+        }
+        ++first;
+    }
+    if (m_anchorEnd) {
+        --last;
+    }
+
+    // 中间各段取最靠左的匹配, 结束位置最早, 留给后面各段的文本最多
+    for (size_t i = first; i < last; ++i) {
+        const std::string& segment = m_segments[i];
+        if (!m_hasQuestion[i]) {
+            size_t hit = DMFindText(text, pos, segment, false);
+            if (hit == std::string_view::npos) {
+                return false;
+            }
+            pos = hit + segment.size();
+            continue;
+        }
+        size_t end = std::string_view::npos;
+        for (size_t start = pos; start < text.size() && end == std::string_view::npos; ++start) {
+            if (!DMIsContinuation(text[start])) {
+                end = DMMatchSegmentAt(text, start, segment);
+            }
+        }
+        if (end == std::string_view::npos) {
+            return false;
+        }
+        pos = end;
+    }
+
+    if (!m_anchorEnd) {
+        return true;
+    }
+    // 末段必须恰好在结尾结束
+    const std::string& segment = m_segments.back();
+    if (!m_hasQuestion.back()) {
+        return text.size() - pos >= segment.size() && text.substr(text.size() - segment.size()) == segment;
+    }
+    for (size_t start = pos; start < text.size(); ++start) {
+        if (!DMIsContinuation(text[start]) && DMMatchSegmentAt(text, start, segment) == text.size()) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,65 @@
+// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef __LIBDMFILESEARCH_GLOB_H_INCLUDE__
+#define __LIBDMFILESEARCH_GLOB_H_INCLUDE__
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 通配符模式: * 匹配任意个字符, ? 匹配一个字符 (UTF-8 多字节字符算一个), 模式须匹配整个文本.
+// 查询开始时编译一次: 按 * 切成若干段, 首段必须出现在开头, 末段必须出现在结尾, 中间各段依次取最靠左的位置,
+// 不需要回溯. 只含一个 * 的 *.ext、prefix*、*suffix 和 *text* 直接比较.
+// 不区分大小写时模式和文本都应已转换为小写
+class DMGlobMatcher
+{
+public:
+    enum Kind {
+        DM_GLOB_LITERAL,    // 不含通配符
+        DM_GLOB_ANY,        // 只有 *
+        DM_GLOB_PREFIX,     // prefix*
+        DM_GLOB_SUFFIX,     // *suffix, 包括 *.ext
+        DM_GLOB_CONTAINS,   // *text*
+        DM_GLOB_GENERAL,
+    };
+
+    explicit DMGlobMatcher(std::string_view pattern);
+
+    bool HasWildcard() const { return m_kind != DM_GLOB_LITERAL; }
+    Kind GetKind() const { return m_kind; }
+    // PREFIX/SUFFIX/CONTAINS 的字面部分
+    std::string_view Literal() const { return m_segments.empty() ? std::string_view() : std::string_view(m_segments[0]); }
+    // 匹配的文本必定包含的最长一段字面文本 (不含 ?), 用于借助子串索引预先筛选
+    std::string_view RequiredLiteral() const { return m_required; }
+
+    bool Match(std::string_view text) const;
+
+private:
+    bool MatchGeneral(std::string_view text) const;
+
+    Kind m_kind = DM_GLOB_LITERAL;
+    bool m_anchorStart = true;          // 模式不以 * 开头
+    bool m_anchorEnd = true;            // 模式不以 * 结尾
+    std::vector<std::string> m_segments;    // 以 * 分隔的各段, 去掉空段
+    std::vector<bool> m_hasQuestion;
+    std::string m_required;
+};
+
+#endif
@@ -0,0 +1,293 @@
+﻿// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+
+#include "dmos.h"
+#include "libdmfilesearch_ignore.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// 按优先级从低到高读取, 后读取的规则覆盖先读取的
+static const char* DM_IGNORE_FILES[] = { ".gitignore", ".ignore", ".esignore" };
+
+static bool DMReadIgnoreFile(const std::string& dirPath, int dirFd, const char* name, std::string& content) {
+#ifndef _WIN32
+    if (dirFd >= 0) {
+        int fd = openat(dirFd, name, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        char buffer[4096];
+        ssize_t bytes;
+        while ((bytes = read(fd, buffer, sizeof(buffer))) > 0) {
+            content.append(buffer, static_cast<size_t>(bytes));
+        }
+        close(fd);
+        return true;
+    }
+#endif
+    std::ifstream ifs(dirPath + PATH_DELIMITER + name, std::ios::binary);
+    if (!ifs) {
+        return false;
+    }
+    std::ostringstream oss;
+    oss << ifs.rdbuf();
+    content = oss.str();
+    return true;
+}
+
+std::shared_ptr<const DMIgnoreRules> DMIgnoreRules::Load(const std::shared_ptr<const DMIgnoreRules>& parent,
+    const std::string& dirPath, int dirFd) {
+    std::vector<DMIgnoreRule> rules;
+    for (const char* name : DM_IGNORE_FILES) {
+        std::string content;
+        if (DMReadIgnoreFile(dirPath, dirFd, name, content)) {
+            Parse(content, rules);
+        }
+    }
+
+    if (rules.empty()) {
+        return parent;
+    }
+
+    std::shared_ptr<DMIgnoreRules> result = std::make_shared<DMIgnoreRules>();
+    result->m_parent = parent;
+    result->m_base = dirPath;
+    if (result->m_base.empty() || (result->m_base.back() != '/' && result->m_base.back() != PATH_DELIMITER)) {
+        result->m_base.push_back(PATH_DELIMITER);
+    }
+    result->m_rules.swap(rules);
+    return result;
+}
+
+std::shared_ptr<const DMIgnoreRules> DMIgnoreRules::LoadChain(const std::string& rootDir, const std::string& dir,
+    DMIgnoreCache& cache) {
+    auto it = cache.find(dir);
+    if (it != cache.end()) {
+        return it->second;
+    }
+    std::shared_ptr<const DMIgnoreRules> parent;
+    if (dir.size() > rootDir.size()) {
+        size_t pos = dir.find_last_of('/');
+        parent = LoadChain(rootDir, pos == 0 ? std::string("/") : dir.substr(0, pos), cache);
+    }
+    std::shared_ptr<const DMIgnoreRules> rules = Load(parent, dir, -1);
+    cache.emplace(dir, rules);
+    return rules;
+}
+
+void DMIgnoreRules::Parse(const std::string& content, std::vector<DMIgnoreRule>& rules) {
+    std::istringstream iss(content);
+    std::string line;
+    while (std::getline(iss, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+
+        // 去掉末尾未转义的空格
+        while (!line.empty() && line.back() == ' ' && (line.size() < 2 || line[line.size() - 2] != '\\')) {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        DMIgnoreRule rule;
+        size_t begin = 0;
+        if (line[0] == '!') {
+            rule.negate = true;
+            begin = 1;
+        } else if (line[0] == '\\' && line.size() > 1 && (line[1] == '#' || line[1] == '!')) {
+            begin = 1;
+        }
+
+        std::string pattern = line.substr(begin);
+        if (!pattern.empty() && pattern.back() == '/') {
+            rule.dirOnly = true;
+            pattern.pop_back();
+        }
+        if (pattern.find('/') != std::string::npos) {
+            rule.anchored = true;
+            if (pattern[0] == '/') {
+                pattern.erase(0, 1);
+            }
+        }
+        if (pattern.empty()) {
+            continue;
+        }
+
+        rule.literal = pattern.find_first_of("*?[\\") == std::string::npos;
+        rule.pattern = pattern;
+        rules.push_back(rule);
+    }
+}
+
+static bool DMMatchBracket(const char*& pattern, char c) {
+    // pattern 指向 '[' 之后
+    const char* p = pattern;
+    bool negate = false;
+    if (*p == '!' || *p == '^') {
+        negate = true;
+        ++p;
+    }
+
+    bool matched = false;
+    bool first = true;
+    while (*p && (first || *p != ']')) {
+        first = false;
+        char low = *p;
+        if (low == '\\' && p[1]) {
+            low = *++p;
+        }
+        char high = low;
+        if (p[1] == '-' && p[2] && p[2] != ']') {
+            high = p[2];
+            if (high == '\\' && p[3]) {
+                high = p[3];
+                ++p;
+            }
+            p += 2;
+        }
+        if (c >= low && c <= high) {
+            matched = true;
+        }
+        ++p;
+    }
+    if (*p != ']') {
+        return false;
+    }
+    pattern = p + 1;
+    return matched != negate;
+}
+
+bool DMIgnoreRules::Wildmatch(const char* pattern, const char* text) {
+    while (*pattern) {
+        switch (*pattern) {
+        case '*':
+            if (pattern[1] == '*') {
+                const char* rest = pattern + 2;
+                // "**/" 匹配零个或多个目录
+                if (*rest == '/') {
+                    ++rest;
+                    for (const char* t = text;; ++t) {
+                        if ((t == text || t[-1] == '/') && Wildmatch(rest, t)) {
+                            return true;
+                        }
+                        if (!*t) {
+                            return false;
+                        }
+                    }
+                }
+                // 其他情况下 "**" 匹配任意字符, 包括 '/'
+                for (const char* t = text;; ++t) {
+                    if (Wildmatch(rest, t)) {
+                        return true;
+                    }
+                    if (!*t) {
+                        return false;
+                    }
+                }
+            }
+            // '*' 不跨越 '/'
+            for (const char* t = text;; ++t) {
+                if (Wildmatch(pattern + 1, t)) {
+                    return true;
+                }
+                if (!*t || *t == '/') {
+                    return false;
+                }
+            }
+        case '?':
+            if (!*text || *text == '/') {
+                return false;
+            }
+            ++pattern;
+            ++text;
+            break;
+        case '[':
+            if (!*text || *text == '/') {
+                return false;
+            }
+            ++pattern;
+            if (!DMMatchBracket(pattern, *text)) {
+                return false;
+            }
+            ++text;
+            break;
+        case '\\':
+            if (pattern[1]) {
+                ++pattern;
+            }
+            // fallthrough
+        default:
+            if (*pattern != *text) {
+                return false;
+            }
+            ++pattern;
+            ++text;
+            break;
+        }
+    }
+    return *text == '\0';
+}
+
+bool DMIgnoreRules::IsIgnored(const std::string& fullPath, const std::string& name, bool isDirectory) const {
+    for (const DMIgnoreRules* level = this; level; level = level->m_parent.get()) {
+        if (fullPath.size() <= level->m_base.size() ||
+            fullPath.compare(0, level->m_base.size(), level->m_base) != 0) {
+            continue;
+        }
+
+        std::string relative;
+        const auto& rules = level->m_rules;
+        // 同一层中最后一条匹配的规则生效
+        for (auto it = rules.rbegin(); it != rules.rend(); ++it) {
+            const DMIgnoreRule& rule = *it;
+            if (rule.dirOnly && !isDirectory) {
+                continue;
+            }
+
+            bool matched;
+            if (!rule.anchored) {
+                matched = rule.literal ? rule.pattern == name : Wildmatch(rule.pattern.c_str(), name.c_str());
+            } else {
+                if (relative.empty()) {
+                    relative = fullPath.substr(level->m_base.size());
+#ifdef _WIN32
+                    std::replace(relative.begin(), relative.end(), '\\', '/');
+#endif
+                }
+                matched = rule.literal ? rule.pattern == relative : Wildmatch(rule.pattern.c_str(), relative.c_str());
+            }
+
+            if (matched) {
+                return !rule.negate;
+            }
+        }
+    }
+    return false;
+}
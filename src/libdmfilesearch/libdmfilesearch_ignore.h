@@ -0,0 +1,70 @@
+// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef __LIBDMFILESEARCH_IGNORE_H_INCLUDE__
+#define __LIBDMFILESEARCH_IGNORE_H_INCLUDE__
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+// 一条 .gitignore 规则
+struct DMIgnoreRule {
+    std::string pattern;    // 去掉 '!'、前导 '/' 和末尾 '/' 之后的通配符
+    bool negate = false;    // '!' 开头, 重新包含
+    bool dirOnly = false;   // '/' 结尾, 只匹配目录
+    bool anchored = false;  // 含 '/', 相对规则文件所在目录匹配完整路径, 否则只匹配名称
+    bool literal = false;   // 不含通配符, 直接比较
+};
+
+// 某个目录的忽略规则 (.gitignore, .ignore, .esignore), 子目录共享并继承父目录的规则
+class DMIgnoreRules;
+
+// 目录路径 -> 该目录继承的忽略规则
+typedef std::unordered_map<std::string, std::shared_ptr<const DMIgnoreRules>> DMIgnoreCache;
+
+class DMIgnoreRules
+{
+public:
+    // 读取 dirPath 下的忽略文件. 没有任何规则时直接返回 parent, 不额外分配.
+    // dirFd >= 0 时在 POSIX 上相对该目录打开文件.
+    static std::shared_ptr<const DMIgnoreRules> Load(const std::shared_ptr<const DMIgnoreRules>& parent,
+        const std::string& dirPath, int dirFd);
+
+    // 从根路径 rootDir 起逐级读取到 dir, 得到 dir 继承的全部规则. 同一目录只读取一次
+    static std::shared_ptr<const DMIgnoreRules> LoadChain(const std::string& rootDir, const std::string& dir,
+        DMIgnoreCache& cache);
+
+    // fullPath 为条目完整路径, name 为其文件名
+    bool IsIgnored(const std::string& fullPath, const std::string& name, bool isDirectory) const;
+
+    // 解析一个忽略文件的内容, 追加到 rules
+    static void Parse(const std::string& content, std::vector<DMIgnoreRule>& rules);
+
+    // gitignore 风格通配符匹配: '*' '?' 不匹配 '/', '**' 跨目录, 支持 [...] 和 '\' 转义
+    static bool Wildmatch(const char* pattern, const char* text);
+
+private:
+    std::shared_ptr<const DMIgnoreRules> m_parent;
+    std::string m_base;     // 规则文件所在目录, 以分隔符结尾
+    std::vector<DMIgnoreRule> m_rules;
+};
+
+#endif
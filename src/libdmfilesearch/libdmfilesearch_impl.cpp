@@ -25,16 +25,33 @@
 #include <sstream>
 #include <chrono>
 #include <iomanip>
+#include <numeric>
 
 #include "libdmfilesearch_impl.h"
+#include "libdmfilesearch_serialize.h"
+#include "libdmfilesearch_regex.h"
+#include "libdmfilesearch_textscan.h"
 #include "dmformat.h"
 #include "dmstrtk.hpp"
 #include "dminicpp.h"
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
 namespace fs = std::filesystem;
 
+// 索引文件格式
+static const uint32_t DM_INDEX_MAGIC = 0x49464D44; // "DMFI"
+static const uint32_t DM_INDEX_VERSION = 5;
+
+// search_engine=auto 时, 少于此数量的索引逐项扫描名称区, 否则建立三元组索引
+static const size_t DM_AUTO_SCAN_LIMIT = 1000000;
+
 
 DmfilesearchImpl::DmfilesearchImpl()
+    : m_index(std::make_shared<DMIndexSnapshot>()), m_snapshot(m_index)
 {
 
 }
@@ -42,7 +59,7 @@ DmfilesearchImpl::DmfilesearchImpl()
 
 DmfilesearchImpl::~DmfilesearchImpl()
 {
-
+    StopWatch();
 }
 
 void DMAPI DmfilesearchImpl::Release(void) {
@@ -54,11 +71,16 @@ void DMAPI DmfilesearchImpl::Test(void) {
 }
 
 bool DMAPI DmfilesearchImpl::Init() {
-    m_fileIndex.clear();
-    m_nameIndex.clear();
+    {
+        std::lock_guard<std::mutex> lock(m_indexLock);
+        m_index = std::make_shared<DMIndexSnapshot>();
+        BuildNameIndex();
+        PublishIndex();
+    }
     m_includeExtensions.clear();
     m_excludeExtensions.clear();
     m_excludeDirectories.clear();
+    m_filtersDirty = true;
     m_searchOptions = DMSearchOptions();
 
     if(!ReadConfig() && WriteConfig())
@@ -131,6 +153,9 @@ bool DmfilesearchImpl::LoadConfig(const std::string& configFile) {
         std::string excludeExts = reader.Get<std::string>("filters", "exclude_extensions", "");
         std::string includeExts = reader.Get<std::string>("filters", "include_extensions", "");
         std::string excludeDirs = reader.Get<std::string>("filters", "exclude_directories", "");
+        m_config.filters.useIgnoreFiles = reader.Get<bool>("filters", "use_ignore_files", false);
+        std::string excludeFsTypes = reader.Get<std::string>("filters", "exclude_fs_types",
+            strtk::join(",", DMConfigFilters().excludeFsTypes));
 
         // 解析扩展名和目录
         m_config.filters.excludeExtensions.clear();
@@ -148,11 +173,35 @@ bool DmfilesearchImpl::LoadConfig(const std::string& configFile) {
             strtk::parse(excludeDirs, ",", m_config.filters.excludeDirectories);
         }
 
+        m_config.filters.excludeFsTypes.clear();
+        if (!excludeFsTypes.empty()) {
+            strtk::parse(excludeFsTypes, ",", m_config.filters.excludeFsTypes);
+        }
+
         // 读取索引配置
         m_config.index.autoSave = reader.Get<bool>("index", "auto_save", true);
         m_config.index.indexFile = reader.Get<std::string>("index", "index_file", "~/.es_index.dat");
         m_config.index.autoLoad = reader.Get<bool>("index", "auto_load", true);
         m_config.index.rebuildInterval = reader.Get<uint32_t>("index", "rebuild_interval", 3600);
+        m_config.index.crawlThreads = reader.Get<uint32_t>("index", "crawl_threads", 0);
+        m_config.index.deviceThreads = reader.Get<uint32_t>("index", "device_threads", 0);
+        m_config.index.networkFsThreads = reader.Get<uint32_t>("index", "network_fs_threads", 0);
+        m_config.index.oneFileSystem = reader.Get<bool>("index", "one_file_system", false);
+        m_config.index.lazyMetadata = reader.Get<bool>("index", "lazy_metadata", false);
+        m_config.index.batchStat = reader.Get<bool>("index", "batch_stat", false);
+        m_config.index.statQueueDepth = reader.Get<uint32_t>("index", "stat_queue_depth", 256);
+        m_config.index.watchBatchMs = reader.Get<uint32_t>("index", "watch_batch_ms", 200);
+        m_config.index.watchBackend = reader.Get<std::string>("index", "watch_backend", "inotify");
+        m_config.index.watchPollInterval = reader.Get<uint32_t>("index", "watch_poll_interval", 60);
+        m_config.index.progressiveInterval = reader.Get<uint32_t>("index", "progressive_interval_ms", 1000);
+        std::string priorityDirs = reader.Get<std::string>("index", "priority_directories", "");
+        m_config.index.priorityDirectories.clear();
+        if (!priorityDirs.empty()) {
+            strtk::parse(priorityDirs, ",", m_config.index.priorityDirectories);
+        }
+        m_config.index.checkpointInterval = reader.Get<uint32_t>("index", "checkpoint_interval", 60);
+        m_config.index.checkpointFile = reader.Get<std::string>("index", "checkpoint_file", "");
+        m_config.index.searchEngine = reader.Get<std::string>("index", "search_engine", "auto");
 
         std::cout << "配置文件加载成功: " << expandedPath << std::endl;
         return true;
@@ -192,6 +241,8 @@ bool DmfilesearchImpl::SaveConfig(const std::string& configFile) {
         ofs << "exclude_extensions=" << strtk::join(",", m_config.filters.excludeExtensions) << "\n";
         ofs << "include_extensions=" << strtk::join(",", m_config.filters.includeExtensions) << "\n";
         ofs << "exclude_directories=" << strtk::join(",", m_config.filters.excludeDirectories) << "\n";
+        ofs << "use_ignore_files=" << (m_config.filters.useIgnoreFiles ? "true" : "false") << "\n";
+        ofs << "exclude_fs_types=" << strtk::join(",", m_config.filters.excludeFsTypes) << "\n";
         ofs << "\n";
 
         // 写入索引配置
@@ -200,6 +251,21 @@ bool DmfilesearchImpl::SaveConfig(const std::string& configFile) {
         ofs << "index_file=" << m_config.index.indexFile << "\n";
         ofs << "auto_load=" << (m_config.index.autoLoad ? "true" : "false") << "\n";
         ofs << "rebuild_interval=" << m_config.index.rebuildInterval << "\n";
+        ofs << "crawl_threads=" << m_config.index.crawlThreads << "\n";
+        ofs << "device_threads=" << m_config.index.deviceThreads << "\n";
+        ofs << "network_fs_threads=" << m_config.index.networkFsThreads << "\n";
+        ofs << "one_file_system=" << (m_config.index.oneFileSystem ? "true" : "false") << "\n";
+        ofs << "lazy_metadata=" << (m_config.index.lazyMetadata ? "true" : "false") << "\n";
+        ofs << "batch_stat=" << (m_config.index.batchStat ? "true" : "false") << "\n";
+        ofs << "stat_queue_depth=" << m_config.index.statQueueDepth << "\n";
+        ofs << "watch_batch_ms=" << m_config.index.watchBatchMs << "\n";
+        ofs << "watch_backend=" << m_config.index.watchBackend << "\n";
+        ofs << "watch_poll_interval=" << m_config.index.watchPollInterval << "\n";
+        ofs << "progressive_interval_ms=" << m_config.index.progressiveInterval << "\n";
+        ofs << "priority_directories=" << strtk::join(",", m_config.index.priorityDirectories) << "\n";
+        ofs << "checkpoint_interval=" << m_config.index.checkpointInterval << "\n";
+        ofs << "checkpoint_file=" << m_config.index.checkpointFile << "\n";
+        ofs << "search_engine=" << m_config.index.searchEngine << "\n";
 
         std::cout << "配置文件保存成功: " << expandedPath << std::endl;
         return true;
@@ -213,123 +279,180 @@ bool DmfilesearchImpl::SaveConfig(const std::string& configFile) {
 
 
 void DMAPI DmfilesearchImpl::BuildIndex(const std::string& rootPath) {
-    if (m_indexing.load()) {
+    // 检查并置位在同一步完成, 两个线程不会同时开始构建
+    if (m_indexing.exchange(true)) {
         std::cout << "索引构建中，请稍候..." << std::endl;
         return;
     }
     
-    m_indexing = true;
+    StopWatch();
+    CompileFilters();
     
-    std::cout << "开始构建索引: " << rootPath << std::endl;
+    std::cout << "开始构建索引: " << rootPath << " (线程数: " << GetCrawlThreadCount() << ")" << std::endl;
     auto startTime = std::chrono::high_resolution_clock::now();
     
-    m_fileIndex.clear();
-    m_nameIndex.clear();
+    // 新索引写入新的快照, 构建期间搜索继续使用已发布的旧快照
+    std::lock_guard<std::mutex> lock(m_indexLock);
+    std::shared_ptr<DMIndexSnapshot> previous = std::atomic_load(&m_snapshot);
+    m_index = std::make_shared<DMIndexSnapshot>();
+    SetRootPaths(DMStringList{ rootPath });
+    
+    // 没有可用的旧索引 (冷启动) 时边遍历边发布部分索引
+    bool progressive = m_config.index.progressiveInterval > 0 && previous->fileIndex.empty();
+    std::unique_ptr<DMCrawlCheckpoint> checkpoint = CreateCheckpoint();
     
     try {
-        BuildIndexRecursive(rootPath);
+        BuildIndexRecursive(rootPath, progressive, checkpoint.get());
         BuildNameIndex();
+        PublishIndex();
         
         auto endTime = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
         
-        std::cout << "索引构建完成! 共索引 " << m_fileIndex.size() 
+        std::cout << "索引构建完成! 共索引 " << m_index->fileIndex.size() 
                   << " 个文件/文件夹，耗时 " << duration.count() << "ms" << std::endl;
+        PrintSnapshotMemory(*previous);
     } catch (const std::exception& e) {
         std::cerr << "构建索引时出错: " << e.what() << std::endl;
+        // 恢复旧索引, 构建中发布过部分索引时重新发布旧索引
+        m_index = previous;
+        m_pathIndex.clear();
+        m_pathIndexReady = false;
+        PublishIndex();
     }
     
     m_indexing = false;
 }
 
 void DMAPI DmfilesearchImpl::BuildIndexMultiple(const DMStringList& rootPaths) {
-    if (m_indexing.load()) {
+    if (m_indexing.exchange(true)) {
         std::cout << "索引构建中，请稍候..." << std::endl;
         return;
     }
     
-    m_indexing = true;
+    StopWatch();
+    CompileFilters();
     
     std::cout << "开始构建多路径索引..." << std::endl;
     auto startTime = std::chrono::high_resolution_clock::now();
     
-    m_fileIndex.clear();
-    m_nameIndex.clear();
+    // 新索引写入新的快照, 构建期间搜索继续使用已发布的旧快照
+    std::lock_guard<std::mutex> lock(m_indexLock);
+    std::shared_ptr<DMIndexSnapshot> previous = std::atomic_load(&m_snapshot);
+    m_index = std::make_shared<DMIndexSnapshot>();
+    SetRootPaths(rootPaths);
     
     try {
         for (const auto& rootPath : rootPaths) {
             std::cout << "索引路径: " << rootPath << std::endl;
-            BuildIndexRecursive(rootPath);
         }
         
+        // 各根路径并发遍历, 结束后统一合并; 没有可用的旧索引时边遍历边发布部分索引
+        bool progressive = m_config.index.progressiveInterval > 0 && previous->fileIndex.empty();
+        std::unique_ptr<DMCrawlCheckpoint> checkpoint = CreateCheckpoint();
+        CrawlRoots(rootPaths, progressive, checkpoint.get());
         BuildNameIndex();
+        PublishIndex();
         
         auto endTime = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
         
-        std::cout << "多路径索引构建完成! 共索引 " << m_fileIndex.size() 
+        std::cout << "多路径索引构建完成! 共索引 " << m_index->fileIndex.size() 
                   << " 个文件/文件夹，耗时 " << duration.count() << "ms" << std::endl;
+        PrintSnapshotMemory(*previous);
     } catch (const std::exception& e) {
         std::cerr << "构建索引时出错: " << e.what() << std::endl;
+        // 恢复旧索引, 构建中发布过部分索引时重新发布旧索引
+        m_index = previous;
+        m_pathIndex.clear();
+        m_pathIndexReady = false;
+        PublishIndex();
     }
     
     m_indexing = false;
 }
 
-void DmfilesearchImpl::BuildIndexRecursive(const std::string& directory) {
-    try {
-        if (!ShouldIncludeDirectory(directory)) {
-            return;
-        }
-        
-        for (const auto& entry : fs::recursive_directory_iterator(
-            directory, fs::directory_options::skip_permission_denied)) {
-            
-            const auto& path = entry.path();
-            std::string pathStr = path.string();
-            std::string fileName = path.filename().string();
-            
-            // 跳过隐藏文件（除非设置包含）
-            if (!m_searchOptions.includeHidden && fileName[0] == '.') {
-                continue;
-            }
-            
-            if (entry.is_directory()) {
-                if (!ShouldIncludeDirectory(pathStr)) {
-                    // std::cout << "排除目录: " << pathStr << std::endl;
-                    continue;
-                }
-            } else {
-                if (!ShouldIncludeFile(pathStr, fileName)) {
-                    std::cerr << "排除文件 (过滤器): " << pathStr << std::endl;
-                    continue;
-                }
-            }
-            
-            DMFileInfo fileInfo;
-            fileInfo.fullPath = pathStr;
-            fileInfo.fileName = fileName;
-            fileInfo.directory = path.parent_path().string();
-            fileInfo.isDirectory = entry.is_directory();
-            
-            if (!fileInfo.isDirectory) {
-                fileInfo.fileSize = GetFileSize(pathStr);
-            }
-            fileInfo.modifyTime = GetFileModifyTime(pathStr);
-            
-            m_fileIndex.push_back(fileInfo);
-        }
-    } catch (const fs::filesystem_error& e) {
-        std::cerr << "访问目录出错 " << directory << ": " << e.what() << std::endl;
+void DMAPI DmfilesearchImpl::BuildNameIndex(std::vector<uint32_t>* savedOrder) {
+    m_pathIndex.clear();
+    m_pathIndexReady = false;
+    m_index->nameIndex.Build(m_index->fileIndex);
+    if (!savedOrder || savedOrder->empty() ||
+        !m_index->nameOrder.Assign(m_index->fileIndex, std::move(*savedOrder), GetCrawlThreadCount())) {
+        m_index->nameOrder.Build(m_index->fileIndex, GetCrawlThreadCount());
+    }
+    BuildSearchIndex();
+}
+
+// 按配置的搜索引擎建立子串搜索用的索引, 之后随增量更新同步. auto 只在建立时按索引大小选择
+void DmfilesearchImpl::BuildSearchIndex() {
+    m_index->scanIndex.clear();
+    m_index->trigramIndex.clear();
+    m_index->suffixIndex.clear();
+    std::string engine = m_config.index.searchEngine;
+    if (engine == "auto") {
+        engine = m_index->fileIndex.size() < DM_AUTO_SCAN_LIMIT ? "scan" : "trigram";
+    }
+    if (engine == "trigram") {
+        m_index->trigramIndex.Build(m_index->fileIndex);
+    } else if (engine == "suffix") {
+        m_index->suffixIndex.Build(m_index->fileIndex);
+    } else {
+        m_index->scanIndex.Build(m_index->fileIndex);
+    }
+}
+
+std::shared_ptr<const DMIndexSnapshot> DmfilesearchImpl::AcquireSnapshot() const {
+    return std::atomic_load(&m_snapshot);
+}
+
+// 工作副本已发布 (被快照或搜索共享) 时先复制一份再修改, 下标不变, m_pathIndex 仍然有效.
+// 复制只复制各部分的块指针, 之后的修改只复制改到的块, 不复制整个索引
+void DmfilesearchImpl::BeginUpdate() {
+    if (m_index.use_count() > 1) {
+        m_index = std::make_shared<DMIndexSnapshot>(*m_index);
+        m_index->generation = 0;
+    }
+}
+
+// 原子替换已发布的快照; 旧快照在最后一个使用它的搜索结束后释放
+void DmfilesearchImpl::PublishIndex() {
+    if (m_index != m_snapshot) {
+        PublishSnapshot(m_index);
+    }
+}
+
+// 构建失败时重新发布的旧快照可能正被搜索读取, 保留其原有版本号
+void DmfilesearchImpl::PublishSnapshot(const std::shared_ptr<DMIndexSnapshot>& snapshot) {
+    uint64_t generation = ++m_generation;
+    if (snapshot->generation == 0) {
+        snapshot->generation = generation;
+    }
+    std::shared_ptr<const DMIndexSnapshot> previous = std::atomic_exchange(&m_snapshot, snapshot);
+    std::lock_guard<std::mutex> lock(m_retiredLock);
+    m_retired = previous;
+}
+
+static double DMMegabytes(size_t bytes) {
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+// 构建期间新旧两代索引同时驻留, 完成后报告两者的内存占用
+void DmfilesearchImpl::PrintSnapshotMemory(const DMIndexSnapshot& previous) const {
+    std::cout << std::fixed << std::setprecision(1) << "索引内存: 约 " << DMMegabytes(m_index->MemoryUsage()) << "MB";
+    if (!previous.fileIndex.empty()) {
+        std::cout << "，构建期间旧索引另占约 " << DMMegabytes(previous.MemoryUsage()) << "MB";
     }
+    std::cout << std::defaultfloat << std::endl;
 }
 
-void DMAPI DmfilesearchImpl::BuildNameIndex() {
-    m_nameIndex.clear();
-    for (size_t i = 0; i < m_fileIndex.size(); ++i) {
-        const auto& fileInfo = m_fileIndex[i];
-        std::string key = m_searchOptions.caseSensitive ? fileInfo.fileName : ToLower(fileInfo.fileName);
-        m_nameIndex[key].push_back(static_cast<uint32_t>(i));
+// 根路径去掉末尾分隔符, 与遍历时子项的 directory 字段一致
+void DmfilesearchImpl::SetRootPaths(const DMStringList& rootPaths) {
+    m_index->rootPaths.clear();
+    for (std::string rootPath : rootPaths) {
+        while (rootPath.size() > 1 && rootPath.back() == '/') {
+            rootPath.pop_back();
+        }
+        m_index->rootPaths.push_back(rootPath);
     }
 }
 
@@ -338,8 +461,14 @@ DMFileList* DMAPI DmfilesearchImpl::Search(const std::string& pattern) {
 }
 
 DMFileList* DMAPI DmfilesearchImpl::SearchWithOptions(const std::string& pattern, const DMSearchOptions& options) {
-    if (m_fileIndex.empty()) {
-        std::cout << "索引为空，请先构建索引" << std::endl;
+    // 持有快照引用期间, 构建或增量更新发布新快照不影响本次搜索
+    std::shared_ptr<const DMIndexSnapshot> snapshot = AcquireSnapshot();
+    if (snapshot->fileIndex.empty()) {
+        if (m_indexing.load()) {
+            std::cout << "索引构建中，请稍候..." << std::endl;
+        } else {
+            std::cout << "索引为空，请先构建索引" << std::endl;
+        }
         return new DMFileList();
     }
     
@@ -347,11 +476,22 @@ DMFileList* DMAPI DmfilesearchImpl::SearchWithOptions(const std::string& pattern
     DMFileList* results = new DMFileList();
     
     try {
-        SearchInIndex(pattern, options, *results);
+        std::vector<uint32_t> ids;
+        SearchInIndex(*snapshot, pattern, options, ids);
         
         // 限制结果数量
-        if (results->size() > options.maxResults) {
-            results->resize(options.maxResults);
+        if (ids.size() > options.maxResults) {
+            ids.resize(options.maxResults);
+        }
+        
+        // 只为返回的结果加载元数据; 快照只读, 加载结果不写回索引
+        results->reserve(ids.size());
+        for (uint32_t id : ids) {
+            results->push_back(snapshot->fileIndex.Get(id));
+            DMFileInfo& fileInfo = results->back();
+            if (!fileInfo.hasMetadata) {
+                LoadMetadata(fileInfo);
+            }
         }
         
         auto endTime = std::chrono::high_resolution_clock::now();
@@ -372,18 +512,26 @@ DMFileList* DMAPI DmfilesearchImpl::QuickSearch(const std::string& rootPath, con
     
     DMFileList* results = new DMFileList();
     DMSearchOptions options = m_searchOptions;
+    {
+        // 与监视线程的刷新共用编译后的过滤器
+        std::lock_guard<std::mutex> lock(m_indexLock);
+        CompileFilters();
+    }
     
     try {
-        for (const auto& entry : fs::recursive_directory_iterator(
-            rootPath, fs::directory_options::skip_permission_denied)) {
-            
+        fs::recursive_directory_iterator it(rootPath, fs::directory_options::skip_permission_denied);
+        for (; it != fs::recursive_directory_iterator(); ++it) {
+            const auto& entry = *it;
             const auto& path = entry.path();
             std::string pathStr = path.string();
             std::string fileName = path.filename().string();
             
-            // 应用过滤规则
+            // 应用过滤规则, 被排除的目录不再进入
             if (entry.is_directory()) {
-                if (!ShouldIncludeDirectory(pathStr)) continue;
+                if (!ShouldIncludeDirectory(pathStr)) {
+                    it.disable_recursion_pending();
+                    continue;
+                }
                 if (options.filesOnly) continue;
             } else {
                 if (!ShouldIncludeFile(pathStr, fileName)) continue;
@@ -400,6 +548,7 @@ DMFileList* DMAPI DmfilesearchImpl::QuickSearch(const std::string& rootPath, con
                 fileInfo.isDirectory = entry.is_directory();
                 fileInfo.fileSize = entry.is_directory() ? 0 : GetFileSize(pathStr);
                 fileInfo.modifyTime = GetFileModifyTime(pathStr);
+                fileInfo.hasMetadata = true;
                 
                 results->push_back(fileInfo);
                 
@@ -416,29 +565,154 @@ DMFileList* DMAPI DmfilesearchImpl::QuickSearch(const std::string& rootPath, con
     return results;
 }
 
-void DmfilesearchImpl::SearchInIndex(const std::string& pattern, const DMSearchOptions& options, DMFileList& results) const {
+void DmfilesearchImpl::SearchInIndex(const DMIndexSnapshot& index, const std::string& pattern, const DMSearchOptions& options,
+    std::vector<uint32_t>& ids) const {
     if (options.useRegex) {
-        SearchWithRegex(pattern, options, results);
+        SearchWithRegex(index, pattern, options, ids);
     } else {
-        SearchWithWildcard(pattern, options, results);
+        SearchWithWildcard(index, pattern, options, ids);
     }
 }
 
-void DmfilesearchImpl::SearchWithWildcard(const std::string& pattern, const DMSearchOptions& options, DMFileList& results) const {
-    for (const auto& fileInfo : m_fileIndex) {
-        // 应用文件类型过滤
-        if (options.dirsOnly && !fileInfo.isDirectory) continue;
-        if (options.filesOnly && fileInfo.isDirectory) continue;
-        
-        std::string searchText = options.searchInPath ? fileInfo.fullPath : fileInfo.fileName;
+void DmfilesearchImpl::SelectCandidates(const DMIndexSnapshot& index, const DMSearchOptions& options,
+    DMBitmap& candidates) const {
+    // 类型过滤只看标志列, 在匹配名称之前一次求出候选集
+    DMEntryFilter filter;
+    if (options.dirsOnly) {
+        filter.flagMask = DM_FILE_DIRECTORY;
+        filter.flagValue = DM_FILE_DIRECTORY;
+    } else if (options.filesOnly) {
+        filter.flagMask = DM_FILE_DIRECTORY;
+        filter.flagValue = 0;
+    }
+    DMSelectEntries(index.fileIndex, filter, candidates);
+}
+
+// 用子串索引筛选出名称 (或完整路径) 包含 literal 的候选. 三元组索引和后缀数组按小写建立, 区分大小写时同样适用,
+// 得到的候选需要调用方逐项校验; 扫描名称区时结果是精确的, 返回 true
+bool DmfilesearchImpl::SelectByLiteral(const DMIndexSnapshot& index, std::string_view literal, const DMSearchOptions& options,
+    DMBitmap& candidates) const {
+    if (literal.empty()) {
+        return false;
+    }
+    if (index.trigramIndex.Ready()) {
+        index.trigramIndex.Select(index.fileIndex, ToLower(std::string(literal)), options.searchInPath, candidates);
+    } else if (index.suffixIndex.Ready()) {
+        index.suffixIndex.Select(ToLower(std::string(literal)), options.searchInPath, candidates);
+    } else if (index.scanIndex.Ready()) {
+        index.scanIndex.Select(index.fileIndex, literal, !options.caseSensitive, options.searchInPath, candidates);
+        return true;
+    }
+    return false;
+}
+
+void DmfilesearchImpl::SearchWithWildcard(const DMIndexSnapshot& index, const std::string& pattern, const DMSearchOptions& options,
+    std::vector<uint32_t>& ids) const {
+    DMBitmap candidates;
+    SelectCandidates(index, options, candidates);
+
+    // 不区分大小写时模式只转换一次, 直接与索引中的小写副本比较; 通配符模式同样只编译一次
+    const std::string searchPattern = options.caseSensitive ? pattern : ToLower(pattern);
+    const DMGlobMatcher glob(searchPattern);
+    const DMFileTable& fileIndex = index.fileIndex;
+
+    // 前缀查询和 prefix* 是名称顺序中的一段连续区间
+    std::string prefix;
+    if (options.prefixMatch) {
+        prefix = pattern;
+    } else if (glob.GetKind() == DMGlobMatcher::DM_GLOB_PREFIX) {
+        prefix = pattern.substr(0, pattern.find('*'));
+    }
+    if ((options.prefixMatch || !prefix.empty()) && !options.wholeWord && !options.searchInPath &&
+        index.nameOrder.Ready()) {
+        std::vector<uint32_t> matches;
+        index.nameOrder.Prefix(fileIndex, ToLower(prefix), matches);
+        for (uint32_t id : matches) {
+            if (candidates.Test(id) && (!options.caseSensitive || fileIndex.Name(id).substr(0, prefix.size()) == prefix)) {
+                ids.push_back(id);
+            }
+        }
+        return;
+    }
+
+    // 全词查询即整个名称相同, 直接查名称哈希表
+    if (options.wholeWord && !options.searchInPath && index.nameIndex.Ready()) {
+        std::vector<uint32_t> matches;
+        index.nameIndex.Lookup(fileIndex, ToLower(pattern), matches);
+        for (uint32_t id : matches) {
+            if (candidates.Test(id) && (!options.caseSensitive || fileIndex.Name(id) == pattern)) {
+                ids.push_back(id);
+            }
+        }
+        return;
+    }
+
+    // 按模式中必须出现的字面文本筛选候选; 扫描名称区的结果是精确的, 不含通配符的子串查询直接返回
+    if (SelectByLiteral(index, glob.RequiredLiteral(), options, candidates) &&
+        !glob.HasWildcard() && !options.wholeWord && !options.prefixMatch) {
+        candidates.ForEach([&](uint32_t i) { ids.push_back(i); });
+        return;
+    }
+
+    // 完整路径拼到同一个缓冲区中, 不为每一项分配内存
+    std::string pathBuffer;
+    candidates.ForEach([&](uint32_t i) {
+        std::string_view searchText;
+        if (options.searchInPath) {
+            if (options.caseSensitive) {
+                fileIndex.FullPath(i, pathBuffer);
+            } else {
+                fileIndex.FoldedFullPath(i, pathBuffer);
+            }
+            searchText = pathBuffer;
+        } else {
+            searchText = options.caseSensitive ? fileIndex.Name(i) : fileIndex.FoldedName(i);
+        }
         
-        if (MatchPattern(searchText, pattern, options)) {
-            results.push_back(fileInfo);
+        if (MatchFoldedText(searchText, searchPattern, glob, options)) {
+            ids.push_back(i);
         }
+    });
+}
+
+void DmfilesearchImpl::SearchWithRegex(const DMIndexSnapshot& index, const std::string& pattern, const DMSearchOptions& options,
+    std::vector<uint32_t>& ids) const {
+    DMRegex regex;
+    if (!regex.Compile(pattern, !options.caseSensitive)) {
+        SearchWithStdRegex(index, pattern, options, ids);
+        return;
     }
+
+    DMBitmap candidates;
+    SelectCandidates(index, options, candidates);
+
+    // 先按模式中必须出现的字面文本筛选, 子串索引不可用时逐项查找字面文本, 通过的再交给自动机
+    const std::string& literal = regex.RequiredLiteral();
+    const bool exact = SelectByLiteral(index, literal, options, candidates);
+    const bool checkLiteral = !literal.empty() && !exact;
+
+    std::string pathBuffer;
+    candidates.ForEach([&](uint32_t i) {
+        std::string_view searchText;
+        if (options.searchInPath) {
+            index.fileIndex.FullPath(i, pathBuffer);
+            searchText = pathBuffer;
+        } else {
+            searchText = index.fileIndex.Name(i);
+        }
+
+        if (checkLiteral && DMFindText(searchText, 0, literal, !options.caseSensitive) == std::string_view::npos) {
+            return;
+        }
+        if (regex.Search(searchText)) {
+            ids.push_back(i);
+        }
+    });
 }
 
-void DmfilesearchImpl::SearchWithRegex(const std::string& pattern, const DMSearchOptions& options, DMFileList& results) const {
+// DMRegex 不支持的语法 (反向引用、前瞻等) 用 std::regex 逐项匹配, 语法错误也在这里报告
+void DmfilesearchImpl::SearchWithStdRegex(const DMIndexSnapshot& index, const std::string& pattern, const DMSearchOptions& options,
+    std::vector<uint32_t>& ids) const {
     try {
         std::regex_constants::syntax_option_type regexFlags = std::regex_constants::ECMAScript;
         if (!options.caseSensitive) {
@@ -447,88 +721,195 @@ void DmfilesearchImpl::SearchWithRegex(const std::string& pattern, const DMSearc
         
         std::regex regexPattern(pattern, regexFlags);
         
-        for (const auto& fileInfo : m_fileIndex) {
-            if (options.dirsOnly && !fileInfo.isDirectory) continue;
-            if (options.filesOnly && fileInfo.isDirectory) continue;
-            
-            std::string searchText = options.searchInPath ? fileInfo.fullPath : fileInfo.fileName;
+        DMBitmap candidates;
+        SelectCandidates(index, options, candidates);
+
+        std::string pathBuffer;
+        candidates.ForEach([&](uint32_t i) {
+            std::string_view searchText;
+            if (options.searchInPath) {
+                index.fileIndex.FullPath(i, pathBuffer);
+                searchText = pathBuffer;
+            } else {
+                searchText = index.fileIndex.Name(i);
+            }
             
-            if (std::regex_search(searchText, regexPattern)) {
-                results.push_back(fileInfo);
+            if (std::regex_search(searchText.begin(), searchText.end(), regexPattern)) {
+                ids.push_back(i);
             }
-        }
+        });
     } catch (const std::regex_error& e) {
         std::cerr << "正则表达式错误: " << e.what() << std::endl;
     }
 }
 
 bool DMAPI DmfilesearchImpl::MatchPattern(const std::string& text, const std::string& pattern, const DMSearchOptions& options) const {
-    std::string searchText = options.caseSensitive ? text : ToLower(text);
-    std::string searchPattern = options.caseSensitive ? pattern : ToLower(pattern);
-    
+    if (options.caseSensitive) {
+        return MatchFoldedText(text, pattern, DMGlobMatcher(pattern), options);
+    }
+    const std::string searchPattern = ToLower(pattern);
+    return MatchFoldedText(ToLower(text), searchPattern, DMGlobMatcher(searchPattern), options);
+}
+
+// 不区分大小写时 text 和 pattern 都已转换为小写, glob 由 pattern 编译
+bool DmfilesearchImpl::MatchFoldedText(std::string_view searchText, const std::string& searchPattern,
+    const DMGlobMatcher& glob, const DMSearchOptions& options) const {
     if (options.wholeWord) {
         return searchText == searchPattern;
     }
+    if (options.prefixMatch) {
+        return searchText.substr(0, searchPattern.size()) == searchPattern;
+    }
     
-    // 简单通配符支持
-    if (searchPattern.find('*') != std::string::npos || searchPattern.find('?') != std::string::npos) {
-        // 转换为正则表达式
-        std::string regexPattern = searchPattern;
-        std::replace(regexPattern.begin(), regexPattern.end(), '*', '.');
-        regexPattern += "*";
-        std::replace(regexPattern.begin(), regexPattern.end(), '?', '.');
-        
-        try {
-            std::regex regex(regexPattern, options.caseSensitive ? 
-                std::regex_constants::ECMAScript : 
-                std::regex_constants::ECMAScript | std::regex_constants::icase);
-            return std::regex_search(searchText, regex);
-        } catch (const std::regex_error&) {
-            // 如果正则表达式无效，回退到简单匹配
-            return searchText.find(searchPattern) != std::string::npos;
-        }
+    // 含通配符时模式须匹配整个名称 (或完整路径)
+    if (glob.HasWildcard()) {
+        return glob.Match(searchText);
     }
     
-    return searchText.find(searchPattern) != std::string::npos;
+    return DMFindText(searchText, 0, searchPattern, false) != std::string_view::npos;
 }
 
 void DMAPI DmfilesearchImpl::ClearIndex() {
-    m_fileIndex.clear();
-    m_nameIndex.clear();
+    StopWatch();
+    std::lock_guard<std::mutex> lock(m_indexLock);
+    m_index = std::make_shared<DMIndexSnapshot>();
+    BuildNameIndex();
+    PublishIndex();
     std::cout << "索引已清空" << std::endl;
 }
 
 uint32_t DMAPI DmfilesearchImpl::GetIndexedFileCount() {
-    return static_cast<uint32_t>(m_fileIndex.size());
+    return static_cast<uint32_t>(AcquireSnapshot()->fileIndex.size());
+}
+
+uint64_t DMAPI DmfilesearchImpl::GetIndexGeneration() {
+    return m_generation.load();
+}
+
+DMIndexProgress DMAPI DmfilesearchImpl::GetIndexProgress() {
+    return AcquireSnapshot()->progress;
+}
+
+void DMAPI DmfilesearchImpl::PrintIndexStats() {
+    std::shared_ptr<const DMIndexSnapshot> snapshot = AcquireSnapshot();
+    size_t directoryCount = 0;
+    for (uint32_t i = 0; i < snapshot->fileIndex.size(); ++i) {
+        if (snapshot->fileIndex.IsDirectory(i)) {
+            ++directoryCount;
+        }
+    }
+
+    std::cout << "索引项总数: " << snapshot->fileIndex.size() << std::endl;
+    std::cout << "  目录: " << directoryCount << std::endl;
+    std::cout << "  文件: " << snapshot->fileIndex.size() - directoryCount << std::endl;
+
+    // 上一代快照仍被进行中的搜索引用时, 两代同时占用内存
+    std::shared_ptr<const DMIndexSnapshot> retired;
+    {
+        std::lock_guard<std::mutex> lock(m_retiredLock);
+        retired = m_retired.lock();
+    }
+    std::cout << std::fixed << std::setprecision(1) << "索引内存: 约 " << DMMegabytes(snapshot->MemoryUsage())
+              << "MB (版本 " << snapshot->generation << ")";
+    if (retired && retired != snapshot) {
+        std::cout << "，上一代 (版本 " << retired->generation << ") 仍被引用，另占约 "
+                  << DMMegabytes(retired->MemoryUsage()) << "MB";
+    }
+    std::cout << std::defaultfloat << std::endl;
+    if (snapshot->nameIndex.Ready()) {
+        std::cout << std::fixed << std::setprecision(1) << "名称索引: " << snapshot->nameIndex.KeyCount()
+                  << " 个不同名称，约 " << DMMegabytes(snapshot->nameIndex.MemoryUsage()) << "MB"
+                  << std::defaultfloat << std::endl;
+    }
+    if (snapshot->nameOrder.Ready()) {
+        std::cout << std::fixed << std::setprecision(1) << "名称顺序: 约 " << DMMegabytes(snapshot->nameOrder.MemoryUsage())
+                  << "MB，";
+        if (snapshot->nameOrder.FromFile()) {
+            std::cout << "从索引文件读取";
+        } else {
+            std::cout << "排序耗时 " << snapshot->nameOrder.BuildMicroseconds() / 1000.0 << "ms";
+        }
+        std::cout << std::defaultfloat << std::endl;
+    }
+    if (snapshot->scanIndex.Ready()) {
+        std::cout << std::fixed << std::setprecision(1) << "名称区扫描: " << DMTextScanKernel() << "，映射表约 "
+                  << DMMegabytes(snapshot->scanIndex.MemoryUsage()) << "MB" << std::defaultfloat << std::endl;
+    }
+    if (snapshot->trigramIndex.Ready()) {
+        std::cout << std::fixed << std::setprecision(1) << "三元组索引: " << snapshot->trigramIndex.TrigramCount()
+                  << " 个三元组，约 " << DMMegabytes(snapshot->trigramIndex.MemoryUsage()) << "MB，构建耗时 "
+                  << snapshot->trigramIndex.BuildMicroseconds() / 1000.0 << "ms" << std::defaultfloat << std::endl;
+    }
+    if (snapshot->suffixIndex.Ready()) {
+        std::cout << std::fixed << std::setprecision(1) << "后缀数组: " << snapshot->suffixIndex.SuffixCount()
+                  << " 个后缀，约 " << DMMegabytes(snapshot->suffixIndex.MemoryUsage()) << "MB，构建耗时 "
+                  << snapshot->suffixIndex.BuildMicroseconds() / 1000.0 << "ms" << std::defaultfloat << std::endl;
+    }
+
+    if (!snapshot->mounts.empty()) {
+        std::cout << "挂载点:" << std::endl;
+        for (const auto& mount : snapshot->mounts) {
+            std::cout << "  " << std::left << std::setw(32) << mount.mountPoint
+                << " " << std::setw(12) << mount.fsType
+                << mount.entryCount << " 项" << std::endl;
+        }
+    }
 }
 
 bool DMAPI DmfilesearchImpl::SaveIndex(const std::string& indexFile) {
+    std::shared_ptr<const DMIndexSnapshot> snapshot = AcquireSnapshot();
+    if (!snapshot->progress.complete) {
+        std::cerr << "索引尚未构建完成，暂不保存" << std::endl;
+        return false;
+    }
     try {
         std::ofstream ofs(indexFile, std::ios::binary);
         if (!ofs) return false;
         
-        // 写入文件数量
-        uint32_t count = static_cast<uint32_t>(m_fileIndex.size());
-        ofs.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        // 写入文件头
+        DMWriteValue(ofs, DM_INDEX_MAGIC);
+        DMWriteValue(ofs, DM_INDEX_VERSION);
         
         // 写入文件信息
-        for (const auto& fileInfo : m_fileIndex) {
-            uint32_t pathLen = static_cast<uint32_t>(fileInfo.fullPath.length());
-            uint32_t nameLen = static_cast<uint32_t>(fileInfo.fileName.length());
-            uint32_t dirLen = static_cast<uint32_t>(fileInfo.directory.length());
-            
-            ofs.write(reinterpret_cast<const char*>(&pathLen), sizeof(pathLen));
-            ofs.write(fileInfo.fullPath.c_str(), pathLen);
-            
-            ofs.write(reinterpret_cast<const char*>(&nameLen), sizeof(nameLen));
-            ofs.write(fileInfo.fileName.c_str(), nameLen);
-            
-            ofs.write(reinterpret_cast<const char*>(&dirLen), sizeof(dirLen));
-            ofs.write(fileInfo.directory.c_str(), dirLen);
-            
-            ofs.write(reinterpret_cast<const char*>(&fileInfo.fileSize), sizeof(fileInfo.fileSize));
-            ofs.write(reinterpret_cast<const char*>(&fileInfo.modifyTime), sizeof(fileInfo.modifyTime));
-            ofs.write(reinterpret_cast<const char*>(&fileInfo.isDirectory), sizeof(fileInfo.isDirectory));
+        DMWriteValue(ofs, static_cast<uint32_t>(snapshot->fileIndex.size()));
+        for (uint32_t i = 0; i < snapshot->fileIndex.size(); ++i) {
+            DMWriteFileInfo(ofs, snapshot->fileIndex.Get(i));
+        }
+        
+        // 写入挂载点 (版本2)
+        DMWriteValue(ofs, static_cast<uint32_t>(snapshot->mounts.size()));
+        for (const auto& mount : snapshot->mounts) {
+            DMWriteString(ofs, mount.mountPoint);
+            DMWriteString(ofs, mount.fsType);
+            DMWriteValue(ofs, mount.device);
+            DMWriteValue(ofs, mount.entryCount);
+        }
+        
+        // 写入根路径 (版本3)
+        DMWriteValue(ofs, static_cast<uint32_t>(snapshot->rootPaths.size()));
+        for (const auto& rootPath : snapshot->rootPaths) {
+            DMWriteString(ofs, rootPath);
+        }
+        
+        // 写入目录时间戳 (版本4)
+        DMWriteValue(ofs, static_cast<uint32_t>(snapshot->dirStamps.size()));
+        snapshot->dirStamps.ForEach([&](const std::string& dir, const DMDirStamp& stamp) {
+            DMWriteString(ofs, dir);
+            DMWriteValue(ofs, stamp.mtime);
+            DMWriteValue(ofs, stamp.ctime);
+        });
+        
+        // 写入名称顺序 (版本5), 去掉删除留下的空位; 有未排序的新增项时写入空顺序, 加载时重新排序
+        const DMNameOrder& nameOrder = snapshot->nameOrder;
+        if (nameOrder.Complete()) {
+            DMWriteValue(ofs, static_cast<uint32_t>(snapshot->fileIndex.size()));
+            for (uint32_t id : nameOrder.Order()) {
+                if (id != DMNameOrder::NONE) {
+                    DMWriteValue(ofs, id);
+                }
+            }
+        } else {
+            DMWriteValue(ofs, static_cast<uint32_t>(0));
         }
         
         std::cout << "索引已保存到: " << indexFile << std::endl;
@@ -540,44 +921,107 @@ bool DMAPI DmfilesearchImpl::SaveIndex(const std::string& indexFile) {
 }
 
 bool DMAPI DmfilesearchImpl::LoadIndex(const std::string& indexFile) {
+    StopWatch();
+    std::lock_guard<std::mutex> lock(m_indexLock);
     try {
         std::ifstream ifs(indexFile, std::ios::binary);
         if (!ifs) return false;
         
-        m_fileIndex.clear();
+        // 读入新快照, 读取失败时保留原索引
+        std::shared_ptr<DMIndexSnapshot> index = std::make_shared<DMIndexSnapshot>();
         
-        // 读取文件数量
-        uint32_t count;
-        ifs.read(reinterpret_cast<char*>(&count), sizeof(count));
+        // 读取文件头, 旧格式没有文件头, 直接以文件数量开始
+        uint32_t version = 0;
+        uint32_t count = 0;
+        DMReadValue(ifs, count);
+        if (count == DM_INDEX_MAGIC) {
+            DMReadValue(ifs, version);
+            if (version > DM_INDEX_VERSION) {
+                std::cerr << "不支持的索引文件版本: " << version << std::endl;
+                return false;
+            }
+            DMReadValue(ifs, count);
+        }
         
-        m_fileIndex.reserve(count);
+        index->fileIndex.reserve(count);
         
         // 读取文件信息
         for (uint32_t i = 0; i < count; ++i) {
             DMFileInfo fileInfo;
+            if (version == 0) {
+                DMReadString(ifs, fileInfo.fullPath);
+                DMReadString(ifs, fileInfo.fileName);
+                DMReadString(ifs, fileInfo.directory);
+                DMReadValue(ifs, fileInfo.fileSize);
+                DMReadValue(ifs, fileInfo.modifyTime);
+                DMReadValue(ifs, fileInfo.isDirectory);
+                fileInfo.hasMetadata = true;
+            } else {
+                DMReadFileInfo(ifs, fileInfo);
+            }
             
-            uint32_t pathLen, nameLen, dirLen;
-            
-            ifs.read(reinterpret_cast<char*>(&pathLen), sizeof(pathLen));
-            fileInfo.fullPath.resize(pathLen);
-            ifs.read(&fileInfo.fullPath[0], pathLen);
-            
-            ifs.read(reinterpret_cast<char*>(&nameLen), sizeof(nameLen));
-            fileInfo.fileName.resize(nameLen);
-            ifs.read(&fileInfo.fileName[0], nameLen);
-            
-            ifs.read(reinterpret_cast<char*>(&dirLen), sizeof(dirLen));
-            fileInfo.directory.resize(dirLen);
-            ifs.read(&fileInfo.directory[0], dirLen);
-            
-            ifs.read(reinterpret_cast<char*>(&fileInfo.fileSize), sizeof(fileInfo.fileSize));
-            ifs.read(reinterpret_cast<char*>(&fileInfo.modifyTime), sizeof(fileInfo.modifyTime));
-            ifs.read(reinterpret_cast<char*>(&fileInfo.isDirectory), sizeof(fileInfo.isDirectory));
-            
-            m_fileIndex.push_back(fileInfo);
+            index->fileIndex.Append(fileInfo);
         }
+        index->fileIndex.shrink_to_fit();
         
-        BuildNameIndex();
+        // 读取挂载点 (版本2)
+        if (version >= 2) {
+            uint32_t mountCount = 0;
+            DMReadValue(ifs, mountCount);
+            for (uint32_t i = 0; i < mountCount && ifs; ++i) {
+                DMIndexMount mount;
+                DMReadString(ifs, mount.mountPoint);
+                DMReadString(ifs, mount.fsType);
+                DMReadValue(ifs, mount.device);
+                DMReadValue(ifs, mount.entryCount);
+                index->mounts.push_back(mount);
+            }
+        }
+        
+        // 读取根路径 (版本3)
+        if (version >= 3) {
+            uint32_t rootCount = 0;
+            DMReadValue(ifs, rootCount);
+            for (uint32_t i = 0; i < rootCount && ifs; ++i) {
+                std::string rootPath;
+                DMReadString(ifs, rootPath);
+                index->rootPaths.push_back(rootPath);
+            }
+        }
+        
+        // 读取目录时间戳 (版本4)
+        if (version >= 4) {
+            uint32_t stampCount = 0;
+            DMReadValue(ifs, stampCount);
+            for (uint32_t i = 0; i < stampCount && ifs; ++i) {
+                std::string dirPath;
+                DMDirStamp stamp;
+                DMReadString(ifs, dirPath);
+                DMReadValue(ifs, stamp.mtime);
+                DMReadValue(ifs, stamp.ctime);
+                index->dirStamps[dirPath] = stamp;
+            }
+        }
+        
+        // 读取名称顺序 (版本5), 与索引项不一致时在 BuildNameIndex 中重新排序
+        std::vector<uint32_t> nameOrder;
+        if (version >= 5) {
+            uint32_t orderCount = 0;
+            DMReadValue(ifs, orderCount);
+            if (orderCount == count) {
+                nameOrder.resize(orderCount);
+                for (uint32_t i = 0; i < orderCount && ifs; ++i) {
+                    DMReadValue(ifs, nameOrder[i]);
+                }
+                if (!ifs) {
+                    nameOrder.clear();
+                }
+            }
+        }
+        
+        m_index = index;
+        BuildNameIndex(&nameOrder);
+        PublishIndex();
         
         std::cout << "索引已从文件加载: " << indexFile << " (共" << count << "项)" << std::endl;
         return true;
@@ -587,22 +1031,30 @@ bool DMAPI DmfilesearchImpl::LoadIndex(const std::string& indexFile) {
     }
 }
 
+// 过滤规则和配置由监视线程在持有 m_indexLock 时读取, 修改时同样持有
 void DMAPI DmfilesearchImpl::AddIncludeExtension(const std::string& extension) {
+    std::lock_guard<std::mutex> lock(m_indexLock);
     m_includeExtensions.insert(ToLower(extension));
 }
 
 void DMAPI DmfilesearchImpl::AddExcludeExtension(const std::string& extension) {
+    std::lock_guard<std::mutex> lock(m_indexLock);
     m_excludeExtensions.insert(ToLower(extension));
 }
 
 void DMAPI DmfilesearchImpl::AddExcludeDirectory(const std::string& directory) {
-    m_excludeDirectories.insert(directory);
+    std::lock_guard<std::mutex> lock(m_indexLock);
+    if (m_excludeDirectories.insert(directory).second) {
+        m_filtersDirty = true;
+    }
 }
 
 void DMAPI DmfilesearchImpl::ClearFilters() {
+    std::lock_guard<std::mutex> lock(m_indexLock);
     m_includeExtensions.clear();
     m_excludeExtensions.clear();
     m_excludeDirectories.clear();
+    m_filtersDirty = true;
 }
 
 void DMAPI DmfilesearchImpl::SetSearchOptions(const DMSearchOptions& options) {
@@ -613,13 +1065,40 @@ DMSearchOptions DMAPI DmfilesearchImpl::GetSearchOptions() {
     return m_searchOptions;
 }
 
+void DMAPI DmfilesearchImpl::SetConfig(const DMConfigData& config) {
+    std::lock_guard<std::mutex> lock(m_indexLock);
+    bool engineChanged = config.index.searchEngine != m_config.index.searchEngine;
+    m_config = config;
+    if (engineChanged) {
+        if (!m_index->fileIndex.empty()) {
+            BeginUpdate();
+            BuildSearchIndex();
+            PublishIndex();
+        }
+    }
+}
+
+DMConfigData DMAPI DmfilesearchImpl::GetConfig() {
+    return m_config;
+}
+
 void DMAPI DmfilesearchImpl::PrintResults(const DMFileList& results) {
+    // 结果来自尚未构建完成的索引时给出提示
+    DMIndexProgress progress = GetIndexProgress();
     if (results.empty()) {
-        std::cout << "未找到匹配的文件" << std::endl;
+        std::cout << "未找到匹配的文件";
+        if (!progress.complete) {
+            std::cout << " (索引尚未构建完成)";
+        }
+        std::cout << std::endl;
         return;
     }
     
     std::cout << "\n搜索结果 (共 " << results.size() << " 项):" << std::endl;
+    if (!progress.complete) {
+        std::cout << "索引尚未构建完成 (已遍历 " << progress.crawledDirs << " 个目录，待遍历 "
+                  << progress.pendingDirs << " 个)，结果可能不完整" << std::endl;
+    }
     std::cout << std::string(80, '-') << std::endl;
     
     for (const auto& fileInfo : results) {
@@ -633,11 +1112,36 @@ void DMAPI DmfilesearchImpl::PrintResults(const DMFileList& results) {
 }
 
 void DMAPI DmfilesearchImpl::SortResults(DMFileList& results, const std::string& sortBy) {
+    // 按大小或时间排序时只为参与排序的结果加载元数据
+    if (sortBy == "size" || sortBy == "date") {
+        for (auto& fileInfo : results) {
+            if (!fileInfo.hasMetadata) {
+                LoadMetadata(fileInfo);
+            }
+        }
+    }
+
     if (sortBy == "name") {
-        std::sort(results.begin(), results.end(), 
-            [](const DMFileInfo& a, const DMFileInfo& b) {
-                return a.fileName < b.fileName;
-            });
+        // 按小写名称稳定排序. 搜索结果按编号从小到大排列, 同名的项仍按编号排列, 与索引的名称顺序一致
+        std::vector<std::string> folded(results.size());
+        for (size_t i = 0; i < results.size(); ++i) {
+            folded[i] = ToLower(results[i].fileName);
+        }
+        // 已按名称排列时 (例如全词查询的结果都同名) 不再排序
+        if (std::is_sorted(folded.begin(), folded.end())) {
+            return;
+        }
+        std::vector<uint32_t> order(results.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&folded](uint32_t a, uint32_t b) {
+            return folded[a] < folded[b];
+        });
+        DMFileList sorted;
+        sorted.reserve(results.size());
+        for (uint32_t i : order) {
+            sorted.push_back(std::move(results[i]));
+        }
+        results = std::move(sorted);
     } else if (sortBy == "size") {
         std::sort(results.begin(), results.end(), 
             [](const DMFileInfo& a, const DMFileInfo& b) {
@@ -657,7 +1161,8 @@ void DMAPI DmfilesearchImpl::SortResults(DMFileList& results, const std::string&
 }
 
 // 辅助函数实现
-bool DmfilesearchImpl::ShouldIncludeFile(const std::string& filePath, const std::string& fileName) const {
+bool DmfilesearchImpl::ShouldIncludeFile(const std::string& filePath, const std::string& fileName,
+    const DMIgnoreRules* ignoreRules) const {
     std::string ext = GetFileExtension(fileName);
     
     // 检查排除扩展名
@@ -676,16 +1181,45 @@ bool DmfilesearchImpl::ShouldIncludeFile(const std::string& filePath, const std:
         }
     }
     
+    // 检查 .gitignore/.ignore/.esignore 规则
+    if (ignoreRules && ignoreRules->IsIgnored(filePath, fileName, false)) {
+        return false;
+    }
+    
     return true;
 }
 
 bool DmfilesearchImpl::ShouldIncludeDirectory(const std::string& dirPath) const {
-    for (const auto& excludeDir : m_excludeDirectories) {
-        if (dirPath.find(excludeDir) != std::string::npos) {
-            return false;
-        }
+    return !m_excludeMatcher.Match(dirPath);
+}
+
+// 子目录路径以父目录路径开头时, 从父目录的匹配状态继续扫描新增部分
+bool DmfilesearchImpl::ShouldIncludeSubdirectory(const DMCrawlItem& parent, const std::string& dirPath, const std::string& dirName,
+    const DMIgnoreRules* ignoreRules, uint32_t& state) const {
+    const std::string& parentPath = parent.path;
+    bool excluded;
+    if (dirPath.size() >= parentPath.size() && dirPath.compare(0, parentPath.size(), parentPath) == 0) {
+        state = parent.excludeState;
+        excluded = m_excludeMatcher.Scan(dirPath.data() + parentPath.size(), dirPath.size() - parentPath.size(), state);
+    } else {
+        state = DMExcludeMatcher::ROOT_STATE;
+        excluded = m_excludeMatcher.Scan(dirPath.data(), dirPath.size(), state);
     }
-    return true;
+    if (excluded) {
+        return false;
+    }
+
+    // 检查 .gitignore/.ignore/.esignore 规则
+    return !ignoreRules || !ignoreRules->IsIgnored(dirPath, dirName, true);
+}
+
+// 过滤规则变化后重新编译, 在开始遍历前调用
+void DmfilesearchImpl::CompileFilters() {
+    if (!m_filtersDirty) {
+        return;
+    }
+    m_excludeMatcher.Build(m_excludeDirectories);
+    m_filtersDirty = false;
 }
 
 std::string DmfilesearchImpl::GetFileExtension(const std::string& fileName) const {
@@ -720,6 +1254,21 @@ uint64_t DmfilesearchImpl::GetFileModifyTime(const std::string& filePath) const
     }
 }
 
+void DmfilesearchImpl::LoadMetadata(DMFileInfo& fileInfo) const {
+#ifdef _WIN32
+    DMFillFileInfo(fileInfo, !fileInfo.isDirectory, fileInfo.isDirectory ? 0 : GetFileSize(fileInfo.fullPath),
+        GetFileModifyTime(fileInfo.fullPath));
+#else
+    struct stat st;
+    if (fstatat(AT_FDCWD, fileInfo.fullPath.c_str(), &st, 0) == 0) {
+        DMFillFileInfo(fileInfo, S_ISREG(st.st_mode), static_cast<uint64_t>(st.st_size),
+            static_cast<uint64_t>(st.st_mtime));
+    } else {
+        DMFillFileInfo(fileInfo, false, 0, 0);
+    }
+#endif
+}
+
 extern "C" DMEXPORT_DLL Idmfilesearch* DMAPI dmfilesearchGetModule() {
     return new DmfilesearchImpl();
 }
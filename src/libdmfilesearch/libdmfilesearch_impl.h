@@ -21,9 +21,17 @@
 #ifndef __LIBDMFILESEARCH_IMPL_H_INCLUDE__
 #define __LIBDMFILESEARCH_IMPL_H_INCLUDE__
 #include "dmfilesearch.h"
+#include "libdmfilesearch_crawler.h"
+#include "libdmfilesearch_exclude.h"
+#include "libdmfilesearch_watch.h"
+#include "libdmfilesearch_snapshot.h"
+#include "libdmfilesearch_checkpoint.h"
+#include "libdmfilesearch_filter.h"
+#include "libdmfilesearch_glob.h"
 #include <unordered_map>
 #include <unordered_set>
 #include <thread>
+#include <mutex>
 #include <atomic>
 #include <iostream>
 
@@ -51,9 +59,16 @@ public:
     
     void DMAPI ClearIndex() override;
     uint32_t DMAPI GetIndexedFileCount() override;
+    void DMAPI PrintIndexStats() override;
     bool DMAPI SaveIndex(const std::string& indexFile) override;
     bool DMAPI LoadIndex(const std::string& indexFile) override;
     
+    bool DMAPI StartWatch() override;
+    void DMAPI StopWatch() override;
+    uint64_t DMAPI GetIndexGeneration() override;
+    DMIndexProgress DMAPI GetIndexProgress() override;
+    bool DMAPI Refresh() override;
+    
     void DMAPI AddIncludeExtension(const std::string& extension) override;
     void DMAPI AddExcludeExtension(const std::string& extension) override;
     void DMAPI AddExcludeDirectory(const std::string& directory) override;
@@ -61,36 +76,122 @@ public:
     
     void DMAPI SetSearchOptions(const DMSearchOptions& options) override;
     DMSearchOptions DMAPI GetSearchOptions() override;
+    void DMAPI SetConfig(const DMConfigData& config) override;
+    DMConfigData DMAPI GetConfig() override;
     
     void DMAPI PrintResults(const DMFileList& results) override;
     void DMAPI SortResults(DMFileList& results, const std::string& sortBy) override;
 
 private:
     // 内部数据结构
-    std::vector<DMFileInfo> m_fileIndex;
-    std::unordered_map<std::string, std::vector<uint32_t>> m_nameIndex; // 文件名索引
+    std::shared_ptr<DMIndexSnapshot> m_index;       // 写入方的工作副本, 持有 m_indexLock 时访问
+    std::shared_ptr<DMIndexSnapshot> m_snapshot;    // 已发布的快照, 只通过 AcquireSnapshot 读取
+    std::weak_ptr<const DMIndexSnapshot> m_retired; // 上一代快照, 仍被搜索引用时计入内存统计
+    std::mutex m_retiredLock;
+    std::unordered_map<std::string, uint32_t> m_pathIndex; // 工作副本的完整路径索引, 增量更新时才建立
+    bool m_pathIndexReady = false;
+    std::atomic<uint64_t> m_generation{0};
+    std::mutex m_indexLock;                 // 串行化构建、加载和监视线程等写入方
     std::unordered_set<std::string> m_includeExtensions;
     std::unordered_set<std::string> m_excludeExtensions;
     std::unordered_set<std::string> m_excludeDirectories;
+    DMExcludeMatcher m_excludeMatcher;  // 由 m_excludeDirectories 编译而来
+    bool m_filtersDirty = true;
     DMSearchOptions m_searchOptions;
     std::atomic<bool> m_indexing{false};
     DMConfigData m_config;
 
+    // 监视模式
+    std::unique_ptr<DMChangeWatcher> m_watcher;
+    std::thread m_watchThread;
+    std::atomic<bool> m_watchStop{false};
+    bool m_pollWatch = false;
+    std::atomic<bool> m_refreshRequested{false};
+
     // 内部辅助函数
-    void BuildIndexRecursive(const std::string& directory);
-    bool ShouldIncludeFile(const std::string& filePath, const std::string& fileName) const;
+    void BuildIndexRecursive(const std::string& directory, bool progressive = false,
+        DMCrawlCheckpoint* checkpoint = nullptr);
+    void CrawlRoots(const DMStringList& rootPaths, bool progressive = false, DMCrawlCheckpoint* checkpoint = nullptr);
+    void SuperviseCrawl(DMCrawlContext& ctx, DMCrawlCheckpoint* checkpoint, size_t checkpointedEntries);
+    
+    // 构建检查点
+    std::unique_ptr<DMCrawlCheckpoint> CreateCheckpoint() const;
+    std::string CheckpointSignature() const;
+    bool ResumeCrawl(DMCrawlContext& ctx, DMCrawlCheckpoint& checkpoint, std::vector<DMCrawlItem>& items);
+    bool WriteCrawlCheckpoint(DMCrawlContext& ctx, DMCrawlCheckpoint& checkpoint, size_t& checkpointedEntries);
+    bool ShouldEnterDirectory(DMCrawlContext& ctx, const DMCrawlItem& parent, const std::string& dirPath,
+        bool deviceKnown, uint64_t& device, uint32_t& mountId) const;
+    void CrawlWorkerLoop(DMCrawlContext& ctx, uint32_t workerId);
+    void CrawlDirectory(DMCrawlContext& ctx, uint32_t workerId, const DMCrawlItem& item);
+    void CrawlDirectoryGeneric(DMCrawlContext& ctx, uint32_t workerId, const DMCrawlItem& item);
+#ifdef __linux__
+    void CrawlDirectoryLinux(DMCrawlContext& ctx, uint32_t workerId, const DMCrawlItem& item);
+#endif
+    uint32_t GetCrawlThreadCount() const;
+    void CollectMetadata(size_t firstEntry, uint32_t threadCount);
+    bool ShouldIncludeFile(const std::string& filePath, const std::string& fileName,
+        const DMIgnoreRules* ignoreRules = nullptr) const;
     bool ShouldIncludeDirectory(const std::string& dirPath) const;
+    bool ShouldIncludeSubdirectory(const DMCrawlItem& parent, const std::string& dirPath, const std::string& dirName,
+        const DMIgnoreRules* ignoreRules, uint32_t& state) const;
+    std::shared_ptr<const DMIgnoreRules> LoadParentIgnoreRules(const std::string& path, DMIgnoreCache& cache) const;
+    void CompileFilters();
     std::string GetFileExtension(const std::string& fileName) const;
     std::string ToLower(const std::string& str) const;
     bool MatchPattern(const std::string& text, const std::string& pattern, const DMSearchOptions& options) const;
+    bool MatchFoldedText(std::string_view text, const std::string& pattern, const DMGlobMatcher& glob,
+        const DMSearchOptions& options) const;
     uint64_t GetFileSize(const std::string& filePath) const;
     uint64_t GetFileModifyTime(const std::string& filePath) const;
-    void BuildNameIndex();
+    void LoadMetadata(DMFileInfo& fileInfo) const;
+    // savedOrder 为索引文件中保存的名称顺序, 校验通过时不再重新排序
+    void BuildNameIndex(std::vector<uint32_t>* savedOrder = nullptr);
+    void BuildSearchIndex();
+    
+    // 索引快照
+    std::shared_ptr<const DMIndexSnapshot> AcquireSnapshot() const;
+    void BeginUpdate();
+    void PublishIndex();
+    void PublishSnapshot(const std::shared_ptr<DMIndexSnapshot>& snapshot);
+    void PrintSnapshotMemory(const DMIndexSnapshot& previous) const;
+    
+    // 增量更新
+    void IndexEntry(uint32_t id);
+    void EnsurePathIndex();
+    void AdjustMountEntries(std::string_view directory, int64_t delta);
+    void RemoveEntries(std::vector<uint32_t>& ids);
+    void CollectDescendants(const std::vector<std::string>& dirs, std::vector<uint32_t>& ids) const;
+    bool IsRootPath(const std::string& path) const;
+    void ApplyChanges(const std::set<std::string>& paths, const std::set<std::string>& rescanDirs,
+        std::vector<std::string>& newDirs);
+    void SetRootPaths(const DMStringList& rootPaths);
+    bool ReadDirStamp(const std::string& dirPath, DMDirStamp& stamp) const;
+    void CaptureDirStamps(const std::vector<std::string>& dirs);
+    void CollectChangedDirectories(std::vector<std::string>& changedDirs);
+    void ListDirectoryChanges(const std::vector<std::string>& dirs, std::set<std::string>& paths) const;
+    void RefreshDirectories(std::vector<std::string>& newDirs);
+    
+    // 监视模式
+    std::unique_ptr<DMChangeWatcher> CreateWatcher();
+    void WatchLoop();
+    void PollDirectoryChanges(DMChangeSet& changes);
+    void ResolveOverflow(DMChangeSet& changes) const;
+    bool ShouldWatchDirectory(const DMMountTable& mounts, const std::set<uint64_t>& rootDevices,
+        const std::string& dirPath) const;
+    void WatchDirectories(const std::vector<std::string>& dirs);
     
-    // 搜索实现
-    void SearchInIndex(const std::string& pattern, const DMSearchOptions& options, DMFileList& results) const;
-    void SearchWithWildcard(const std::string& pattern, const DMSearchOptions& options, DMFileList& results) const;
-    void SearchWithRegex(const std::string& pattern, const DMSearchOptions& options, DMFileList& results) const;
+    // 搜索实现, 返回匹配项在 index.fileIndex 中的下标
+    void SelectCandidates(const DMIndexSnapshot& index, const DMSearchOptions& options, DMBitmap& candidates) const;
+    bool SelectByLiteral(const DMIndexSnapshot& index, std::string_view literal, const DMSearchOptions& options,
+        DMBitmap& candidates) const;
+    void SearchInIndex(const DMIndexSnapshot& index, const std::string& pattern, const DMSearchOptions& options,
+        std::vector<uint32_t>& ids) const;
+    void SearchWithWildcard(const DMIndexSnapshot& index, const std::string& pattern, const DMSearchOptions& options,
+        std::vector<uint32_t>& ids) const;
+    void SearchWithRegex(const DMIndexSnapshot& index, const std::string& pattern, const DMSearchOptions& options,
+        std::vector<uint32_t>& ids) const;
+    void SearchWithStdRegex(const DMIndexSnapshot& index, const std::string& pattern, const DMSearchOptions& options,
+        std::vector<uint32_t>& ids) const;
 };
 
 #endif
\ No newline at end of file
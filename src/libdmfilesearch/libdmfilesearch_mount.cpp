@@ -0,0 +1,123 @@
+﻿// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <set>
+
+#include "libdmfilesearch_mount.h"
+
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#endif
+
+// mountinfo 中的空格、制表符、换行和反斜杠以 \ooo 八进制转义
+static std::string DMUnescapeMountPath(const std::string& path) {
+    std::string result;
+    result.reserve(path.size());
+    for (size_t i = 0; i < path.size(); ++i) {
+        if (path[i] == '\\' && i + 3 < path.size() &&
+            path[i + 1] >= '0' && path[i + 1] <= '7' &&
+            path[i + 2] >= '0' && path[i + 2] <= '7' &&
+            path[i + 3] >= '0' && path[i + 3] <= '7') {
+            result.push_back(static_cast<char>(((path[i + 1] - '0') << 6) | ((path[i + 2] - '0') << 3) | (path[i + 3] - '0')));
+            i += 3;
+        } else {
+            result.push_back(path[i]);
+        }
+    }
+    return result;
+}
+
+bool DMMountTable::Load() {
+    m_entries.clear();
+    m_byPath.clear();
+
+#ifdef __linux__
+    std::ifstream ifs("/proc/self/mountinfo");
+    if (!ifs) {
+        return false;
+    }
+
+    // 格式: id parent major:minor root mountpoint options [optional...] - fstype source superoptions
+    std::string line;
+    while (std::getline(ifs, line)) {
+        std::istringstream iss(line);
+        std::string id, parent, majorMinor, root, mountPoint, options, field;
+        if (!(iss >> id >> parent >> majorMinor >> root >> mountPoint >> options)) {
+            continue;
+        }
+        while (iss >> field && field != "-") {
+        }
+
+        DMMountEntry entry;
+        if (!(iss >> entry.fsType >> entry.source)) {
+            continue;
+        }
+        entry.mountPoint = DMUnescapeMountPath(mountPoint);
+
+        unsigned int major = 0, minor = 0;
+        if (sscanf(majorMinor.c_str(), "%u:%u", &major, &minor) == 2) {
+            entry.device = static_cast<uint64_t>(makedev(major, minor));
+        }
+
+        // 同一路径被多次挂载时, 后面的挂载覆盖前面的
+        auto it = m_byPath.find(entry.mountPoint);
+        if (it != m_byPath.end()) {
+            m_entries[it->second] = entry;
+        } else {
+            m_byPath[entry.mountPoint] = static_cast<uint32_t>(m_entries.size());
+            m_entries.push_back(entry);
+        }
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint32_t DMMountTable::FindMountPoint(const std::string& path) const {
+    auto it = m_byPath.find(path);
+    return it == m_byPath.end() ? INVALID_MOUNT : it->second;
+}
+
+uint32_t DMMountTable::FindContaining(const std::string& path) const {
+    std::string current = path;
+    for (;;) {
+        uint32_t mountId = FindMountPoint(current);
+        if (mountId != INVALID_MOUNT) {
+            return mountId;
+        }
+        size_t pos = current.find_last_of('/');
+        if (current.size() <= 1 || pos == std::string::npos) {
+            return INVALID_MOUNT;
+        }
+        current.resize(pos == 0 ? 1 : pos);
+    }
+}
+
+bool DMMountTable::IsNetworkFs(const std::string& fsType) {
+    static const std::set<std::string> networkTypes = {
+        "nfs", "nfs4", "cifs", "smb3", "smbfs", "ncpfs", "afs", "9p", "ceph",
+        "glusterfs", "lustre", "gpfs", "beegfs", "davfs", "sshfs", "curlftpfs",
+    };
+    return networkTypes.count(fsType) > 0 || fsType.compare(0, 4, "fuse") == 0;
+}
@@ -0,0 +1,69 @@
+// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef __LIBDMFILESEARCH_MOUNT_H_INCLUDE__
+#define __LIBDMFILESEARCH_MOUNT_H_INCLUDE__
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+// 一个挂载点
+struct DMMountEntry {
+    std::string mountPoint;
+    std::string fsType;
+    std::string source;
+    uint64_t device = 0;    // major:minor 对应的 dev_t
+};
+
+// 索引中记录的挂载点及其索引项数量, 用于按挂载点统计
+struct DMIndexMount {
+    std::string mountPoint;
+    std::string fsType;
+    uint64_t device = 0;
+    uint64_t entryCount = 0;
+};
+
+// 系统挂载表, Linux 上读取 /proc/self/mountinfo, 其他平台为空
+class DMMountTable
+{
+public:
+    static constexpr uint32_t INVALID_MOUNT = 0xFFFFFFFF;
+
+    bool Load();
+
+    const std::vector<DMMountEntry>& Entries() const { return m_entries; }
+    bool Empty() const { return m_entries.empty(); }
+
+    // path 恰好是挂载点时返回其下标, 否则返回 INVALID_MOUNT
+    uint32_t FindMountPoint(const std::string& path) const;
+
+    // 返回包含 path 的最深挂载点 (path 需为绝对路径)
+    uint32_t FindContaining(const std::string& path) const;
+
+    // 网络或 FUSE 文件系统
+    static bool IsNetworkFs(const std::string& fsType);
+
+private:
+    std::vector<DMMountEntry> m_entries;
+    std::unordered_map<std::string, uint32_t> m_byPath;
+};
+
+#endif
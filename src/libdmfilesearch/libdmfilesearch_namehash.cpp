@@ -0,0 +1,143 @@
+﻿// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "libdmfilesearch_namehash.h"
+
+#include <algorithm>
+#include <functional>
+
+void DMNameHash::clear() {
+    m_slots.clear();
+    m_next.clear();
+    m_keys = 0;
+}
+
+uint32_t DMNameHash::Hash(std::string_view name) {
+    uint64_t hash = std::hash<std::string_view>()(name);
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+// 返回 name 所在的槽位, 不存在时返回探测到的空位
+size_t DMNameHash::FindSlot(const DMFileTable& table, std::string_view name, uint32_t hash) const {
+    const size_t mask = m_slots.size() - 1;
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        const Slot& entry = m_slots[slot];
+        if (entry.head == NONE || (entry.hash == hash && table.FoldedName(entry.head) == name)) {
+            return slot;
+        }
+    }
+}
+
+void DMNameHash::Rehash(const DMFileTable& table, size_t capacity) {
+    DMSharedArray<Slot> slots;
+    slots.resize(capacity);
+    slots.swap(m_slots);
+    for (const Slot& entry : slots) {
+        if (entry.head != NONE) {
+            m_slots.Set(FindSlot(table, table.FoldedName(entry.head), entry.hash), entry);
+        }
+    }
+}
+
+void DMNameHash::Build(const DMFileTable& table) {
+    clear();
+    // 不同名称的数量事先未知, 槽位随插入倍增
+    m_next.reserve(table.size());
+    for (uint32_t id = 0; id < table.size(); ++id) {
+        Insert(table, id);
+    }
+}
+
+void DMNameHash::Insert(const DMFileTable& table, uint32_t id) {
+    if ((m_keys + 1) * 10 > m_slots.size() * 7) {
+        Rehash(table, m_slots.empty() ? 16 : m_slots.size() * 2);
+    }
+    if (id >= m_next.size()) {
+        m_next.resize(id + 1, NONE);
+    }
+
+    std::string_view name = table.FoldedName(id);
+    uint32_t hash = Hash(name);
+    Slot& entry = m_slots.Mutable(FindSlot(table, name, hash));
+    if (entry.head == NONE) {
+        entry.hash = hash;
+        ++m_keys;
+    }
+    m_next.Set(id, entry.head);
+    entry.head = id;
+}
+
+// 线性探测的删除: 把后面探测链上的槽位前移填补空位, 不留删除标记
+void DMNameHash::EraseSlot(size_t slot) {
+    const size_t mask = m_slots.size() - 1;
+    size_t hole = slot;
+    for (size_t next = (hole + 1) & mask; m_slots[next].head != NONE; next = (next + 1) & mask) {
+        size_t home = m_slots[next].hash & mask;
+        // home 不在 (hole, next] 之间时, 该槽位可以前移到 hole
+        bool between = hole <= next ? (home > hole && home <= next) : (home > hole || home <= next);
+        if (!between) {
+            m_slots.Set(hole, m_slots[next]);
+            hole = next;
+        }
+    }
+    m_slots.Set(hole, Slot());
+    --m_keys;
+}
+
+void DMNameHash::Remove(const DMFileTable& table, uint32_t id) {
+    if (m_slots.empty()) {
+        return;
+    }
+    std::string_view name = table.FoldedName(id);
+    size_t slot = FindSlot(table, name, Hash(name));
+    const Slot& entry = m_slots[slot];
+    if (entry.head == NONE) {
+        return;
+    }
+    if (entry.head == id) {
+        m_slots.Mutable(slot).head = m_next[id];
+        if (m_next[id] == NONE) {
+            EraseSlot(slot);
+        }
+        return;
+    }
+    for (uint32_t prev = entry.head; m_next[prev] != NONE; prev = m_next[prev]) {
+        if (m_next[prev] == id) {
+            m_next.Set(prev, m_next[id]);
+            return;
+        }
+    }
+}
+
+void DMNameHash::Lookup(const DMFileTable& table, std::string_view foldedName, std::vector<uint32_t>& ids) const {
+    ids.clear();
+    if (m_slots.empty()) {
+        return;
+    }
+    const Slot& entry = m_slots[FindSlot(table, foldedName, Hash(foldedName))];
+    for (uint32_t id = entry.head; id != NONE; id = m_next[id]) {
+        ids.push_back(id);
+    }
+    std::sort(ids.begin(), ids.end());
+}
+
+size_t DMNameHash::MemoryUsage() const {
+    return m_slots.MemoryUsage() + m_next.MemoryUsage();
+}
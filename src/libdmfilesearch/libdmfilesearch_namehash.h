@@ -0,0 +1,66 @@
+// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef __LIBDMFILESEARCH_NAMEHASH_H_INCLUDE__
+#define __LIBDMFILESEARCH_NAMEHASH_H_INCLUDE__
+#include "libdmfilesearch_filetable.h"
+#include "libdmfilesearch_shared.h"
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// 小写名称到索引项的哈希表, 用于全词 (整个名称) 查询.
+// 开放寻址 (线性探测), 槽位只记录哈希值和同名链表的表头, 键直接读 table 中的小写名称;
+// 同名的项通过按编号下标的 next 数组串起来. 槽位和 next 数组分块共享, 复制后只复制改到的块
+class DMNameHash
+{
+public:
+    bool Ready() const { return !m_slots.empty(); }
+    void clear();
+    void Build(const DMFileTable& table);
+    void Insert(const DMFileTable& table, uint32_t id);
+    // 须在 table 中删除该项之前调用
+    void Remove(const DMFileTable& table, uint32_t id);
+
+    // 小写名称等于 foldedName 的所有项, 从小到大排列
+    void Lookup(const DMFileTable& table, std::string_view foldedName, std::vector<uint32_t>& ids) const;
+
+    size_t KeyCount() const { return m_keys; }
+    size_t MemoryUsage() const;
+
+private:
+    static constexpr uint32_t NONE = 0xFFFFFFFF;
+
+    struct Slot {
+        uint32_t hash = 0;
+        uint32_t head = NONE;   // NONE 表示空位
+    };
+
+    static uint32_t Hash(std::string_view name);
+    size_t FindSlot(const DMFileTable& table, std::string_view name, uint32_t hash) const;
+    void Rehash(const DMFileTable& table, size_t capacity);
+    void EraseSlot(size_t slot);
+
+    DMSharedArray<Slot> m_slots;        // 容量为 2 的幂
+    DMSharedArray<uint32_t> m_next;     // 同名链表的下一项
+    size_t m_keys = 0;                  // 不同名称的数量
+};
+
+#endif
@@ -0,0 +1,235 @@
+﻿// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "libdmfilesearch_nameorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <thread>
+
+// 小写名称相同时按编号, 保证顺序唯一
+static inline bool DMNameLess(const DMFileTable& table, uint32_t a, uint32_t b) {
+    int result = table.FoldedName(a).compare(table.FoldedName(b));
+    return result != 0 ? result < 0 : a < b;
+}
+
+void DMNameOrder::clear() {
+    m_ready = false;
+    m_order.clear();
+    m_ranks.clear();
+    m_unsorted.clear();
+    m_holes = 0;
+    m_fromFile = false;
+    m_buildMicroseconds = 0;
+}
+
+void DMNameOrder::Fill(const std::vector<uint32_t>& order) {
+    std::vector<uint32_t> ranks(order.size());
+    for (uint32_t i = 0; i < order.size(); ++i) {
+        ranks[order[i]] = i;
+    }
+    m_order.assign(order.begin(), order.end());
+    m_ranks.assign(ranks.begin(), ranks.end());
+}
+
+void DMNameOrder::Build(const DMFileTable& table, uint32_t threadCount) {
+    auto startTime = std::chrono::steady_clock::now();
+    clear();
+    m_threadCount = std::max<uint32_t>(threadCount, 1);
+
+    const size_t count = table.size();
+    std::vector<uint32_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    auto less = [&table](uint32_t a, uint32_t b) { return DMNameLess(table, a, b); };
+
+    // 每段至少 64K 项, 段数为 2 的幂以便逐层两两归并
+    size_t segments = 1;
+    while (segments * 2 <= m_threadCount && count / (segments * 2) >= 65536) {
+        segments *= 2;
+    }
+    std::vector<size_t> bounds(segments + 1);
+    for (size_t k = 0; k <= segments; ++k) {
+        bounds[k] = count * k / segments;
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t k = 0; k < segments; ++k) {
+        threads.emplace_back([&, k]() {
+            std::sort(order.begin() + bounds[k], order.begin() + bounds[k + 1], less);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (size_t width = 1; width < segments; width *= 2) {
+        threads.clear();
+        for (size_t k = 0; k + width < segments; k += width * 2) {
+            threads.emplace_back([&, k, width]() {
+                std::inplace_merge(order.begin() + bounds[k], order.begin() + bounds[k + width],
+                    order.begin() + bounds[k + width * 2], less);
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    Fill(order);
+    m_ready = true;
+    m_buildMicroseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - startTime).count());
+}
+
+bool DMNameOrder::Assign(const DMFileTable& table, std::vector<uint32_t>&& order, uint32_t threadCount) {
+    auto startTime = std::chrono::steady_clock::now();
+    clear();
+    m_threadCount = std::max<uint32_t>(threadCount, 1);
+    if (order.size() != table.size()) {
+        return false;
+    }
+    // 必须是一个排列, 并且按小写名称有序; 删除时移动过的项可能打乱同名项之间的编号顺序, 不影响查找
+    std::vector<bool> seen(order.size(), false);
+    for (size_t i = 0; i < order.size(); ++i) {
+        if (order[i] >= order.size() || seen[order[i]] ||
+            (i > 0 && table.FoldedName(order[i - 1]) > table.FoldedName(order[i]))) {
+            return false;
+        }
+        seen[order[i]] = true;
+    }
+
+    Fill(order);
+    m_ready = true;
+    m_fromFile = true;
+    m_buildMicroseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - startTime).count());
+    return true;
+}
+
+bool DMNameOrder::NeedRebuild() const {
+    return m_holes + m_unsorted.size() > std::max<size_t>(65536, m_order.size() / 8);
+}
+
+void DMNameOrder::Add(const DMFileTable& table, uint32_t id) {
+    // 重建时已包含的项不再重复加入
+    if (!m_ready || id < m_ranks.size()) {
+        return;
+    }
+    if (NeedRebuild()) {
+        Build(table, m_threadCount);
+        return;
+    }
+    while (m_ranks.size() <= id) {
+        m_unsorted.push_back(static_cast<uint32_t>(m_ranks.size()));
+        m_ranks.push_back(NONE);
+    }
+}
+
+void DMNameOrder::Remove(uint32_t id, uint32_t last) {
+    if (!m_ready || last + 1 != m_ranks.size()) {
+        return;
+    }
+    uint32_t rank = m_ranks[id];
+    if (rank != NONE) {
+        m_order.Set(rank, NONE);
+        ++m_holes;
+    } else {
+        size_t pos = static_cast<size_t>(std::find(m_unsorted.begin(), m_unsorted.end(), id) - m_unsorted.begin());
+        m_unsorted.Set(pos, m_unsorted.back());
+        m_unsorted.pop_back();
+    }
+    if (id != last) {
+        uint32_t lastRank = m_ranks[last];
+        m_ranks.Set(id, lastRank);
+        if (lastRank != NONE) {
+            m_order.Set(lastRank, id);
+        } else {
+            m_unsorted.Set(static_cast<size_t>(std::find(m_unsorted.begin(), m_unsorted.end(), last) - m_unsorted.begin()), id);
+        }
+    }
+    m_ranks.pop_back();
+}
+
+void DMNameOrder::Maintain(const DMFileTable& table) {
+    if (m_ready && NeedRebuild()) {
+        Build(table, m_threadCount);
+    }
+}
+
+// pos 之后 (含 pos) 第一个不是空位的位置, 没有时返回 end
+size_t DMNameOrder::SkipHoles(size_t pos, size_t end) const {
+    while (pos < end && m_order[pos] == NONE) {
+        ++pos;
+    }
+    return pos;
+}
+
+void DMNameOrder::Prefix(const DMFileTable& table, std::string_view foldedPrefix, std::vector<uint32_t>& ids) const {
+    ids.clear();
+    if (!m_ready) {
+        return;
+    }
+    const size_t length = foldedPrefix.size();
+    auto head = [&](size_t pos) { return table.FoldedName(m_order[pos]).substr(0, length); };
+
+    // 二分查找时跳过空位: 中点落在空位上时以其后第一个有效位置比较
+    size_t lo = 0;
+    size_t hi = m_order.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        size_t pos = SkipHoles(mid, hi);
+        if (pos == hi) {
+            hi = mid;
+        } else if (head(pos) < foldedPrefix) {
+            lo = pos + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    const size_t first = lo;
+    hi = m_order.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        size_t pos = SkipHoles(mid, hi);
+        if (pos == hi) {
+            hi = mid;
+        } else if (head(pos) == foldedPrefix) {
+            lo = pos + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    for (size_t pos = first; pos < lo; ++pos) {
+        if (m_order[pos] != NONE) {
+            ids.push_back(m_order[pos]);
+        }
+    }
+    for (uint32_t id : m_unsorted) {
+        if (table.FoldedName(id).substr(0, length) == foldedPrefix) {
+            ids.push_back(id);
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+}
+
+size_t DMNameOrder::MemoryUsage() const {
+    return m_order.MemoryUsage() + m_ranks.MemoryUsage() + m_unsorted.MemoryUsage();
+}
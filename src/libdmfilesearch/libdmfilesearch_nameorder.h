@@ -0,0 +1,79 @@
+// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef __LIBDMFILESEARCH_NAMEORDER_H_INCLUDE__
+#define __LIBDMFILESEARCH_NAMEORDER_H_INCLUDE__
+#include "libdmfilesearch_filetable.h"
+#include "libdmfilesearch_shared.h"
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// 按小写名称 (相同时按编号) 排列的索引项编号, 以及每项在其中的位置.
+// 前缀查询是两次二分查找得到的连续区间.
+// 删除的项在顺序中留下空位, 被移动的项沿用原来的位置; 建立之后新增的项单独记录, 前缀查询时逐一校验.
+// 空位和新增项过多时整体重建. 各数组分块共享, 复制后增删一项只复制改到的块
+class DMNameOrder
+{
+public:
+    static constexpr uint32_t NONE = 0xFFFFFFFF;
+
+    bool Ready() const { return m_ready; }
+    // 所有索引项都在顺序中 (没有新增项), 去掉空位后可以写入索引文件
+    bool Complete() const { return m_ready && m_unsorted.empty(); }
+    void clear();
+
+    // 分段并行排序后逐层归并
+    void Build(const DMFileTable& table, uint32_t threadCount);
+    // 使用从索引文件读入的顺序, 校验失败返回 false
+    bool Assign(const DMFileTable& table, std::vector<uint32_t>&& order, uint32_t threadCount);
+
+    // 新增的项
+    void Add(const DMFileTable& table, uint32_t id);
+    // table 删除 id 并把最后一项 last 移到 id 之前调用
+    void Remove(uint32_t id, uint32_t last);
+    // 一批删除完成后调用, 空位过多时重建
+    void Maintain(const DMFileTable& table);
+
+    // 小写名称以 foldedPrefix 开头的项, 从小到大排列
+    void Prefix(const DMFileTable& table, std::string_view foldedPrefix, std::vector<uint32_t>& ids) const;
+
+    // 含空位 (NONE)
+    const DMSharedArray<uint32_t>& Order() const { return m_order; }
+    bool FromFile() const { return m_fromFile; }
+    uint64_t BuildMicroseconds() const { return m_buildMicroseconds; }
+    size_t MemoryUsage() const;
+
+private:
+    bool NeedRebuild() const;
+    void Fill(const std::vector<uint32_t>& order);
+    size_t SkipHoles(size_t pos, size_t end) const;
+
+    bool m_ready = false;
+    DMSharedArray<uint32_t> m_order;    // 已删除的项为 NONE
+    DMSharedArray<uint32_t> m_ranks;    // m_ranks[m_order[i]] == i
+    DMSharedArray<uint32_t> m_unsorted; // 建立之后新增的项, 无序
+    size_t m_holes = 0;
+    uint32_t m_threadCount = 1;
+    bool m_fromFile = false;
+    uint64_t m_buildMicroseconds = 0;
+};
+
+#endif
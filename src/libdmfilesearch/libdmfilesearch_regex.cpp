@@ -0,0 +1,755 @@
+﻿// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "libdmfilesearch_regex.h"
+
+#include <algorithm>
+#include <memory>
+
+// 语法树节点
+struct DMRegexAst {
+    enum Type {
+        DM_AST_CHARS,   // 一个字节, 取自 set
+        DM_AST_CONCAT,
+        DM_AST_ALT,
+        DM_AST_REPEAT,  // child 重复 min 到 max 次, max 为 -1 表示不限
+        DM_AST_BEGIN,
+        DM_AST_END,
+        DM_AST_EMPTY,
+    };
+
+    Type type = DM_AST_EMPTY;
+    uint32_t set = 0;
+    int min = 0;
+    int max = -1;
+    std::vector<std::unique_ptr<DMRegexAst>> children;
+};
+
+// 节点匹配的文本恰好是 text (exact), 或必定包含 required
+struct DMRegexLiteral {
+    bool exact = false;
+    std::string text;
+    std::string required;
+};
+
+static const size_t DM_REGEX_MAX_NODES = 50000;
+static const int DM_REGEX_MAX_REPEAT = 1000;
+static const int DM_REGEX_MAX_DEPTH = 500;
+static const size_t DM_REGEX_MAX_STATES = 4096;
+
+class DMRegexCompiler
+{
+public:
+    DMRegexCompiler(DMRegex& regex, std::string_view pattern, bool icase)
+        : m_regex(regex), m_pattern(pattern), m_icase(icase) {}
+
+    bool Compile();
+
+private:
+    std::unique_ptr<DMRegexAst> ParseAlternation();
+    std::unique_ptr<DMRegexAst> ParseSequence();
+    std::unique_ptr<DMRegexAst> ParseRepeat();
+    std::unique_ptr<DMRegexAst> ParseAtom();
+    bool ParseQuantifier(int& min, int& max);
+    bool ParseNumber(int& value);
+    bool ParseClass(std::bitset<256>& set);
+    // 转义序列, 表示单个字节时写入 byte 并返回 1, 表示字符集时写入 set 并返回 2, 不支持时返回 0
+    int ParseEscape(bool inClass, unsigned char& byte, std::bitset<256>& set);
+    std::unique_ptr<DMRegexAst> MakeChars(const std::bitset<256>& set);
+
+    uint32_t Emit(const DMRegexAst& ast, uint32_t next);
+    uint32_t AddNode(DMRegex::NodeType type, uint32_t set, uint32_t out, uint32_t out1);
+    DMRegexLiteral Analyze(const DMRegexAst& ast) const;
+
+    bool AtEnd() const { return m_pos >= m_pattern.size(); }
+    char Peek() const { return m_pattern[m_pos]; }
+
+    DMRegex& m_regex;
+    std::string_view m_pattern;
+    bool m_icase;
+    size_t m_pos = 0;
+    int m_depth = 0;
+    bool m_failed = false;
+};
+
+static void DMAddRange(std::bitset<256>& set, int first, int last) {
+    for (int c = first; c <= last; ++c) {
+        set.set(static_cast<size_t>(c));
+    }
+}
+
+static std::bitset<256> DMDigitSet() {
+    std::bitset<256> set;
+    DMAddRange(set, '0', '9');
+    return set;
+}
+
+static std::bitset<256> DMWordSet() {
+    std::bitset<256> set;
+    DMAddRange(set, '0', '9');
+    DMAddRange(set, 'A', 'Z');
+    DMAddRange(set, 'a', 'z');
+    set.set('_');
+    return set;
+}
+
+static std::bitset<256> DMSpaceSet() {
+    std::bitset<256> set;
+    for (char c : std::string_view(" \t\n\v\f\r")) {
+        set.set(static_cast<unsigned char>(c));
+    }
+    return set;
+}
+
+static int DMHexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// 字母的大小写两种形式有一个在集合中时都加入
+static void DMFoldSet(std::bitset<256>& set) {
+    for (int c = 'a'; c <= 'z'; ++c) {
+        if (set[c] || set[c - 'a' + 'A']) {
+            set.set(c);
+            set.set(c - 'a' + 'A');
+        }
+    }
+}
+
+std::unique_ptr<DMRegexAst> DMRegexCompiler::MakeChars(const std::bitset<256>& set) {
+    std::bitset<256> folded = set;
+    if (m_icase) {
+        DMFoldSet(folded);
+    }
+    auto ast = std::make_unique<DMRegexAst>();
+    ast->type = DMRegexAst::DM_AST_CHARS;
+    ast->set = static_cast<uint32_t>(m_regex.m_sets.size());
+    m_regex.m_sets.push_back(folded);
+    return ast;
+}
+
+int DMRegexCompiler::ParseEscape(bool inClass, unsigned char& byte, std::bitset<256>& set) {
+    if (AtEnd()) {
+        return 0;
+    }
+    char c = m_pattern[m_pos++];
+    switch (c) {
+    case 'd': set = DMDigitSet(); return 2;
+    case 'D': set = ~DMDigitSet(); return 2;
+    case 'w': set = DMWordSet(); return 2;
+    case 'W': set = ~DMWordSet(); return 2;
+    case 's': set = DMSpaceSet(); return 2;
+    case 'S': set = ~DMSpaceSet(); return 2;
+    case 't': byte = '\t'; return 1;
+    case 'n': byte = '\n'; return 1;
+    case 'r': byte = '\r'; return 1;
+    case 'v': byte = '\v'; return 1;
+    case 'f': byte = '\f'; return 1;
+    case '0':
+        if (!AtEnd() && Peek() >= '0' && Peek() <= '9') {
+            return 0;
+        }
+        byte = 0;
+        return 1;
+    case 'x': {
+        if (m_pos + 2 > m_pattern.size() || DMHexValue(m_pattern[m_pos]) < 0 || DMHexValue(m_pattern[m_pos + 1]) < 0) {
+            return 0;
+        }
+        byte = static_cast<unsigned char>(DMHexValue(m_pattern[m_pos]) * 16 + DMHexValue(m_pattern[m_pos + 1]));
+        m_pos += 2;
+        return 1;
+    }
+    case 'b':
+        // 字符类中为退格, 类外为单词边界 (不支持)
+        if (inClass) {
+            byte = '\b';
+            return 1;
+        }
+        return 0;
+    default:
+        // 其余字母和数字 (反向引用、\B、\c、\u 等) 不支持; 标点按原字符
+        if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+            static_cast<unsigned char>(c) >= 0x80) {
+            return 0;
+        }
+        byte = static_cast<unsigned char>(c);
+        return 1;
+    }
+}
+
+bool DMRegexCompiler::ParseClass(std::bitset<256>& set) {
+    bool negate = false;
+    if (!AtEnd() && Peek() == '^') {
+        negate = true;
+        ++m_pos;
+    }
+    set.reset();
+    while (true) {
+        if (AtEnd()) {
+            return false;
+        }
+        char c = m_pattern[m_pos++];
+        if (c == ']') {
+            break;
+        }
+        // 读入一个类成员: 单个字节或 \d 一类的字符集
+        unsigned char first = static_cast<unsigned char>(c);
+        if (c == '\\') {
+            std::bitset<256> escaped;
+            int kind = ParseEscape(true, first, escaped);
+            if (kind == 0) {
+                return false;
+            }
+            if (kind == 2) {
+                // \d-x 一类的写法含义不明确, 交给 std::regex
+                if (!AtEnd() && Peek() == '-' && m_pos + 1 < m_pattern.size() && m_pattern[m_pos + 1] != ']') {
+                    return false;
+                }
+                set |= escaped;
+                continue;
+            }
+        } else if (c == '[') {
+            // [:alpha:] 等 POSIX 类不支持
+            if (!AtEnd() && (Peek() == ':' || Peek() == '.' || Peek() == '=')) {
+                return false;
+            }
+        }
+        if (!AtEnd() && Peek() == '-' && m_pos + 1 < m_pattern.size() && m_pattern[m_pos + 1] != ']') {
+            ++m_pos;
+            char d = m_pattern[m_pos++];
+            unsigned char last = static_cast<unsigned char>(d);
+            if (d == '\\') {
+                std::bitset<256> escaped;
+                if (ParseEscape(true, last, escaped) != 1) {
+                    return false;
+                }
+            } else if (d == '[') {
+                return false;
+            }
+            if (last < first) {
+                return false;
+            }
+            DMAddRange(set, first, last);
+        } else {
+            set.set(first);
+        }
+    }
+    // 不区分大小写时先折叠再取反, [^a-z] 不匹配大写字母
+    if (negate) {
+        if (m_icase) {
+            DMFoldSet(set);
+        }
+        set.flip();
+    }
+    return true;
+}
+
+bool DMRegexCompiler::ParseNumber(int& value) {
+    size_t start = m_pos;
+    value = 0;
+    while (!AtEnd() && Peek() >= '0' && Peek() <= '9') {
+        value = value * 10 + (Peek() - '0');
+        if (value > DM_REGEX_MAX_REPEAT) {
+            return false;
+        }
+        ++m_pos;
+    }
+    return m_pos > start;
+}
+
+// 读入 * + ? {n} {n,} {n,m}, 没有量词时 min = max = 1
+bool DMRegexCompiler::ParseQuantifier(int& min, int& max) {
+    min = 1;
+    max = 1;
+    if (AtEnd()) {
+        return true;
+    }
+    switch (Peek()) {
+    case '*': min = 0; max = -1; ++m_pos; break;
+    case '+': min = 1; max = -1; ++m_pos; break;
+    case '?': min = 0; max = 1; ++m_pos; break;
+    case '{':
+        ++m_pos;
+        if (!ParseNumber(min)) {
+            return false;
+        }
+        max = min;
+        if (!AtEnd() && Peek() == ',') {
+            ++m_pos;
+            if (!AtEnd() && Peek() == '}') {
+                max = -1;
+            } else if (!ParseNumber(max) || max < min) {
+                return false;
+            }
+        }
+        if (AtEnd() || Peek() != '}') {
+            return false;
+        }
+        ++m_pos;
+        break;
+    default:
+        return true;
+    }
+    // 非贪婪形式只影响匹配的位置, 不影响是否匹配
+    if (!AtEnd() && Peek() == '?') {
+        ++m_pos;
+    }
+    return true;
+}
+
+std::unique_ptr<DMRegexAst> DMRegexCompiler::ParseAtom() {
+    char c = m_pattern[m_pos++];
+    switch (c) {
+    case '(': {
+        if (!AtEnd() && Peek() == '?') {
+            // 只支持非捕获分组 (?:...), 前瞻等交给 std::regex
+            if (m_pos + 1 >= m_pattern.size() || m_pattern[m_pos + 1] != ':') {
+                return nullptr;
+            }
+            m_pos += 2;
+        }
+        if (++m_depth > DM_REGEX_MAX_DEPTH) {
+            return nullptr;
+        }
+        std::unique_ptr<DMRegexAst> group = ParseAlternation();
+        --m_depth;
+        if (!group || AtEnd() || Peek() != ')') {
+            return nullptr;
+        }
+        ++m_pos;
+        return group;
+    }
+    case '[': {
+        std::bitset<256> set;
+        if (!ParseClass(set)) {
+            return nullptr;
+        }
+        return MakeChars(set);
+    }
+    case '.': {
+        std::bitset<256> set;
+        set.set();
+        set.reset('\n');
+        set.reset('\r');
+        return MakeChars(set);
+    }
+    case '^':
+    case '$': {
+        auto ast = std::make_unique<DMRegexAst>();
+        ast->type = c == '^' ? DMRegexAst::DM_AST_BEGIN : DMRegexAst::DM_AST_END;
+        return ast;
+    }
+    case '\\': {
+        unsigned char byte = 0;
+        std::bitset<256> set;
+        int kind = ParseEscape(false, byte, set);
+        if (kind == 0) {
+            return nullptr;
+        }
+        if (kind == 1) {
+            set.reset();
+            set.set(byte);
+        }
+        return MakeChars(set);
+    }
+    case '*':
+    case '+':
+    case '?':
+    case '{':
+    case '}':
+    case ']':
+    case ')':
+        return nullptr;
+    default: {
+        std::bitset<256> set;
+        set.set(static_cast<unsigned char>(c));
+        return MakeChars(set);
+    }
+    }
+}
+
+std::unique_ptr<DMRegexAst> DMRegexCompiler::ParseRepeat() {
+    std::unique_ptr<DMRegexAst> atom = ParseAtom();
+    if (!atom) {
+        return nullptr;
+    }
+    int min = 1;
+    int max = 1;
+    if (!ParseQuantifier(min, max)) {
+        return nullptr;
+    }
+    if (min == 1 && max == 1) {
+        return atom;
+    }
+    // 断言不能加量词, 量词也不能连用
+    if (atom->type == DMRegexAst::DM_AST_BEGIN || atom->type == DMRegexAst::DM_AST_END ||
+        (!AtEnd() && (Peek() == '*' || Peek() == '+' || Peek() == '?' || Peek() == '{'))) {
+        return nullptr;
+    }
+    auto repeat = std::make_unique<DMRegexAst>();
+    repeat->type = DMRegexAst::DM_AST_REPEAT;
+    repeat->min = min;
+    repeat->max = max;
+    repeat->children.push_back(std::move(atom));
+    return repeat;
+}
+
+std::unique_ptr<DMRegexAst> DMRegexCompiler::ParseSequence() {
+    auto sequence = std::make_unique<DMRegexAst>();
+    sequence->type = DMRegexAst::DM_AST_CONCAT;
+    while (!AtEnd() && Peek() != '|' && Peek() != ')') {
+        std::unique_ptr<DMRegexAst> item = ParseRepeat();
+        if (!item) {
+            return nullptr;
+        }
+        sequence->children.push_back(std::move(item));
+    }
+    return sequence;
+}
+
+std::unique_ptr<DMRegexAst> DMRegexCompiler::ParseAlternation() {
+    auto alternation = std::make_unique<DMRegexAst>();
+    alternation->type = DMRegexAst::DM_AST_ALT;
+    while (true) {
+        std::unique_ptr<DMRegexAst> branch = ParseSequence();
+        if (!branch) {
+            return nullptr;
+        }
+        alternation->children.push_back(std::move(branch));
+        if (AtEnd() || Peek() != '|') {
+            break;
+        }
+        ++m_pos;
+    }
+    if (alternation->children.size() == 1) {
+        return std::move(alternation->children[0]);
+    }
+    return alternation;
+}
+
+uint32_t DMRegexCompiler::AddNode(DMRegex::NodeType type, uint32_t set, uint32_t out, uint32_t out1) {
+    if (m_regex.m_nodes.size() >= DM_REGEX_MAX_NODES) {
+        m_failed = true;
+        return 0;
+    }
+    m_regex.m_nodes.push_back(DMRegex::Node{ type, set, out, out1 });
+    return static_cast<uint32_t>(m_regex.m_nodes.size() - 1);
+}
+
+// 从后往前生成: 返回匹配 ast 后接着匹配 next 的起始状态. 重复的部分每次重新生成一份
+uint32_t DMRegexCompiler::Emit(const DMRegexAst& ast, uint32_t next) {
+    if (m_failed) {
+        return 0;
+    }
+    switch (ast.type) {
+    case DMRegexAst::DM_AST_CHARS:
+        return AddNode(DMRegex::DM_RE_CHAR, ast.set, next, 0);
+    case DMRegexAst::DM_AST_BEGIN:
+        return AddNode(DMRegex::DM_RE_BEGIN, 0, next, 0);
+    case DMRegexAst::DM_AST_END:
+        return AddNode(DMRegex::DM_RE_END, 0, next, 0);
+    case DMRegexAst::DM_AST_EMPTY:
+        return next;
+    case DMRegexAst::DM_AST_CONCAT:
+        for (size_t i = ast.children.size(); i > 0; --i) {
+            next = Emit(*ast.children[i - 1], next);
+        }
+        return next;
+    case DMRegexAst::DM_AST_ALT: {
+        uint32_t start = Emit(*ast.children.back(), next);
+        for (size_t i = ast.children.size() - 1; i > 0; --i) {
+            uint32_t branch = Emit(*ast.children[i - 1], next);
+            start = AddNode(DMRegex::DM_RE_SPLIT, 0, branch, start);
+        }
+        return start;
+    }
+    case DMRegexAst::DM_AST_REPEAT: {
+        const DMRegexAst& child = *ast.children[0];
+        if (ast.max < 0) {
+            // 循环: loop 同时到 child (完成后回到 loop) 和 next
+            uint32_t loop = AddNode(DMRegex::DM_RE_SPLIT, 0, 0, next);
+            uint32_t body = Emit(child, loop);
+            if (m_failed) {
+                return 0;
+            }
+            m_regex.m_nodes[loop].out = body;
+            next = loop;
+        } else {
+            for (int i = ast.min; i < ast.max; ++i) {
+                uint32_t body = Emit(child, next);
+                next = AddNode(DMRegex::DM_RE_SPLIT, 0, body, next);
+            }
+        }
+        for (int i = 0; i < ast.min; ++i) {
+            next = Emit(child, next);
+        }
+        return next;
+    }
+    }
+    return next;
+}
+
+static void DMKeepLonger(std::string& best, const std::string& candidate) {
+    if (candidate.size() > best.size()) {
+        best = candidate;
+    }
+}
+
+DMRegexLiteral DMRegexCompiler::Analyze(const DMRegexAst& ast) const {
+    DMRegexLiteral result;
+    switch (ast.type) {
+    case DMRegexAst::DM_AST_CHARS: {
+        // 只含一个字节 (不区分大小写时为一个字母的大小写两种形式) 时是确定的字符
+        const std::bitset<256>& set = m_regex.m_sets[ast.set];
+        size_t count = set.count();
+        for (int c = 0; c < 256 && (count == 1 || count == 2); ++c) {
+            if (!set[c]) {
+                continue;
+            }
+            bool letterPair = m_icase && count == 2 && c >= 'A' && c <= 'Z' && set[c - 'A' + 'a'];
+            if (count == 1 || letterPair) {
+                result.exact = true;
+                result.text.assign(1, letterPair ? static_cast<char>(c - 'A' + 'a') : static_cast<char>(c));
+                result.required = result.text;
+            }
+            break;
+        }
+        return result;
+    }
+    case DMRegexAst::DM_AST_BEGIN:
+    case DMRegexAst::DM_AST_END:
+    case DMRegexAst::DM_AST_EMPTY:
+        result.exact = true;
+        return result;
+    case DMRegexAst::DM_AST_CONCAT: {
+        // 相邻的确定部分连成一段
+        std::string run;
+        result.exact = true;
+        for (const auto& child : ast.children) {
+            DMRegexLiteral info = Analyze(*child);
+            if (info.exact) {
+                run += info.text;
+            } else {
+                result.exact = false;
+                DMKeepLonger(result.required, run);
+                DMKeepLonger(result.required, info.required);
+                run.clear();
+            }
+        }
+        DMKeepLonger(result.required, run);
+        if (result.exact) {
+            result.text = run;
+        }
+        return result;
+    }
+    case DMRegexAst::DM_AST_REPEAT: {
+        if (ast.min == 0) {
+            return result;
+        }
+        DMRegexLiteral info = Analyze(*ast.children[0]);
+        if (info.exact && ast.min == ast.max && info.text.size() * ast.min <= 256) {
+            result.exact = true;
+            for (int i = 0; i < ast.min; ++i) {
+                result.text += info.text;
+            }
+            result.required = result.text;
+        } else {
+            result.required = info.exact ? info.text : info.required;
+        }
+        return result;
+    }
+    case DMRegexAst::DM_AST_ALT:
+        return result;
+    }
+    return result;
+}
+
+bool DMRegexCompiler::Compile() {
+    m_regex.m_sets.clear();
+    m_regex.m_nodes.clear();
+    m_regex.m_literal.clear();
+    std::unique_ptr<DMRegexAst> ast = ParseAlternation();
+    if (!ast || !AtEnd()) {
+        return false;
+    }
+    uint32_t match = AddNode(DMRegex::DM_RE_MATCH, 0, 0, 0);
+    m_regex.m_start = Emit(*ast, match);
+    if (m_failed) {
+        return false;
+    }
+    m_regex.m_literal = Analyze(*ast).required;
+    return true;
+}
+
+bool DMRegex::Compile(std::string_view pattern, bool icase) {
+    DMRegexCompiler compiler(*this, pattern, icase);
+    ResetCache();
+    if (!compiler.Compile()) {
+        m_nodes.clear();
+        m_sets.clear();
+        m_literal.clear();
+        return false;
+    }
+    m_marks.assign(m_nodes.size(), 0);
+    m_markEpoch = 0;
+    return true;
+}
+
+// 从 stack 中的状态出发, 沿不读入字节的边求闭包; atBegin/atEnd 表示 ^/$ 是否成立
+void DMRegex::Closure(std::vector<uint32_t>& stack, bool atBegin, bool atEnd, std::vector<uint32_t>& result) const {
+    if (++m_markEpoch == 0) {
+        std::fill(m_marks.begin(), m_marks.end(), 0);
+        m_markEpoch = 1;
+    }
+    result.clear();
+    while (!stack.empty()) {
+        uint32_t id = stack.back();
+        stack.pop_back();
+        if (m_marks[id] == m_markEpoch) {
+            continue;
+        }
+        m_marks[id] = m_markEpoch;
+        const Node& node = m_nodes[id];
+        switch (node.type) {
+        case DM_RE_CHAR:
+        case DM_RE_MATCH:
+            result.push_back(id);
+            break;
+        case DM_RE_SPLIT:
+            stack.push_back(node.out1);
+            stack.push_back(node.out);
+            break;
+        case DM_RE_BEGIN:
+            if (atBegin) {
+                stack.push_back(node.out);
+            }
+            break;
+        case DM_RE_END:
+            // 保留在集合中, 文本结束时再继续
+            if (atEnd) {
+                stack.push_back(node.out);
+            } else {
+                result.push_back(id);
+            }
+            break;
+        }
+    }
+    std::sort(result.begin(), result.end());
+}
+
+uint32_t DMRegex::AddState(std::vector<uint32_t>&& nodes, bool atBegin) const {
+    std::string key(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(uint32_t));
+    key.push_back(atBegin ? '\1' : '\0');
+    auto found = m_lookup.find(key);
+    if (found != m_lookup.end()) {
+        return found->second;
+    }
+
+    DfaState state;
+    std::vector<uint32_t> stack;
+    for (uint32_t id : nodes) {
+        if (m_nodes[id].type == DM_RE_MATCH) {
+            state.accept = true;
+        } else if (m_nodes[id].type == DM_RE_END) {
+            stack.push_back(m_nodes[id].out);
+        }
+    }
+    state.acceptAtEnd = state.accept;
+    if (!state.accept && !stack.empty()) {
+        std::vector<uint32_t> atEnd;
+        Closure(stack, atBegin, true, atEnd);
+        for (uint32_t id : atEnd) {
+            if (m_nodes[id].type == DM_RE_MATCH) {
+                state.acceptAtEnd = true;
+            }
+        }
+    }
+    state.dead = nodes.empty();
+    state.nodes = std::move(nodes);
+
+    uint32_t index = static_cast<uint32_t>(m_states.size());
+    m_states.push_back(std::move(state));
+    m_next.resize(m_states.size() * 256, -1);
+    m_lookup.emplace(std::move(key), index);
+    return index;
+}
+
+void DMRegex::ResetCache() const {
+    m_states.clear();
+    m_next.clear();
+    m_lookup.clear();
+    m_initial = 0;
+}
+
+uint32_t DMRegex::InitialState() const {
+    if (m_states.empty()) {
+        std::vector<uint32_t> stack{ m_start };
+        std::vector<uint32_t> nodes;
+        Closure(stack, true, false, nodes);
+        m_initial = AddState(std::move(nodes), true);
+    }
+    return m_initial;
+}
+
+// 读入 byte 后的状态; 每一步都从头重新开始一次匹配, 相当于在模式前加 .*
+uint32_t DMRegex::Step(uint32_t state, unsigned char byte) const {
+    std::vector<uint32_t> stack;
+    for (uint32_t id : m_states[state].nodes) {
+        const Node& node = m_nodes[id];
+        if (node.type == DM_RE_CHAR && m_sets[node.set][byte]) {
+            stack.push_back(node.out);
+        }
+    }
+    stack.push_back(m_start);
+    std::vector<uint32_t> nodes;
+    Closure(stack, false, false, nodes);
+
+    // 缓存的状态过多时清空重来, 原来的 state 随之失效, 这次的转移不再记录
+    if (m_states.size() >= DM_REGEX_MAX_STATES) {
+        ResetCache();
+        InitialState();
+        return AddState(std::move(nodes), false);
+    }
+    uint32_t next = AddState(std::move(nodes), false);
+    m_next[static_cast<size_t>(state) * 256 + byte] = static_cast<int32_t>(next);
+    return next;
+}
+
+bool DMRegex::Search(std::string_view text) const {
+    if (m_nodes.empty()) {
+        return false;
+    }
+    uint32_t state = InitialState();
+    for (char c : text) {
+        const DfaState& current = m_states[state];
+        if (current.accept) {
+            return true;
+        }
+        if (current.dead) {
+            return false;
+        }
+        unsigned char byte = static_cast<unsigned char>(c);
+        int32_t next = m_next[static_cast<size_t>(state) * 256 + byte];
+        state = next >= 0 ? static_cast<uint32_t>(next) : Step(state, byte);
+    }
+    return m_states[state].acceptAtEnd;
+}
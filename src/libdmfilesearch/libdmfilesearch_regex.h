@@ -0,0 +1,91 @@
+// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef __LIBDMFILESEARCH_REGEX_H_INCLUDE__
+#define __LIBDMFILESEARCH_REGEX_H_INCLUDE__
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// 正则表达式搜索 (-r) 用的自动机: 把 ECMAScript 语法的常用子集编译成 NFA, 匹配时按需构造 DFA 状态并缓存,
+// 每个字节只查一次转移表, 不回溯. 支持字符、转义 (\d \w \s 等)、字符类、.、分组、|、* + ? {n,m} 及其非贪婪形式、^ $.
+// 反向引用、前瞻、\b 等不支持的语法编译失败, 由调用方改用 std::regex.
+// 按字节匹配, 与 std::regex 对 char 的处理相同; 不区分大小写时只折叠 ASCII 字母.
+// DFA 缓存随匹配增长, 同一对象不能被多个线程同时使用
+class DMRegex
+{
+public:
+    // 不支持的语法或语法错误时返回 false
+    bool Compile(std::string_view pattern, bool icase);
+
+    // text 中存在匹配 (同 std::regex_search)
+    bool Search(std::string_view text) const;
+
+    // 匹配的文本必定包含的一段字面文本, 不区分大小写时为小写; 为空表示没有
+    const std::string& RequiredLiteral() const { return m_literal; }
+
+private:
+    enum NodeType : uint8_t {
+        DM_RE_CHAR,     // 读入一个属于 set 的字节后到 out
+        DM_RE_SPLIT,    // 同时到 out 和 out1
+        DM_RE_BEGIN,    // 只在文本开头成立
+        DM_RE_END,      // 只在文本结尾成立
+        DM_RE_MATCH,
+    };
+
+    struct Node {
+        NodeType type;
+        uint32_t set;
+        uint32_t out;
+        uint32_t out1;
+    };
+
+    struct DfaState {
+        std::vector<uint32_t> nodes;    // 有序的 NFA 状态集合 (只含 CHAR/END/MATCH)
+        bool accept = false;            // 已经匹配
+        bool acceptAtEnd = false;       // 文本在此结束时匹配
+        bool dead = false;              // 之后不可能再匹配
+    };
+
+    friend class DMRegexCompiler;
+
+    void Closure(std::vector<uint32_t>& stack, bool atBegin, bool atEnd, std::vector<uint32_t>& result) const;
+    uint32_t AddState(std::vector<uint32_t>&& nodes, bool atBegin) const;
+    uint32_t InitialState() const;
+    uint32_t Step(uint32_t state, unsigned char byte) const;
+    void ResetCache() const;
+
+    std::vector<std::bitset<256>> m_sets;
+    std::vector<Node> m_nodes;
+    uint32_t m_start = 0;
+    std::string m_literal;
+
+    mutable std::vector<DfaState> m_states;
+    mutable std::vector<int32_t> m_next;    // m_next[state * 256 + byte], -1 表示尚未构造
+    mutable std::unordered_map<std::string, uint32_t> m_lookup;
+    mutable uint32_t m_initial = 0;
+    mutable std::vector<uint32_t> m_marks;  // 求闭包时的访问标记
+    mutable uint32_t m_markEpoch = 0;
+};
+
+#endif
@@ -0,0 +1,242 @@
+﻿// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "libdmfilesearch_scan.h"
+#include "libdmfilesearch_textscan.h"
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <string>
+
+void DMScanIndex::clear() {
+    m_ready = false;
+    m_starts.clear();
+    m_ids.clear();
+    m_holes = 0;
+    m_epoch = 0;
+    m_buildMicroseconds = 0;
+}
+
+void DMScanIndex::Build(const DMFileTable& table) {
+    auto startTime = std::chrono::steady_clock::now();
+    clear();
+
+    // 追加和整理名称区都按编号顺序写入名称, 通常已经有序
+    std::vector<uint32_t> ids(table.size());
+    std::iota(ids.begin(), ids.end(), 0);
+    auto byOffset = [&table](uint32_t a, uint32_t b) { return table.NameOffset(a) < table.NameOffset(b); };
+    if (!std::is_sorted(ids.begin(), ids.end(), byOffset)) {
+        std::sort(ids.begin(), ids.end(), byOffset);
+    }
+    std::vector<uint32_t> starts(ids.size());
+    for (size_t i = 0; i < ids.size(); ++i) {
+        starts[i] = table.NameOffset(ids[i]);
+    }
+    m_ids.assign(ids.begin(), ids.end());
+    m_starts.assign(starts.begin(), starts.end());
+
+    m_epoch = table.DirEpoch();
+    m_ready = true;
+    m_buildMicroseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - startTime).count());
+}
+
+void DMScanIndex::Add(const DMFileTable& table, uint32_t id) {
+    if (!m_ready) {
+        return;
+    }
+    // 新名称追加在名称区末尾; 名称区整理过时重建, 重建时已包含的项不再重复加入
+    uint32_t start = table.NameOffset(id);
+    if (m_epoch != table.DirEpoch()) {
+        Build(table);
+        return;
+    }
+    if (!m_starts.empty() && start <= m_starts.back()) {
+        if (Find(start, id) == m_starts.size()) {
+            Build(table);
+        }
+        return;
+    }
+    m_starts.push_back(start);
+    m_ids.push_back(id);
+}
+
+// 名称长度为 0 时多项可能位于同一位置, 在相同位置中按编号找
+size_t DMScanIndex::Find(uint32_t start, uint32_t id) const {
+    size_t pos = std::lower_bound(m_starts.begin(), m_starts.end(), start) - m_starts.begin();
+    while (pos < m_starts.size() && m_starts[pos] == start) {
+        if (m_ids[pos] == id) {
+            return pos;
+        }
+        ++pos;
+    }
+    return m_starts.size();
+}
+
+void DMScanIndex::Remove(const DMFileTable& table, uint32_t id, uint32_t last) {
+    if (!m_ready) {
+        return;
+    }
+    if (m_epoch != table.DirEpoch()) {
+        Build(table);
+    }
+    size_t pos = Find(table.NameOffset(id), id);
+    if (pos < m_ids.size()) {
+        m_ids.Set(pos, NONE);
+        ++m_holes;
+    }
+    if (id != last) {
+        pos = Find(table.NameOffset(last), last);
+        if (pos < m_ids.size()) {
+            m_ids.Set(pos, id);
+        }
+    }
+}
+
+void DMScanIndex::Sync(const DMFileTable& table) {
+    if (m_ready && (m_epoch != table.DirEpoch() || m_holes > std::max<size_t>(65536, m_ids.size() / 2))) {
+        Build(table);
+    }
+}
+
+void DMScanIndex::SelectNames(const DMFileTable& table, std::string_view pattern, bool foldCase,
+    DMBitmap& matches) const {
+    std::string_view arena = table.NameArena();
+    size_t pos = 0;
+    while ((pos = DMFindText(arena, pos, pattern, foldCase)) != std::string_view::npos) {
+        // 命中位置所在的名称: 起始位置不大于 pos 的最后一项 (之前可能还有位置相同的空名称)
+        size_t slot = std::upper_bound(m_starts.begin(), m_starts.end(), static_cast<uint32_t>(pos)) -
+            m_starts.begin();
+        size_t next = pos + 1;
+        for (size_t k = slot; k > 0 && m_starts[k - 1] == m_starts[slot - 1]; --k) {
+            uint32_t id = m_ids[k - 1];
+            size_t end = static_cast<size_t>(m_starts[k - 1]) + (id != NONE ? table.Name(id).size() : 0);
+            if (id != NONE && pos + pattern.size() <= end) {
+                // 同一名称中的其他命中不再需要
+                matches.Set(id);
+                next = end;
+                break;
+            }
+        }
+        pos = next;
+    }
+}
+
+void DMScanIndex::Select(const DMFileTable& table, std::string_view pattern, bool foldCase, bool inPath,
+    DMBitmap& candidates) const {
+    if (!m_ready || pattern.empty()) {
+        return;
+    }
+    DMBitmap nameMatches;
+    nameMatches.Assign(table.size(), false);
+    SelectNames(table, pattern, foldCase, nameMatches);
+    if (!inPath) {
+        std::vector<uint64_t>& words = candidates.Words();
+        const std::vector<uint64_t>& matchWords = nameMatches.Words();
+        for (size_t w = 0; w < words.size(); ++w) {
+            words[w] &= matchWords[w];
+        }
+        return;
+    }
+
+    // 完整路径为 目录路径 + [分隔符] + 名称. 目录路径 (加分隔符) 包含 pattern 时目录下所有项都匹配;
+    // 目录路径加分隔符的某个后缀是 pattern 的前缀时, 命中可能跨越目录和名称, 目录下的项逐一校验
+    const size_t dirCount = table.DirCount();
+    std::vector<uint8_t> dirState(dirCount, 0);     // 1: 包含, 2: 需要校验
+    std::string_view dirArena = table.DirPathArena();
+    auto dirStart = [&](size_t dirId) { return static_cast<size_t>(table.DirPath(static_cast<uint32_t>(dirId)).data() - dirArena.data()); };
+    size_t pos = 0;
+    while ((pos = DMFindText(dirArena, pos, pattern, foldCase)) != std::string_view::npos) {
+        // 目录路径按编号顺序存放
+        size_t lo = 0;
+        size_t hi = dirCount;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (dirStart(mid) <= pos) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        size_t next = pos + 1;
+        for (size_t k = lo; k > 0 && dirStart(k - 1) == dirStart(lo - 1); --k) {
+            size_t end = dirStart(k - 1) + table.DirPath(static_cast<uint32_t>(k - 1)).size();
+            if (pos + pattern.size() <= end) {
+                dirState[k - 1] = 1;
+                next = end;
+                break;
+            }
+        }
+        pos = next;
+    }
+
+    for (uint32_t dirId = 0; dirId < dirCount; ++dirId) {
+        if (dirState[dirId] != 0) {
+            continue;
+        }
+        std::string_view path = table.DirPath(dirId);
+        const char separator = table.DirSeparator(dirId);
+        const size_t headSize = path.size() + (separator != 0 ? 1 : 0);
+        // 后缀就是 pattern 时命中以分隔符结尾, 同样整个目录都匹配
+        for (size_t overlap = std::min(headSize, pattern.size()); overlap > 0; --overlap) {
+            size_t start = headSize - overlap;
+            size_t i = 0;
+            for (; i < overlap; ++i) {
+                char c = start + i < path.size() ? path[start + i] : separator;
+                if ((foldCase ? DMFoldCase(c) : c) != pattern[i]) {
+                    break;
+                }
+            }
+            if (i == overlap) {
+                dirState[dirId] = overlap == pattern.size() ? 1 : 2;
+                break;
+            }
+        }
+    }
+
+    std::string pathBuffer;
+    const DMSharedArray<uint32_t>& column = table.DirectoryColumn();
+    std::vector<uint64_t>& words = candidates.Words();
+    for (size_t w = 0; w < words.size(); ++w) {
+        uint64_t word = words[w];
+        const uint32_t* parents = word != 0 ? column.Run(w << 6) : nullptr;
+        while (word != 0) {
+            uint32_t bit = DMCountTrailingZeros(word);
+            uint32_t id = static_cast<uint32_t>((w << 6) + bit);
+            word &= word - 1;
+            uint8_t state = dirState[parents[bit]];
+            if (nameMatches.Test(id) || state == 1) {
+                continue;
+            }
+            if (state == 2) {
+                table.FullPath(id, pathBuffer);
+                if (DMFindText(pathBuffer, 0, pattern, foldCase) != std::string_view::npos) {
+                    continue;
+                }
+            }
+            words[w] &= ~(uint64_t(1) << (id & 63));
+        }
+    }
+}
+
+size_t DMScanIndex::MemoryUsage() const {
+    return m_starts.MemoryUsage() + m_ids.MemoryUsage();
+}
@@ -0,0 +1,69 @@
+// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef __LIBDMFILESEARCH_SCAN_H_INCLUDE__
+#define __LIBDMFILESEARCH_SCAN_H_INCLUDE__
+#include "libdmfilesearch_filetable.h"
+#include "libdmfilesearch_filter.h"
+#include "libdmfilesearch_shared.h"
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// search_engine=scan 时的子串搜索: 用 DMFindText 一次扫描整个名称区 (路径查询还扫描目录路径区),
+// 再把命中位置映射回索引项. 名称区中的名称首尾相接, 跨越两个名称或落在已删除名称中的命中被丢弃.
+// 映射表按名称在名称区中的位置排列; 删除项留下空位, 被移动的项改写编号, 名称区整理后整体重建
+class DMScanIndex
+{
+public:
+    static constexpr uint32_t NONE = 0xFFFFFFFF;
+
+    bool Ready() const { return m_ready; }
+    void clear();
+    void Build(const DMFileTable& table);
+
+    // 新增的项
+    void Add(const DMFileTable& table, uint32_t id);
+    // table 删除 id 并把最后一项 last 移到 id 之前调用
+    void Remove(const DMFileTable& table, uint32_t id, uint32_t last);
+    // 一批删除完成后调用, 名称区已整理或空位过多时重建
+    void Sync(const DMFileTable& table);
+
+    // 在 candidates 中只保留名称 (inPath 时为完整路径) 包含 pattern 的项, 结果是精确的.
+    // foldCase 时 pattern 须已是小写
+    void Select(const DMFileTable& table, std::string_view pattern, bool foldCase, bool inPath,
+        DMBitmap& candidates) const;
+
+    uint64_t BuildMicroseconds() const { return m_buildMicroseconds; }
+    size_t MemoryUsage() const;
+
+private:
+    size_t Find(uint32_t start, uint32_t id) const;
+    void SelectNames(const DMFileTable& table, std::string_view pattern, bool foldCase, DMBitmap& matches) const;
+
+    bool m_ready = false;
+    DMSharedArray<uint32_t> m_starts;   // 名称在名称区中的位置, 从小到大
+    DMSharedArray<uint32_t> m_ids;      // 对应的编号, 已删除的为 NONE
+    size_t m_holes = 0;
+    uint64_t m_epoch = 0;               // 建立时名称区的版本 (DMFileTable::DirEpoch)
+    uint64_t m_buildMicroseconds = 0;
+};
+
+#endif
@@ -0,0 +1,82 @@
+// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef __LIBDMFILESEARCH_SERIALIZE_H_INCLUDE__
+#define __LIBDMFILESEARCH_SERIALIZE_H_INCLUDE__
+#include "dmfilesearch.h"
+#include <istream>
+#include <ostream>
+
+// 索引文件和检查点文件共用的二进制编码, 数值按本机字节序写入
+
+static const uint8_t DM_INDEX_FLAG_DIRECTORY = 0x01;
+static const uint8_t DM_INDEX_FLAG_METADATA = 0x02;
+
+template <typename T>
+inline void DMWriteValue(std::ostream& os, const T& value) {
+    os.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+inline bool DMReadValue(std::istream& is, T& value) {
+    return static_cast<bool>(is.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+// 长度 (uint32) + 内容
+inline void DMWriteString(std::ostream& os, const std::string& str) {
+    uint32_t length = static_cast<uint32_t>(str.length());
+    DMWriteValue(os, length);
+    os.write(str.c_str(), length);
+}
+
+inline bool DMReadString(std::istream& is, std::string& str) {
+    uint32_t length = 0;
+    if (!DMReadValue(is, length)) {
+        return false;
+    }
+    str.resize(length);
+    return length == 0 || static_cast<bool>(is.read(&str[0], length));
+}
+
+// 完整路径、名称、目录、大小、修改时间和标志位 (版本1 起的格式)
+inline void DMWriteFileInfo(std::ostream& os, const DMFileInfo& fileInfo) {
+    DMWriteString(os, fileInfo.fullPath);
+    DMWriteString(os, fileInfo.fileName);
+    DMWriteString(os, fileInfo.directory);
+    DMWriteValue(os, fileInfo.fileSize);
+    DMWriteValue(os, fileInfo.modifyTime);
+    uint8_t flags = (fileInfo.isDirectory ? DM_INDEX_FLAG_DIRECTORY : 0) |
+        (fileInfo.hasMetadata ? DM_INDEX_FLAG_METADATA : 0);
+    DMWriteValue(os, flags);
+}
+
+inline bool DMReadFileInfo(std::istream& is, DMFileInfo& fileInfo) {
+    uint8_t flags = 0;
+    if (!DMReadString(is, fileInfo.fullPath) || !DMReadString(is, fileInfo.fileName) ||
+        !DMReadString(is, fileInfo.directory) || !DMReadValue(is, fileInfo.fileSize) ||
+        !DMReadValue(is, fileInfo.modifyTime) || !DMReadValue(is, flags)) {
+        return false;
+    }
+    fileInfo.isDirectory = (flags & DM_INDEX_FLAG_DIRECTORY) != 0;
+    fileInfo.hasMetadata = (flags & DM_INDEX_FLAG_METADATA) != 0;
+    return true;
+}
+
+#endif
@@ -0,0 +1,88 @@
+﻿// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "libdmfilesearch_shared.h"
+#include "libdmfilesearch_filetable.h"
+
+#include <algorithm>
+#include <cstring>
+
+void DMSharedArena::Reallocate(size_t capacity) {
+    auto buffer = std::make_shared<Buffer>();
+    buffer->bytes.reset(new char[capacity]);
+    buffer->capacity = capacity;
+    if (m_size > 0) {
+        std::memcpy(buffer->bytes.get(), m_buffer->bytes.get(), m_size);
+    }
+    buffer->used = m_size;
+    m_buffer = std::move(buffer);
+}
+
+char* DMSharedArena::Grow(size_t count) {
+    // 已用长度等于自己的长度时占用其后的空间; 其他副本已在此追加过或容量不足时换一个缓冲区
+    size_t expected = m_size;
+    if (!m_buffer || m_size + count > m_buffer->capacity ||
+        !m_buffer->used.compare_exchange_strong(expected, m_size + count)) {
+        Reallocate(std::max<size_t>({ m_size + count, capacity() * 2, 256 }));
+        m_buffer->used = m_size + count;
+    }
+    char* position = m_buffer->bytes.get() + m_size;
+    m_size += count;
+    return position;
+}
+
+void DMSharedArena::append(std::string_view text) {
+    if (!text.empty()) {
+        std::memcpy(Grow(text.size()), text.data(), text.size());
+    }
+}
+
+void DMSharedArena::AppendFolded(std::string_view text) {
+    if (text.empty()) {
+        return;
+    }
+    char* position = Grow(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        position[i] = DMFoldCase(text[i]);
+    }
+}
+
+void DMSharedArena::clear() {
+    if (m_buffer && m_buffer.use_count() == 1) {
+        m_buffer->used = 0;
+    } else {
+        m_buffer.reset();
+    }
+    m_size = 0;
+}
+
+void DMSharedArena::reserve(size_t capacity) {
+    if (capacity > this->capacity()) {
+        Reallocate(capacity);
+    }
+}
+
+void DMSharedArena::shrink_to_fit() {
+    if (m_size == 0) {
+        m_buffer.reset();
+    } else if (m_size < capacity()) {
+        Reallocate(m_size);
+    }
+}
@@ -0,0 +1,343 @@
+// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef __LIBDMFILESEARCH_SHARED_H_INCLUDE__
+#define __LIBDMFILESEARCH_SHARED_H_INCLUDE__
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// 快照之间共享存储的容器. 复制容器只复制块 (或分片) 指针, 修改时只复制被其他副本共享的那一块,
+// 增量更新的复制量与改动的项数成正比, 与索引大小无关.
+// 同一时刻只有一个写入方修改某个副本; 已发布的副本只读, 可被多个线程同时读取
+
+// 被多个副本共享的块在修改前复制一份. use_count 为 1 时其他副本已经释放, 补一个 acquire 屏障,
+// 使其他线程释放前的读取先于这里的写入
+template <typename Block>
+inline Block& DMUniqueBlock(std::shared_ptr<Block>& block) {
+    if (block.use_count() > 1) {
+        block = std::make_shared<Block>(*block);
+    } else {
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return *block;
+}
+
+// 分块的数组, 每块 4096 项. 块的大小是 64 的倍数, 按位图的字访问时一个字内的项都在同一块中
+template <typename T>
+class DMSharedArray
+{
+public:
+    static constexpr size_t CHUNK_SHIFT = 12;
+    static constexpr size_t CHUNK_SIZE = size_t(1) << CHUNK_SHIFT;
+    static constexpr size_t CHUNK_MASK = CHUNK_SIZE - 1;
+
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        const_iterator() = default;
+        const_iterator(const DMSharedArray* array, size_t index) : m_array(array), m_index(index) {}
+
+        reference operator*() const { return (*m_array)[m_index]; }
+        pointer operator->() const { return &(*m_array)[m_index]; }
+        reference operator[](difference_type n) const { return (*m_array)[m_index + n]; }
+        const_iterator& operator++() { ++m_index; return *this; }
+        const_iterator operator++(int) { const_iterator it = *this; ++m_index; return it; }
+        const_iterator& operator--() { --m_index; return *this; }
+        const_iterator operator--(int) { const_iterator it = *this; --m_index; return it; }
+        const_iterator& operator+=(difference_type n) { m_index += n; return *this; }
+        const_iterator& operator-=(difference_type n) { m_index -= n; return *this; }
+        const_iterator operator+(difference_type n) const { return const_iterator(m_array, m_index + n); }
+        const_iterator operator-(difference_type n) const { return const_iterator(m_array, m_index - n); }
+        difference_type operator-(const const_iterator& other) const {
+            return static_cast<difference_type>(m_index) - static_cast<difference_type>(other.m_index);
+        }
+        bool operator==(const const_iterator& other) const { return m_index == other.m_index; }
+        bool operator!=(const const_iterator& other) const { return m_index != other.m_index; }
+        bool operator<(const const_iterator& other) const { return m_index < other.m_index; }
+        bool operator>(const const_iterator& other) const { return m_index > other.m_index; }
+        bool operator<=(const const_iterator& other) const { return m_index <= other.m_index; }
+        bool operator>=(const const_iterator& other) const { return m_index >= other.m_index; }
+
+    private:
+        const DMSharedArray* m_array = nullptr;
+        size_t m_index = 0;
+    };
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    const T& operator[](size_t i) const { return m_chunks[i >> CHUNK_SHIFT]->items[i & CHUNK_MASK]; }
+    const T& back() const { return (*this)[m_size - 1]; }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, m_size); }
+
+    // 第 i 项起到所在块末尾的连续存储
+    const T* Run(size_t i) const { return m_chunks[i >> CHUNK_SHIFT]->items + (i & CHUNK_MASK); }
+
+    // 可写的第 i 项, 所在块被共享时先复制
+    T& Mutable(size_t i) { return DMUniqueBlock(m_chunks[i >> CHUNK_SHIFT]).items[i & CHUNK_MASK]; }
+    void Set(size_t i, const T& value) { Mutable(i) = value; }
+
+    void push_back(const T& value) {
+        if (m_size == m_chunks.size() * CHUNK_SIZE) {
+            m_chunks.push_back(std::make_shared<Block>());
+        }
+        Mutable(m_size) = value;
+        ++m_size;
+    }
+
+    // 不写入被删除的位置, 块可能仍被其他副本使用
+    void pop_back() {
+        --m_size;
+        if ((m_size & CHUNK_MASK) == 0) {
+            m_chunks.pop_back();
+        }
+    }
+
+    void resize(size_t count, const T& value = T()) {
+        if (count <= m_size) {
+            m_size = count;
+            m_chunks.resize((count + CHUNK_MASK) >> CHUNK_SHIFT);
+            return;
+        }
+        while (m_size < count) {
+            if (m_size == m_chunks.size() * CHUNK_SIZE) {
+                m_chunks.push_back(std::make_shared<Block>());
+            }
+            T* items = DMUniqueBlock(m_chunks[m_size >> CHUNK_SHIFT]).items;
+            size_t end = std::min(count - (m_size & ~CHUNK_MASK), CHUNK_SIZE);
+            for (size_t k = m_size & CHUNK_MASK; k < end; ++k) {
+                items[k] = value;
+            }
+            m_size = (m_size & ~CHUNK_MASK) + end;
+        }
+    }
+
+    template <typename Iterator>
+    void assign(Iterator first, Iterator last) {
+        clear();
+        reserve(static_cast<size_t>(std::distance(first, last)));
+        for (; first != last; ++first) {
+            push_back(*first);
+        }
+    }
+
+    // 与 std::vector 一样保留存储: 第一块没有被其他副本共享时留作之后追加
+    void clear() {
+        if (!m_chunks.empty() && m_chunks[0].use_count() == 1) {
+            m_chunks.resize(1);
+        } else {
+            m_chunks.clear();
+        }
+        m_size = 0;
+    }
+    void reserve(size_t count) { m_chunks.reserve((count + CHUNK_MASK) >> CHUNK_SHIFT); }
+    void shrink_to_fit() { m_chunks.shrink_to_fit(); }
+    void swap(DMSharedArray& other) {
+        m_chunks.swap(other.m_chunks);
+        std::swap(m_size, other.m_size);
+    }
+
+    // 按块计算, 被共享的块在每个副本中都计入
+    size_t MemoryUsage() const {
+        return m_chunks.size() * sizeof(Block) + m_chunks.capacity() * sizeof(std::shared_ptr<Block>);
+    }
+
+private:
+    // 新块不清零, 每一项在 m_size 覆盖到之前都会先写入
+    struct Block {
+        Block() {}
+        T items[CHUNK_SIZE];
+    };
+
+    std::vector<std::shared_ptr<Block>> m_chunks;   // clear 之后可能多留一块
+    size_t m_size = 0;
+};
+
+// 只追加的字节区, 保持连续以便整体扫描. 各副本共享同一缓冲区并各自记录长度;
+// 追加时只有长度等于缓冲区已用长度的副本 (最新的一份) 可以原地写入, 其他副本先复制自己的部分.
+// 已写入的字节不再改变, 读取方只访问自己长度以内的部分
+class DMSharedArena
+{
+public:
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    const char* data() const { return m_buffer ? m_buffer->bytes.get() : ""; }
+    std::string_view View() const { return std::string_view(data(), m_size); }
+    size_t capacity() const { return m_buffer ? m_buffer->capacity : 0; }
+
+    // 在末尾留出 count 字节并返回写入位置
+    char* Grow(size_t count);
+    void append(std::string_view text);
+    // 追加 text 的小写形式
+    void AppendFolded(std::string_view text);
+
+    // 缓冲区没有被其他副本共享时保留
+    void clear();
+    void reserve(size_t capacity);
+    void shrink_to_fit();
+    void swap(DMSharedArena& other) {
+        m_buffer.swap(other.m_buffer);
+        std::swap(m_size, other.m_size);
+    }
+
+private:
+    struct Buffer {
+        std::unique_ptr<char[]> bytes;
+        size_t capacity = 0;
+        std::atomic<size_t> used{0};    // 已被某个副本占用的长度
+    };
+
+    void Reallocate(size_t capacity);
+
+    std::shared_ptr<Buffer> m_buffer;
+    size_t m_size = 0;
+};
+
+// 分片的哈希表, 修改时只复制被共享的分片. 项数较少时只用一个分片, 超过 SPLIT_SIZE 后拆成 1024 个
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class DMSharedMap
+{
+public:
+    using Shard = std::unordered_map<Key, Value, Hash>;
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    const Value* Find(const Key& key) const {
+        if (m_shards.empty()) {
+            return nullptr;
+        }
+        const std::shared_ptr<Shard>& shard = m_shards[ShardOf(Hash()(key))];
+        if (!shard) {
+            return nullptr;
+        }
+        auto it = shard->find(key);
+        return it == shard->end() ? nullptr : &it->second;
+    }
+
+    // 不存在时插入默认值
+    Value& operator[](const Key& key) {
+        if (m_bits == 0 && m_size >= SPLIT_SIZE) {
+            Split();
+        }
+        Shard& shard = MutableShard(ShardOf(Hash()(key)));
+        size_t before = shard.size();
+        Value& value = shard[key];
+        m_size += shard.size() - before;
+        return value;
+    }
+
+    bool Erase(const Key& key) {
+        if (Find(key) == nullptr) {
+            return false;
+        }
+        MutableShard(ShardOf(Hash()(key))).erase(key);
+        --m_size;
+        return true;
+    }
+
+    // 只有一个分片且没有被共享时保留其桶数组
+    void clear() {
+        if (m_bits == 0 && !m_shards.empty() && m_shards[0].use_count() == 1) {
+            m_shards[0]->clear();
+        } else {
+            m_shards.clear();
+            m_bits = 0;
+        }
+        m_size = 0;
+    }
+
+    // 逐项访问, 顺序不定
+    template <typename Func>
+    void ForEach(Func&& func) const {
+        for (const auto& shard : m_shards) {
+            if (shard) {
+                for (const auto& entry : *shard) {
+                    func(entry.first, entry.second);
+                }
+            }
+        }
+    }
+
+    // 与 DMHashMapHeap 相同的估算, 键值自身另外分配的内存不计
+    size_t MemoryUsage() const {
+        size_t bytes = m_shards.capacity() * sizeof(std::shared_ptr<Shard>);
+        for (const auto& shard : m_shards) {
+            if (shard) {
+                bytes += sizeof(Shard) + shard->size() * (sizeof(typename Shard::value_type) + 2 * sizeof(void*)) +
+                    shard->bucket_count() * sizeof(void*);
+            }
+        }
+        return bytes;
+    }
+
+private:
+    static constexpr uint32_t SHARD_BITS = 10;
+    static constexpr size_t SPLIT_SIZE = 4096;
+
+    size_t ShardOf(size_t hash) const {
+        if (m_bits == 0) {
+            return 0;
+        }
+        return static_cast<size_t>((static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ULL) >> (64 - m_bits));
+    }
+
+    void Split() {
+        std::shared_ptr<Shard> single = std::move(m_shards[0]);
+        m_bits = SHARD_BITS;
+        m_shards.assign(size_t(1) << SHARD_BITS, nullptr);
+        for (const auto& entry : *single) {
+            MutableShard(ShardOf(Hash()(entry.first))).emplace(entry.first, entry.second);
+        }
+    }
+
+    Shard& MutableShard(size_t index) {
+        if (m_shards.empty()) {
+            m_shards.resize(1);
+        }
+        std::shared_ptr<Shard>& shard = m_shards[index];
+        if (!shard) {
+            shard = std::make_shared<Shard>();
+            return *shard;
+        }
+        return DMUniqueBlock(shard);
+    }
+
+    std::vector<std::shared_ptr<Shard>> m_shards;
+    uint32_t m_bits = 0;                // 分片数为 2^m_bits
+    size_t m_size = 0;
+};
+
+#endif
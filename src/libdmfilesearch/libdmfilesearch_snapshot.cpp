@@ -0,0 +1,45 @@
+﻿// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "libdmfilesearch_snapshot.h"
+
+size_t DMIndexSnapshot::MemoryUsage() const {
+    size_t bytes = fileIndex.MemoryUsage();
+    bytes += scanIndex.MemoryUsage();
+    bytes += trigramIndex.MemoryUsage();
+    bytes += suffixIndex.MemoryUsage();
+
+    bytes += nameIndex.MemoryUsage();
+    bytes += nameOrder.MemoryUsage();
+
+    bytes += dirStamps.MemoryUsage();
+    dirStamps.ForEach([&](const std::string& dir, const DMDirStamp&) {
+        bytes += DMStringHeap(dir);
+    });
+
+    bytes += mounts.capacity() * sizeof(DMIndexMount);
+    for (const auto& mount : mounts) {
+        bytes += DMStringHeap(mount.mountPoint) + DMStringHeap(mount.fsType);
+    }
+    for (const auto& rootPath : rootPaths) {
+        bytes += sizeof(rootPath) + DMStringHeap(rootPath);
+    }
+    return bytes;
+}
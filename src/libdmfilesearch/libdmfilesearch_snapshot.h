@@ -0,0 +1,57 @@
+// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef __LIBDMFILESEARCH_SNAPSHOT_H_INCLUDE__
+#define __LIBDMFILESEARCH_SNAPSHOT_H_INCLUDE__
+#include "dmfilesearch.h"
+#include "libdmfilesearch_crawler.h"
+#include "libdmfilesearch_filetable.h"
+#include "libdmfilesearch_mount.h"
+#include "libdmfilesearch_namehash.h"
+#include "libdmfilesearch_nameorder.h"
+#include "libdmfilesearch_scan.h"
+#include "libdmfilesearch_shared.h"
+#include "libdmfilesearch_suffix.h"
+#include "libdmfilesearch_trigram.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// 一代完整的索引数据. 发布后只读, 搜索持有引用期间不会被修改或释放;
+// 写入方在新对象或副本上修改, 完成后整体替换. 各部分分块共享存储, 复制只复制块指针,
+// 副本上的修改只复制改到的块
+struct DMIndexSnapshot {
+    DMFileTable fileIndex;
+    DMNameHash nameIndex;                   // 小写名称索引, 用于全词查询
+    DMNameOrder nameOrder;                  // 按小写名称排列的顺序, 用于前缀查询
+    DMScanIndex scanIndex;                  // search_engine=scan 时名称区位置到编号的映射
+    DMTrigramIndex trigramIndex;            // search_engine=trigram 时的子串索引
+    DMSuffixIndex suffixIndex;              // search_engine=suffix 时的子串索引
+    std::vector<DMIndexMount> mounts;       // 索引涉及的挂载点
+    DMStringList rootPaths;                 // 构建索引时的根路径 (已去掉末尾分隔符)
+    DMSharedMap<std::string, DMDirStamp> dirStamps; // 各目录遍历或上次刷新时的时间戳
+    uint64_t generation = 0;                // 发布时的索引版本号
+    DMIndexProgress progress;               // 构建中发布的部分索引为不完整
+
+    // 估算占用的堆内存 (字节)
+    size_t MemoryUsage() const;
+};
+
+#endif
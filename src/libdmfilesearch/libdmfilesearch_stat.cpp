@@ -0,0 +1,320 @@
+﻿// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+#include "libdmfilesearch_stat.h"
+#include "libdmfilesearch_crawler.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define DM_HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef DM_HAVE_IO_URING
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+// 不依赖 liburing 的最小 io_uring 封装, 只用于提交 statx
+class DMStatRing
+{
+public:
+    DMStatRing() {}
+    ~DMStatRing() { Close(); }
+
+    bool Open(uint32_t depth) {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+
+        m_fd = static_cast<int>(syscall(__NR_io_uring_setup, depth, &params));
+        if (m_fd < 0) {
+            return false;
+        }
+
+        m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+        }
+
+        m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            m_fd, IORING_OFF_SQ_RING);
+        if (m_sqRing == MAP_FAILED) {
+            m_sqRing = nullptr;
+            Close();
+            return false;
+        }
+
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            m_cqRing = m_sqRing;
+        } else {
+            m_cqRing = mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                m_fd, IORING_OFF_CQ_RING);
+            if (m_cqRing == MAP_FAILED) {
+                m_cqRing = nullptr;
+                Close();
+                return false;
+            }
+        }
+
+        m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            m_fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            Close();
+            return false;
+        }
+        m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+        char* sq = static_cast<char*>(m_sqRing);
+        m_sqHead = reinterpret_cast<uint32_t*>(sq + params.sq_off.head);
+        m_sqTail = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+        m_sqMask = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+        m_sqArray = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+        m_sqEntries = params.sq_entries;
+
+        char* cq = static_cast<char*>(m_cqRing);
+        m_cqHead = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+        m_cqTail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+        m_cqMask = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        m_cqEntries = params.cq_entries;
+        return true;
+    }
+
+    void Close() {
+        if (m_sqes) {
+            munmap(m_sqes, m_sqesSize);
+            m_sqes = nullptr;
+        }
+        if (m_cqRing && m_cqRing != m_sqRing) {
+            munmap(m_cqRing, m_cqRingSize);
+        }
+        m_cqRing = nullptr;
+        if (m_sqRing) {
+            munmap(m_sqRing, m_sqRingSize);
+            m_sqRing = nullptr;
+        }
+        if (m_fd >= 0) {
+            close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+    uint32_t Capacity() const { return std::min(m_sqEntries, m_cqEntries); }
+
+    // 写入一个 statx 请求, 由 Submit 统一提交
+    void PrepareStatx(const char* path, struct statx* buffer, uint64_t userData) {
+        uint32_t tail = *m_sqTail + m_queued;
+        uint32_t index = tail & m_sqMask;
+        io_uring_sqe* sqe = &m_sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_STATX;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uint64_t>(path);
+        sqe->len = STATX_SIZE | STATX_MTIME | STATX_MODE;
+        sqe->off = reinterpret_cast<uint64_t>(buffer);
+        sqe->statx_flags = 0;
+        sqe->user_data = userData;
+        m_sqArray[index] = index;
+        ++m_queued;
+    }
+
+    // 提交已写入的请求并至少等待一个完成
+    bool Submit() {
+        __atomic_store_n(m_sqTail, *m_sqTail + m_queued, __ATOMIC_RELEASE);
+        uint32_t toSubmit = m_queued;
+        m_queued = 0;
+
+        for (;;) {
+            long ret = syscall(__NR_io_uring_enter, m_fd, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (ret >= 0) {
+                return true;
+            }
+            if (errno != EINTR) {
+                return false;
+            }
+            toSubmit = 0;
+        }
+    }
+
+    template <typename Fn>
+    uint32_t Reap(Fn&& fn) {
+        uint32_t head = *m_cqHead;
+        uint32_t tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+        uint32_t reaped = 0;
+        for (; head != tail; ++head, ++reaped) {
+            const io_uring_cqe& cqe = m_cqes[head & m_cqMask];
+            fn(cqe.user_data, cqe.res);
+        }
+        __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+        return reaped;
+    }
+
+private:
+    int m_fd = -1;
+    void* m_sqRing = nullptr;
+    void* m_cqRing = nullptr;
+    size_t m_sqRingSize = 0;
+    size_t m_cqRingSize = 0;
+    size_t m_sqesSize = 0;
+    io_uring_sqe* m_sqes = nullptr;
+    uint32_t* m_sqHead = nullptr;
+    uint32_t* m_sqTail = nullptr;
+    uint32_t* m_sqArray = nullptr;
+    uint32_t m_sqMask = 0;
+    uint32_t m_sqEntries = 0;
+    uint32_t* m_cqHead = nullptr;
+    uint32_t* m_cqTail = nullptr;
+    io_uring_cqe* m_cqes = nullptr;
+    uint32_t m_cqMask = 0;
+    uint32_t m_cqEntries = 0;
+    uint32_t m_queued = 0;
+};
+
+// 使用 io_uring 采集元数据, 内核不支持时返回 false, 调用方退化为线程池
+static bool DMCollectMetadataUring(DMFileTable& table, std::vector<uint32_t>& pending, uint32_t queueDepth) {
+    DMStatRing ring;
+    if (!ring.Open(std::max<uint32_t>(queueDepth, 1))) {
+        return false;
+    }
+
+    const uint32_t capacity = ring.Capacity();
+    std::vector<struct statx> buffers(capacity);
+    std::vector<std::string> paths(capacity);   // 请求完成前路径必须有效
+    std::vector<uint32_t> freeSlots(capacity);
+    for (uint32_t i = 0; i < capacity; ++i) {
+        freeSlots[i] = capacity - 1 - i;
+    }
+    // 槽位 -> pending 下标
+    std::vector<size_t> slotOwner(capacity);
+
+    bool failed = false;
+    size_t next = 0;
+    size_t inflight = 0;
+
+    while ((next < pending.size() && !failed) || inflight > 0) {
+        uint32_t queued = 0;
+        while (!failed && next < pending.size() && !freeSlots.empty()) {
+            uint32_t slot = freeSlots.back();
+            freeSlots.pop_back();
+            slotOwner[slot] = next;
+            table.FullPath(pending[next], paths[slot]);
+            ring.PrepareStatx(paths[slot].c_str(), &buffers[slot], slot);
+            ++next;
+            ++queued;
+        }
+        inflight += queued;
+
+        if (!ring.Submit()) {
+            failed = true;
+            break;
+        }
+
+        ring.Reap([&](uint64_t userData, int32_t res) {
+            uint32_t slot = static_cast<uint32_t>(userData);
+            uint32_t id = pending[slotOwner[slot]];
+            if (res == 0) {
+                const struct statx& stx = buffers[slot];
+                table.FillMetadata(id, S_ISREG(stx.stx_mode), stx.stx_size,
+                    static_cast<uint64_t>(stx.stx_mtime.tv_sec));
+            } else if (res == -EINVAL || res == -EOPNOTSUPP) {
+                // 内核不支持 IORING_OP_STATX, 剩余项交给线程池
+                failed = true;
+            } else {
+                table.FillMetadata(id, false, 0, 0);
+            }
+            freeSlots.push_back(slot);
+            --inflight;
+        });
+    }
+
+    if (failed) {
+        pending.erase(std::remove_if(pending.begin(), pending.end(),
+            [&table](uint32_t id) { return table.HasMetadata(id); }), pending.end());
+        return false;
+    }
+    pending.clear();
+    return true;
+}
+#endif
+
+static void DMCollectMetadataThreads(DMFileTable& table, std::vector<uint32_t>& pending, uint32_t threadCount,
+    const DMMetadataLoader& loader) {
+    static const size_t DM_STAT_CHUNK = 256;
+    std::atomic<size_t> next{0};
+
+    // 各线程写入不同的项, 表本身不扩容, 无需加锁
+    auto worker = [&]() {
+        DMFileInfo fileInfo;
+        for (;;) {
+            size_t begin = next.fetch_add(DM_STAT_CHUNK);
+            if (begin >= pending.size()) {
+                break;
+            }
+            size_t end = std::min(begin + DM_STAT_CHUNK, pending.size());
+            for (size_t i = begin; i < end; ++i) {
+                table.FullPath(pending[i], fileInfo.fullPath);
+                fileInfo.isDirectory = table.IsDirectory(pending[i]);
+                loader(fileInfo);
+                table.SetMetadata(pending[i], fileInfo.fileSize, fileInfo.modifyTime);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (uint32_t i = 1; i < threadCount; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    pending.clear();
+}
+
+DMStatBackend DMCollectMetadata(DMFileTable& table, size_t firstEntry, uint32_t queueDepth, uint32_t threadCount,
+    const DMMetadataLoader& loader) {
+    std::vector<uint32_t> pending;
+    for (size_t i = firstEntry; i < table.size(); ++i) {
+        if (!table.HasMetadata(static_cast<uint32_t>(i))) {
+            pending.push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+#ifdef DM_HAVE_IO_URING
+    if (DMCollectMetadataUring(table, pending, queueDepth)) {
+        return DM_STAT_BACKEND_IO_URING;
+    }
+#endif
+
+    DMCollectMetadataThreads(table, pending, std::max<uint32_t>(threadCount, 1), loader);
+    return DM_STAT_BACKEND_THREADS;
+}
@@ -0,0 +1,41 @@
+// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef __LIBDMFILESEARCH_STAT_H_INCLUDE__
+#define __LIBDMFILESEARCH_STAT_H_INCLUDE__
+#include "dmfilesearch.h"
+#include "libdmfilesearch_filetable.h"
+#include <functional>
+
+// 元数据采集方式
+enum DMStatBackend {
+    DM_STAT_BACKEND_THREADS = 0,    // 阻塞 stat 线程池
+    DM_STAT_BACKEND_IO_URING = 1,   // io_uring 批量 statx
+};
+
+// 单项阻塞加载元数据, 线程池方式使用; 传入的 DMFileInfo 只填写了 fullPath 和 isDirectory
+typedef std::function<void(DMFileInfo&)> DMMetadataLoader;
+
+// 为 table 中 firstEntry 之后尚未加载元数据的项批量获取大小和修改时间.
+// 优先使用 io_uring 提交 statx 请求, 不可用时退化为 threadCount 个线程调用 loader.
+DMStatBackend DMCollectMetadata(DMFileTable& table, size_t firstEntry, uint32_t queueDepth, uint32_t threadCount,
+    const DMMetadataLoader& loader);
+
+#endif
@@ -0,0 +1,129 @@
+﻿// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "libdmfilesearch_suffix.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+void DMSuffixIndex::clear() {
+    m_ready = false;
+    m_data.reset();
+    m_unindexed.clear();
+    m_buildMicroseconds = 0;
+}
+
+void DMSuffixIndex::Build(const DMFileTable& table) {
+    auto startTime = std::chrono::steady_clock::now();
+    clear();
+
+    size_t textSize = 0;
+    for (uint32_t id = 0; id < table.size(); ++id) {
+        textSize += table.FoldedName(id).size() + 1;
+    }
+    if (textSize > 0xFFFFFFFFULL) {
+        throw std::length_error("后缀数组的文本超过 4GB");
+    }
+    auto data = std::make_shared<Data>();
+    data->text.reserve(textSize);
+    data->starts.reserve(table.size());
+    data->suffixes.reserve(textSize - table.size());
+    for (uint32_t id = 0; id < table.size(); ++id) {
+        std::string_view name = table.FoldedName(id);
+        uint32_t start = static_cast<uint32_t>(data->text.size());
+        data->starts.push_back(start);
+        for (uint32_t i = 0; i < name.size(); ++i) {
+            data->suffixes.push_back(start + i);
+        }
+        data->text.append(name.data(), name.size());
+        data->text.push_back('\0');
+    }
+
+    // 每个后缀在所在名称的 '\0' 处结束, 直接按 C 字符串比较
+    const char* text = data->text.c_str();
+    std::sort(data->suffixes.begin(), data->suffixes.end(), [text](uint32_t a, uint32_t b) {
+        return std::strcmp(text + a, text + b) < 0;
+    });
+    m_data = std::move(data);
+    m_ready = true;
+
+    m_buildMicroseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - startTime).count());
+}
+
+void DMSuffixIndex::Add(const DMFileTable& table, uint32_t id) {
+    if (!m_ready) {
+        return;
+    }
+    if (m_unindexed.size() > std::max<size_t>(65536, m_data->starts.size() / 8)) {
+        Build(table);
+        return;
+    }
+    m_unindexed.push_back(id);
+}
+
+bool DMSuffixIndex::Select(std::string_view foldedPattern, bool inPath, DMBitmap& candidates) const {
+    if (!m_ready || inPath || foldedPattern.empty() || foldedPattern.find('\0') != std::string_view::npos) {
+        return false;
+    }
+
+    // 以 foldedPattern 开头的后缀在数组中连续
+    const std::vector<uint32_t>& starts = m_data->starts;
+    const std::vector<uint32_t>& suffixes = m_data->suffixes;
+    const char* text = m_data->text.c_str();
+    const char* pattern = foldedPattern.data();
+    const size_t length = foldedPattern.size();
+    auto first = std::lower_bound(suffixes.begin(), suffixes.end(), 0, [&](uint32_t suffix, int) {
+        return std::strncmp(text + suffix, pattern, length) < 0;
+    });
+    auto last = std::upper_bound(first, suffixes.end(), 0, [&](int, uint32_t suffix) {
+        return std::strncmp(text + suffix, pattern, length) > 0;
+    });
+
+    // 后缀位置换算成名称所属的项
+    std::vector<uint32_t> ids;
+    ids.reserve(static_cast<size_t>(last - first) + m_unindexed.size());
+    for (auto it = first; it != last; ++it) {
+        auto start = std::upper_bound(starts.begin(), starts.end(), *it);
+        ids.push_back(static_cast<uint32_t>(start - starts.begin() - 1));
+    }
+    ids.insert(ids.end(), m_unindexed.begin(), m_unindexed.end());
+
+    const size_t count = candidates.size();
+    DMBitmap selected;
+    selected.Assign(count, false);
+    for (uint32_t id : ids) {
+        if (id < count && candidates.Test(id)) {
+            selected.Set(id);
+        }
+    }
+    candidates = std::move(selected);
+    return true;
+}
+
+size_t DMSuffixIndex::MemoryUsage() const {
+    size_t bytes = m_unindexed.MemoryUsage();
+    if (m_data) {
+        bytes += m_data->text.capacity() + (m_data->starts.capacity() + m_data->suffixes.capacity()) * sizeof(uint32_t);
+    }
+    return bytes;
+}
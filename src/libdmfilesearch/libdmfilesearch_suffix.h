@@ -0,0 +1,66 @@
+// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef __LIBDMFILESEARCH_SUFFIX_H_INCLUDE__
+#define __LIBDMFILESEARCH_SUFFIX_H_INCLUDE__
+#include "libdmfilesearch_filetable.h"
+#include "libdmfilesearch_filter.h"
+#include "libdmfilesearch_shared.h"
+#include <memory>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 小写名称的后缀数组: 所有名称以 '\0' 分隔连成一个文本, 按字典序排列文本中每个名称内的后缀.
+// 子串查询是两次二分查找, 得到的区间内每个后缀对应一个包含该子串的名称.
+// 建立之后新增或被移动的项不进入后缀数组, 查询时一律作为候选; 积累过多时整体重建.
+// 后缀数组建立后不再修改, 各副本共享同一份
+class DMSuffixIndex
+{
+public:
+    bool Ready() const { return m_ready; }
+    void clear();
+    void Build(const DMFileTable& table);
+
+    // 新增或被移动到 id 的项
+    void Add(const DMFileTable& table, uint32_t id);
+
+    // 在 candidates 中只保留名称可能包含 foldedPattern 的项; 只支持名称查询, 路径查询返回 false
+    bool Select(std::string_view foldedPattern, bool inPath, DMBitmap& candidates) const;
+
+    size_t SuffixCount() const { return m_data ? m_data->suffixes.size() : 0; }
+    uint64_t BuildMicroseconds() const { return m_buildMicroseconds; }
+    size_t MemoryUsage() const;
+
+private:
+    struct Data {
+        std::string text;               // 小写名称, 每个名称后跟 '\0'
+        std::vector<uint32_t> starts;   // 各项名称在 text 中的起始位置, 下标为建立时的编号
+        std::vector<uint32_t> suffixes; // 后缀起始位置, 按后缀排序
+    };
+
+    bool m_ready = false;
+    std::shared_ptr<const Data> m_data;
+    DMSharedArray<uint32_t> m_unindexed;    // 建立之后新增或被移动的项
+    uint64_t m_buildMicroseconds = 0;
+};
+
+#endif
@@ -0,0 +1,192 @@
+﻿// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "libdmfilesearch_textscan.h"
+#include "libdmfilesearch_filter.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define DM_TEXTSCAN_X64
+#include <immintrin.h>
+#endif
+
+#if defined(DM_TEXTSCAN_X64) && !defined(_MSC_VER)
+#define DM_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define DM_TARGET_AVX2
+#endif
+
+using DMFindTextFunc = size_t (*)(const char* data, size_t size, size_t from, std::string_view needle, bool foldCase);
+
+// 不区分大小写时小写字母的比较掩码: (c | 0x20) == 'a' 恰好对应 'a' 和 'A'
+static inline uint8_t DMFoldMask(char c, bool foldCase) {
+    return (foldCase && c >= 'a' && c <= 'z') ? 0x20 : 0;
+}
+
+// data 处与 needle 逐字节比较, 首尾字节已经比较过
+static inline bool DMMatchInner(const char* data, std::string_view needle, bool foldCase) {
+    if (needle.size() <= 2) {
+        return true;
+    }
+    if (!foldCase) {
+        return memcmp(data + 1, needle.data() + 1, needle.size() - 2) == 0;
+    }
+    for (size_t i = 1; i + 1 < needle.size(); ++i) {
+        if (DMFoldCase(data[i]) != needle[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static size_t DMFindTextScalar(const char* data, size_t size, size_t from, std::string_view needle, bool foldCase) {
+    const size_t length = needle.size();
+    const char first = needle[0];
+    const char last = needle[length - 1];
+    const uint8_t firstMask = DMFoldMask(first, foldCase);
+    const uint8_t lastMask = DMFoldMask(last, foldCase);
+    for (size_t pos = from; pos + length <= size; ++pos) {
+        if (firstMask == 0) {
+            // 首字节不需要折叠时用 memchr 跳到下一个候选位置
+            const void* hit = memchr(data + pos, first, size - length + 1 - pos);
+            if (hit == nullptr) {
+                break;
+            }
+            pos = static_cast<const char*>(hit) - data;
+        } else if ((data[pos] | firstMask) != first) {
+            continue;
+        }
+        if ((data[pos + length - 1] | lastMask) == last && DMMatchInner(data + pos, needle, foldCase)) {
+            return pos;
+        }
+    }
+    return std::string_view::npos;
+}
+
+#ifdef DM_TEXTSCAN_X64
+static size_t DMFindTextSSE2(const char* data, size_t size, size_t from, std::string_view needle, bool foldCase) {
+    const size_t length = needle.size();
+    const __m128i firstValue = _mm_set1_epi8(needle[0]);
+    const __m128i firstMask = _mm_set1_epi8(static_cast<char>(DMFoldMask(needle[0], foldCase)));
+    const __m128i lastValue = _mm_set1_epi8(needle[length - 1]);
+    const __m128i lastMask = _mm_set1_epi8(static_cast<char>(DMFoldMask(needle[length - 1], foldCase)));
+    size_t pos = from;
+    for (; pos + length - 1 + 16 <= size; pos += 16) {
+        __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos + length - 1));
+        __m128i match = _mm_and_si128(_mm_cmpeq_epi8(_mm_or_si128(head, firstMask), firstValue),
+            _mm_cmpeq_epi8(_mm_or_si128(tail, lastMask), lastValue));
+        uint32_t bits = static_cast<uint32_t>(_mm_movemask_epi8(match));
+        while (bits != 0) {
+            size_t hit = pos + DMCountTrailingZeros(bits);
+            if (DMMatchInner(data + hit, needle, foldCase)) {
+                return hit;
+            }
+            bits &= bits - 1;
+        }
+    }
+    return DMFindTextScalar(data, size, pos, needle, foldCase);
+}
+
+DM_TARGET_AVX2
+static size_t DMFindTextAVX2(const char* data, size_t size, size_t from, std::string_view needle, bool foldCase) {
+    const size_t length = needle.size();
+    const __m256i firstValue = _mm256_set1_epi8(needle[0]);
+    const __m256i firstMask = _mm256_set1_epi8(static_cast<char>(DMFoldMask(needle[0], foldCase)));
+    const __m256i lastValue = _mm256_set1_epi8(needle[length - 1]);
+    const __m256i lastMask = _mm256_set1_epi8(static_cast<char>(DMFoldMask(needle[length - 1], foldCase)));
+    size_t pos = from;
+    for (; pos + length - 1 + 32 <= size; pos += 32) {
+        __m256i head = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+        __m256i tail = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos + length - 1));
+        __m256i match = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_or_si256(head, firstMask), firstValue),
+            _mm256_cmpeq_epi8(_mm256_or_si256(tail, lastMask), lastValue));
+        uint32_t bits = static_cast<uint32_t>(_mm256_movemask_epi8(match));
+        while (bits != 0) {
+            size_t hit = pos + DMCountTrailingZeros(bits);
+            if (DMMatchInner(data + hit, needle, foldCase)) {
+                return hit;
+            }
+            bits &= bits - 1;
+        }
+    }
+    return DMFindTextSSE2(data, size, pos, needle, foldCase);
+}
+
+// CPU 和操作系统都支持 AVX2 (操作系统需保存 YMM 寄存器)
+static bool DMCpuHasAVX2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+struct DMTextScanDispatch {
+    DMFindTextFunc find = DMFindTextScalar;
+    const char* name = "scalar";
+
+    DMTextScanDispatch() {
+#ifdef DM_TEXTSCAN_X64
+        if (DMCpuHasAVX2()) {
+            find = DMFindTextAVX2;
+            name = "avx2";
+        } else {
+            find = DMFindTextSSE2;
+            name = "sse2";
+        }
+#endif
+    }
+};
+
+static const DMTextScanDispatch& DMGetTextScanDispatch() {
+    static const DMTextScanDispatch dispatch;
+    return dispatch;
+}
+
+size_t DMFindText(std::string_view text, size_t from, std::string_view needle, bool foldCase) {
+    if (from > text.size() || needle.size() > text.size() - from) {
+        return std::string_view::npos;
+    }
+    if (needle.empty()) {
+        return from;
+    }
+    return DMGetTextScanDispatch().find(text.data(), text.size(), from, needle, foldCase);
+}
+
+const char* DMTextScanKernel() {
+    return DMGetTextScanDispatch().name;
+}
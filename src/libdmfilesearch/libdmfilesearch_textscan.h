@@ -0,0 +1,35 @@
+// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef __LIBDMFILESEARCH_TEXTSCAN_H_INCLUDE__
+#define __LIBDMFILESEARCH_TEXTSCAN_H_INCLUDE__
+#include <cstddef>
+#include <string_view>
+
+// 在 text 中从 from 开始查找 needle, 返回起始位置, 找不到时返回 std::string_view::npos.
+// foldCase 时 needle 须已是小写, text 中的大写 ASCII 字母按小写比较, 不需要 text 的小写副本.
+// 先按 needle 的首尾两个字节成块比较 (AVX2 每次 32 字节, SSE2 每次 16 字节), 两者都相同的位置再逐字节校验.
+// 指令集在首次调用时按 CPU 选择, 其他平台使用逐字节查找
+size_t DMFindText(std::string_view text, size_t from, std::string_view needle, bool foldCase);
+
+// 当前使用的实现: avx2, sse2, scalar
+const char* DMTextScanKernel();
+
+#endif
@@ -0,0 +1,369 @@
+﻿// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "libdmfilesearch_trigram.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+
+static inline uint32_t DMTrigramKey(const char* text) {
+    return (static_cast<uint32_t>(static_cast<uint8_t>(text[0])) << 16) |
+        (static_cast<uint32_t>(static_cast<uint8_t>(text[1])) << 8) |
+        static_cast<uint32_t>(static_cast<uint8_t>(text[2]));
+}
+
+static inline bool DMTrigramHasSeparator(uint32_t trigram) {
+    for (int shift = 0; shift <= 16; shift += 8) {
+        char c = static_cast<char>((trigram >> shift) & 0xFF);
+        if (c == '/' || c == '\\') {
+            return true;
+        }
+    }
+    return false;
+}
+
+// text 中不重复的三元组
+static void DMCollectTrigrams(std::string_view text, std::vector<uint32_t>& trigrams) {
+    trigrams.clear();
+    for (size_t i = 0; i + 3 <= text.size(); ++i) {
+        trigrams.push_back(DMTrigramKey(text.data() + i));
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+}
+
+static inline void DMPutVarint(std::vector<uint8_t>& bytes, uint32_t value) {
+    while (value >= 0x80) {
+        bytes.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back(static_cast<uint8_t>(value));
+}
+
+static inline const uint8_t* DMGetVarint(const uint8_t* bytes, uint32_t& value) {
+    value = 0;
+    for (int shift = 0;; shift += 7) {
+        uint8_t byte = *bytes++;
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return bytes;
+        }
+    }
+}
+
+void DMPostingTable::Builder::Add(uint32_t trigram, uint32_t id) {
+    List& list = m_lists[trigram];
+    DMPutVarint(list.bytes, list.count == 0 ? id : id - list.last);
+    list.last = id;
+    ++list.count;
+}
+
+void DMPostingTable::Builder::Finish(DMPostingTable& table) {
+    table.clear();
+    auto frozen = std::make_shared<Frozen>();
+    size_t totalBytes = 0;
+    frozen->keys.reserve(m_lists.size());
+    for (const auto& entry : m_lists) {
+        frozen->keys.push_back(Key{entry.first, entry.second.count, 0});
+        totalBytes += entry.second.bytes.size();
+    }
+    std::sort(frozen->keys.begin(), frozen->keys.end(),
+        [](const Key& a, const Key& b) { return a.trigram < b.trigram; });
+
+    frozen->bytes.reserve(totalBytes);
+    for (Key& key : frozen->keys) {
+        List& list = m_lists[key.trigram];
+        key.offset = frozen->bytes.size();
+        frozen->bytes.insert(frozen->bytes.end(), list.bytes.begin(), list.bytes.end());
+        table.m_postings += list.count;
+        std::vector<uint8_t>().swap(list.bytes);
+    }
+    m_lists.clear();
+    table.m_frozen = std::move(frozen);
+}
+
+void DMPostingTable::clear() {
+    m_frozen.reset();
+    m_postings = 0;
+    m_extra.clear();
+    m_extraCount = 0;
+}
+
+const DMPostingTable::Key* DMPostingTable::FindKey(uint32_t trigram) const {
+    if (!m_frozen) {
+        return nullptr;
+    }
+    const std::vector<Key>& keys = m_frozen->keys;
+    auto it = std::lower_bound(keys.begin(), keys.end(), trigram,
+        [](const Key& key, uint32_t value) { return key.trigram < value; });
+    if (it == keys.end() || it->trigram != trigram) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+void DMPostingTable::Add(uint32_t trigram, uint32_t id) {
+    std::vector<uint32_t>& extra = m_extra[trigram];
+    if (extra.empty() || extra.back() < id) {
+        extra.push_back(id);
+    } else {
+        auto it = std::lower_bound(extra.begin(), extra.end(), id);
+        if (it != extra.end() && *it == id) {
+            return;
+        }
+        extra.insert(it, id);
+    }
+    ++m_extraCount;
+}
+
+void DMPostingTable::Lookup(uint32_t trigram, std::vector<uint32_t>& ids) const {
+    ids.clear();
+    if (const Key* key = FindKey(trigram)) {
+        ids.reserve(key->count);
+        const uint8_t* bytes = m_frozen->bytes.data() + key->offset;
+        uint32_t id = 0;
+        for (uint32_t i = 0; i < key->count; ++i) {
+            uint32_t delta;
+            bytes = DMGetVarint(bytes, delta);
+            id = i == 0 ? delta : id + delta;
+            ids.push_back(id);
+        }
+    }
+
+    if (const std::vector<uint32_t>* extra = m_extra.Find(trigram)) {
+        size_t middle = ids.size();
+        ids.insert(ids.end(), extra->begin(), extra->end());
+        std::inplace_merge(ids.begin(), ids.begin() + middle, ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    }
+}
+
+size_t DMPostingTable::Count(uint32_t trigram) const {
+    size_t count = 0;
+    if (const Key* key = FindKey(trigram)) {
+        count += key->count;
+    }
+    if (const std::vector<uint32_t>* extra = m_extra.Find(trigram)) {
+        count += extra->size();
+    }
+    return count;
+}
+
+size_t DMPostingTable::MemoryUsage() const {
+    size_t bytes = m_frozen ? m_frozen->keys.capacity() * sizeof(Key) + m_frozen->bytes.capacity() : 0;
+    bytes += m_extra.MemoryUsage();
+    m_extra.ForEach([&](uint32_t, const std::vector<uint32_t>& ids) {
+        bytes += ids.capacity() * sizeof(uint32_t);
+    });
+    return bytes;
+}
+
+void DMTrigramIndex::clear() {
+    m_ready = false;
+    m_names.clear();
+    m_dirs.clear();
+    m_openDirs.clear();
+    m_dirCount = 0;
+    m_dirEpoch = 0;
+    m_builtPostings = 0;
+    m_buildMicroseconds = 0;
+}
+
+void DMTrigramIndex::Build(const DMFileTable& table) {
+    auto startTime = std::chrono::steady_clock::now();
+
+    DMPostingTable::Builder builder;
+    std::vector<uint32_t> trigrams;
+    for (uint32_t id = 0; id < table.size(); ++id) {
+        DMCollectTrigrams(table.FoldedName(id), trigrams);
+        for (uint32_t trigram : trigrams) {
+            builder.Add(trigram, id);
+        }
+    }
+    builder.Finish(m_names);
+    m_builtPostings = m_names.PostingCount();
+    BuildDirectories(table);
+    m_ready = true;
+
+    m_buildMicroseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - startTime).count());
+}
+
+// 目录路径与子项名称之间的三元组都包含分隔符, 查询时跳过这些三元组即可按名称和目录路径分别判断;
+// 边界不是分隔符的目录 (非常规的路径) 无法这样判断, 单独记录
+static bool DMIsOpenDirectory(const DMFileTable& table, uint32_t dirId) {
+    std::string_view path = table.DirPath(dirId);
+    char separator = table.DirSeparator(dirId);
+    char boundary = separator != 0 ? separator : (path.empty() ? '/' : path.back());
+    return boundary != '/' && boundary != '\\';
+}
+
+void DMTrigramIndex::BuildDirectories(const DMFileTable& table) {
+    DMPostingTable::Builder builder;
+    std::vector<uint32_t> trigrams;
+    m_openDirs.clear();
+    for (uint32_t dirId = 0; dirId < table.DirCount(); ++dirId) {
+        DMCollectTrigrams(table.FoldedDirPath(dirId), trigrams);
+        for (uint32_t trigram : trigrams) {
+            builder.Add(trigram, dirId);
+        }
+        if (DMIsOpenDirectory(table, dirId)) {
+            m_openDirs.push_back(dirId);
+        }
+    }
+    builder.Finish(m_dirs);
+    m_dirCount = table.DirCount();
+    m_dirEpoch = table.DirEpoch();
+}
+
+void DMTrigramIndex::AddDirectory(const DMFileTable& table, uint32_t dirId) {
+    std::vector<uint32_t> trigrams;
+    DMCollectTrigrams(table.FoldedDirPath(dirId), trigrams);
+    for (uint32_t trigram : trigrams) {
+        m_dirs.Add(trigram, dirId);
+    }
+    if (DMIsOpenDirectory(table, dirId)) {
+        m_openDirs.push_back(dirId);
+    }
+}
+
+void DMTrigramIndex::SyncDirectories(const DMFileTable& table) {
+    if (!m_ready) {
+        return;
+    }
+    if (m_dirEpoch != table.DirEpoch()) {
+        BuildDirectories(table);
+        return;
+    }
+    for (size_t dirId = m_dirCount; dirId < table.DirCount(); ++dirId) {
+        AddDirectory(table, static_cast<uint32_t>(dirId));
+    }
+    m_dirCount = table.DirCount();
+}
+
+void DMTrigramIndex::Add(const DMFileTable& table, uint32_t id) {
+    if (!m_ready) {
+        return;
+    }
+    // 后加入的编号不压缩, 积累过多时重建
+    if (m_names.ExtraCount() > std::max<size_t>(65536, m_builtPostings / 4)) {
+        Build(table);
+        return;
+    }
+    SyncDirectories(table);
+    std::vector<uint32_t> trigrams;
+    DMCollectTrigrams(table.FoldedName(id), trigrams);
+    for (uint32_t trigram : trigrams) {
+        m_names.Add(trigram, id);
+    }
+}
+
+bool DMTrigramIndex::Select(const DMFileTable& table, std::string_view foldedPattern, bool inPath,
+    DMBitmap& candidates) const {
+    if (!m_ready) {
+        return false;
+    }
+    std::vector<uint32_t> trigrams;
+    DMCollectTrigrams(foldedPattern, trigrams);
+    if (inPath) {
+        // 跨越目录与名称边界的三元组不在任何倒排表中
+        trigrams.erase(std::remove_if(trigrams.begin(), trigrams.end(), DMTrigramHasSeparator), trigrams.end());
+        if (m_dirEpoch != table.DirEpoch() || m_dirCount != table.DirCount()) {
+            return false;
+        }
+    }
+    if (trigrams.empty()) {
+        return false;
+    }
+
+    const size_t count = candidates.size();
+    std::vector<uint32_t> ids;
+    if (!inPath) {
+        // 从最短的倒排表开始求交集
+        std::sort(trigrams.begin(), trigrams.end(),
+            [this](uint32_t a, uint32_t b) { return m_names.Count(a) < m_names.Count(b); });
+        std::vector<uint32_t> next;
+        std::vector<uint32_t> common;
+        m_names.Lookup(trigrams[0], ids);
+        for (size_t k = 1; k < trigrams.size() && !ids.empty(); ++k) {
+            m_names.Lookup(trigrams[k], next);
+            common.clear();
+            std::set_intersection(ids.begin(), ids.end(), next.begin(), next.end(), std::back_inserter(common));
+            ids.swap(common);
+        }
+
+        DMBitmap selected;
+        selected.Assign(count, false);
+        for (uint32_t id : ids) {
+            if (id < count && candidates.Test(id)) {
+                selected.Set(id);
+            }
+        }
+        candidates = std::move(selected);
+        return true;
+    }
+
+    // 路径查询: 每个三元组出现在名称中或所在目录的路径中
+    std::vector<DMBitmap> nameBits(trigrams.size());
+    std::vector<DMBitmap> dirBits(trigrams.size());
+    for (size_t k = 0; k < trigrams.size(); ++k) {
+        nameBits[k].Assign(count, false);
+        m_names.Lookup(trigrams[k], ids);
+        for (uint32_t id : ids) {
+            if (id < count) {
+                nameBits[k].Set(id);
+            }
+        }
+        dirBits[k].Assign(m_dirCount, false);
+        m_dirs.Lookup(trigrams[k], ids);
+        for (uint32_t dirId : ids) {
+            dirBits[k].Set(dirId);
+        }
+        for (uint32_t dirId : m_openDirs) {
+            dirBits[k].Set(dirId);
+        }
+    }
+
+    const DMSharedArray<uint32_t>& column = table.DirectoryColumn();
+    std::vector<uint64_t>& words = candidates.Words();
+    for (size_t w = 0; w < words.size(); ++w) {
+        uint64_t word = words[w];
+        const uint32_t* parents = word != 0 ? column.Run(w << 6) : nullptr;
+        for (size_t k = 0; k < trigrams.size() && word != 0; ++k) {
+            uint64_t keep = word & nameBits[k].Words()[w];
+            uint64_t rest = word & ~keep;
+            while (rest != 0) {
+                uint32_t bit = DMCountTrailingZeros(rest);
+                rest &= rest - 1;
+                if (dirBits[k].Test(parents[bit])) {
+                    keep |= uint64_t(1) << bit;
+                }
+            }
+            word = keep;
+        }
+        words[w] = word;
+    }
+    return true;
+}
+
+size_t DMTrigramIndex::MemoryUsage() const {
+    return m_names.MemoryUsage() + m_dirs.MemoryUsage() + m_openDirs.MemoryUsage();
+}
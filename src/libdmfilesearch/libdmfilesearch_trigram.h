@@ -0,0 +1,117 @@
+// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef __LIBDMFILESEARCH_TRIGRAM_H_INCLUDE__
+#define __LIBDMFILESEARCH_TRIGRAM_H_INCLUDE__
+#include "libdmfilesearch_filetable.h"
+#include "libdmfilesearch_filter.h"
+#include "libdmfilesearch_shared.h"
+#include <memory>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// 三元组 (连续 3 个字节) 到编号的倒排表. 建立后的倒排表按编号排序, 以差值变长编码连续存放;
+// 之后新增的编号不重新编码, 单独按三元组记录, 查询时合并.
+// 编码后的倒排表建立后不再修改, 各副本共享同一份; 新增编号的表按三元组分片共享
+class DMPostingTable
+{
+public:
+    // 编号按从小到大的顺序逐个加入各三元组
+    class Builder
+    {
+    public:
+        void Add(uint32_t trigram, uint32_t id);
+        void Finish(DMPostingTable& table);
+
+    private:
+        struct List {
+            std::vector<uint8_t> bytes;
+            uint32_t count = 0;
+            uint32_t last = 0;
+        };
+        std::unordered_map<uint32_t, List> m_lists;
+    };
+
+    void clear();
+    void Add(uint32_t trigram, uint32_t id);
+    // 取出包含 trigram 的编号, 从小到大排列 (可能含已删除的编号)
+    void Lookup(uint32_t trigram, std::vector<uint32_t>& ids) const;
+    size_t Count(uint32_t trigram) const;
+    size_t TrigramCount() const { return (m_frozen ? m_frozen->keys.size() : 0) + m_extra.size(); }
+    size_t PostingCount() const { return m_postings; }
+    size_t ExtraCount() const { return m_extraCount; }
+    size_t MemoryUsage() const;
+
+private:
+    struct Key {
+        uint32_t trigram;
+        uint32_t count;
+        uint64_t offset;    // 在 m_bytes 中的起始位置
+    };
+    struct Frozen {
+        std::vector<Key> keys;              // 按 trigram 排序
+        std::vector<uint8_t> bytes;
+    };
+    const Key* FindKey(uint32_t trigram) const;
+
+    std::shared_ptr<const Frozen> m_frozen;
+    size_t m_postings = 0;
+    DMSharedMap<uint32_t, std::vector<uint32_t>> m_extra;   // 建立之后加入的编号, 各自有序
+    size_t m_extraCount = 0;
+};
+
+// 小写名称和目录路径的三元组索引, 为子串查询缩小候选范围, 候选项仍需逐一校验.
+// 删除索引项时不修改倒排表, 被移动的项以新编号重新加入; 新增过多时整体重建
+class DMTrigramIndex
+{
+public:
+    bool Ready() const { return m_ready; }
+    void clear();
+    void Build(const DMFileTable& table);
+
+    // 新增或被移动到 id 的项
+    void Add(const DMFileTable& table, uint32_t id);
+    // 目录重新编号或新增目录后同步目录路径的倒排表
+    void SyncDirectories(const DMFileTable& table);
+
+    // 在 candidates 中只保留可能包含 foldedPattern 的项; 模式太短无法过滤时返回 false
+    bool Select(const DMFileTable& table, std::string_view foldedPattern, bool inPath, DMBitmap& candidates) const;
+
+    size_t TrigramCount() const { return m_names.TrigramCount(); }
+    uint64_t BuildMicroseconds() const { return m_buildMicroseconds; }
+    size_t MemoryUsage() const;
+
+private:
+    void BuildDirectories(const DMFileTable& table);
+    void AddDirectory(const DMFileTable& table, uint32_t dirId);
+
+    bool m_ready = false;
+    DMPostingTable m_names;         // 三元组 -> 索引项编号
+    DMPostingTable m_dirs;          // 三元组 -> 目录编号
+    DMSharedArray<uint32_t> m_openDirs; // 与子项名称的边界不是分隔符的目录, 路径查询时不过滤
+    size_t m_dirCount = 0;          // 已加入的目录数
+    uint64_t m_dirEpoch = 0;
+    size_t m_builtPostings = 0;
+    uint64_t m_buildMicroseconds = 0;
+};
+
+#endif
@@ -0,0 +1,461 @@
+﻿// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string_view>
+#include <unordered_set>
+#include <filesystem>
+
+#include "libdmfilesearch_impl.h"
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// path 位于 dir 之下 (不含 dir 本身)
+static bool DMIsUnder(const std::string& path, const std::string& dir) {
+    return path.size() > dir.size() && path.compare(0, dir.size(), dir) == 0 &&
+        (dir == "/" || path[dir.size()] == '/');
+}
+
+void DmfilesearchImpl::IndexEntry(uint32_t id) {
+    m_index->nameIndex.Insert(m_index->fileIndex, id);
+    m_index->nameOrder.Add(m_index->fileIndex, id);
+    m_index->scanIndex.Add(m_index->fileIndex, id);
+    m_index->trigramIndex.Add(m_index->fileIndex, id);
+    m_index->suffixIndex.Add(m_index->fileIndex, id);
+    if (m_pathIndexReady) {
+        m_pathIndex[m_index->fileIndex.FullPath(id)] = id;
+    }
+}
+
+// 增量更新需要按路径定位索引项, 只在开始监视或刷新时建立
+void DmfilesearchImpl::EnsurePathIndex() {
+    if (m_pathIndexReady) {
+        return;
+    }
+    m_pathIndex.clear();
+    m_pathIndex.reserve(m_index->fileIndex.size());
+    for (uint32_t i = 0; i < m_index->fileIndex.size(); ++i) {
+        m_pathIndex[m_index->fileIndex.FullPath(i)] = i;
+    }
+    m_pathIndexReady = true;
+}
+
+// 以末尾元素填补空位的方式删除, 同步修正名称索引和路径索引中被移动元素的下标
+// 与遍历时一致, 索引项计入其所在目录的挂载点, 即最长的包含该目录的挂载点
+void DmfilesearchImpl::AdjustMountEntries(std::string_view directory, int64_t delta) {
+    if (m_index->mounts.empty() || directory.empty()) {
+        return;
+    }
+    std::string absolute;
+    if (directory[0] != '/') {
+        std::error_code ec;
+        absolute = fs::absolute(fs::path(std::string(directory)), ec).lexically_normal().string();
+        directory = absolute;
+    }
+    DMIndexMount* found = nullptr;
+    for (auto& mount : m_index->mounts) {
+        const std::string& point = mount.mountPoint;
+        bool within = directory.size() >= point.size() && directory.compare(0, point.size(), point) == 0 &&
+            (directory.size() == point.size() || point.back() == '/' || directory[point.size()] == '/');
+        if (within && (!found || point.size() > found->mountPoint.size())) {
+            found = &mount;
+        }
+    }
+    if (found && (delta > 0 || found->entryCount >= static_cast<uint64_t>(-delta))) {
+        found->entryCount += delta;
+    }
+}
+
+void DmfilesearchImpl::RemoveEntries(std::vector<uint32_t>& ids) {
+    std::sort(ids.begin(), ids.end(), std::greater<uint32_t>());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    // 从大到小删除, 填补空位的末尾元素一定是未被删除的
+    for (uint32_t id : ids) {
+        uint32_t last = static_cast<uint32_t>(m_index->fileIndex.size() - 1);
+
+        AdjustMountEntries(m_index->fileIndex.DirectoryPath(id), -1);
+        m_index->nameIndex.Remove(m_index->fileIndex, id);
+        if (m_pathIndexReady) {
+            m_pathIndex.erase(m_index->fileIndex.FullPath(id));
+        }
+
+        if (id != last) {
+            m_index->nameIndex.Remove(m_index->fileIndex, last);
+            if (m_pathIndexReady) {
+                m_pathIndex[m_index->fileIndex.FullPath(last)] = id;
+            }
+        }
+        m_index->nameOrder.Remove(id, last);
+        m_index->scanIndex.Remove(m_index->fileIndex, id, last);
+        m_index->fileIndex.RemoveSwap(id);
+        if (id != last) {
+            m_index->nameIndex.Insert(m_index->fileIndex, id);
+            m_index->trigramIndex.Add(m_index->fileIndex, id);
+            m_index->suffixIndex.Add(m_index->fileIndex, id);
+        }
+    }
+    m_index->nameOrder.Maintain(m_index->fileIndex);
+    m_index->scanIndex.Sync(m_index->fileIndex);
+    m_index->trigramIndex.SyncDirectories(m_index->fileIndex);
+}
+
+// 收集位于 dirs 中任一目录之下的索引项 (不含目录本身): 先逐个目录判断, 再一次线性扫描索引项
+void DmfilesearchImpl::CollectDescendants(const std::vector<std::string>& dirs, std::vector<uint32_t>& ids) const {
+    if (dirs.empty()) {
+        return;
+    }
+    std::unordered_set<std::string_view> prefixes(dirs.begin(), dirs.end());
+
+    const DMFileTable& fileIndex = m_index->fileIndex;
+    std::vector<bool> under(fileIndex.DirCount(), false);
+    for (uint32_t dirId = 0; dirId < fileIndex.DirCount(); ++dirId) {
+        std::string_view directory = fileIndex.DirPath(dirId);
+        size_t len = directory.size();
+        for (;;) {
+            if (prefixes.count(directory.substr(0, len))) {
+                under[dirId] = true;
+                break;
+            }
+            if (len <= 1) {
+                break;
+            }
+            size_t pos = directory.rfind('/', len - 1);
+            if (pos == std::string::npos) {
+                break;
+            }
+            len = pos == 0 ? 1 : pos;
+        }
+    }
+
+    for (uint32_t i = 0; i < fileIndex.size(); ++i) {
+        if (under[fileIndex.Directory(i)]) {
+            ids.push_back(i);
+        }
+    }
+}
+
+bool DmfilesearchImpl::IsRootPath(const std::string& path) const {
+    return std::find(m_index->rootPaths.begin(), m_index->rootPaths.end(), path) != m_index->rootPaths.end();
+}
+
+// 将 paths 中每个路径与磁盘当前状态核对: 不存在或被过滤的删除, 存在的新增或更新;
+// 新出现的目录和 rescanDirs 整体重新遍历. newDirs 返回新进入索引的目录, 供监视使用
+void DmfilesearchImpl::ApplyChanges(const std::set<std::string>& paths, const std::set<std::string>& rescanDirs,
+    std::vector<std::string>& newDirs) {
+    BeginUpdate();
+    EnsurePathIndex();
+
+    struct DMPendingUpsert {
+        std::string path;
+        bool isDirectory;
+        bool descend;
+    };
+
+    std::vector<uint32_t> removed;
+    std::vector<std::string> clearDirs;
+    std::vector<DMPendingUpsert> upserts;
+    std::set<std::string> rescan(rescanDirs);
+    DMIgnoreCache ignoreCache;
+
+    for (const auto& path : paths) {
+        size_t slash = path.find_last_of('/');
+        std::string fileName = slash == std::string::npos ? path : path.substr(slash + 1);
+
+        bool exists = false;
+        bool isDirectory = false;
+        bool isSymlink = false;
+#ifndef _WIN32
+        struct stat st;
+        if (lstat(path.c_str(), &st) == 0) {
+            exists = true;
+            isSymlink = S_ISLNK(st.st_mode);
+            isDirectory = isSymlink ? (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) : S_ISDIR(st.st_mode);
+        }
+#else
+        std::error_code ec;
+        auto status = fs::symlink_status(path, ec);
+        if (!ec && fs::exists(status)) {
+            exists = true;
+            isSymlink = fs::is_symlink(status);
+            isDirectory = fs::is_directory(path, ec);
+        }
+#endif
+
+        // 根路径本身不在索引中, 被删除时清空其下所有项
+        if (IsRootPath(path)) {
+            if (!exists) {
+                clearDirs.push_back(path);
+            }
+            continue;
+        }
+
+        bool include = exists && !fileName.empty() && (m_searchOptions.includeHidden || fileName[0] != '.');
+        if (include) {
+            // 与遍历时相同, 按所在目录继承的 .gitignore/.ignore/.esignore 规则过滤
+            std::shared_ptr<const DMIgnoreRules> ignoreRules = LoadParentIgnoreRules(path, ignoreCache);
+            if (isDirectory) {
+                include = ShouldIncludeDirectory(path) && (!ignoreRules || !ignoreRules->IsIgnored(path, fileName, true));
+            } else {
+                include = ShouldIncludeFile(path, fileName, ignoreRules.get());
+            }
+        }
+
+        auto it = m_pathIndex.find(path);
+        if (!include) {
+            if (it != m_pathIndex.end()) {
+                removed.push_back(it->second);
+                if (m_index->fileIndex.IsDirectory(it->second)) {
+                    clearDirs.push_back(path);
+                }
+            }
+            continue;
+        }
+
+        bool descend = isDirectory && !isSymlink;
+        if (it != m_pathIndex.end()) {
+            // 目录变成了文件或符号链接, 原来的子项失效
+            if (m_index->fileIndex.IsDirectory(it->second) && !descend) {
+                clearDirs.push_back(path);
+            }
+        } else if (descend) {
+            rescan.insert(path);
+        }
+        upserts.push_back(DMPendingUpsert{ path, isDirectory, descend });
+    }
+
+    // 只保留最外层的待遍历目录
+    std::vector<std::string> rescanRoots;
+    for (const auto& dir : rescan) {
+        bool nested = std::any_of(rescanRoots.begin(), rescanRoots.end(),
+            [&](const std::string& outer) { return DMIsUnder(dir, outer); });
+        if (!nested) {
+            rescanRoots.push_back(dir);
+        }
+    }
+    clearDirs.insert(clearDirs.end(), rescanRoots.begin(), rescanRoots.end());
+
+    CollectDescendants(clearDirs, removed);
+    RemoveEntries(removed);
+
+    for (const auto& upsert : upserts) {
+        // 重新遍历的目录之下的路径由遍历结果覆盖
+        if (std::any_of(rescanRoots.begin(), rescanRoots.end(),
+            [&](const std::string& dir) { return DMIsUnder(upsert.path, dir); })) {
+            continue;
+        }
+        auto it = m_pathIndex.find(upsert.path);
+        uint32_t id;
+        if (it == m_pathIndex.end()) {
+            size_t slash = upsert.path.find_last_of('/');
+            DMFileInfo fileInfo;
+            fileInfo.fullPath = upsert.path;
+            fileInfo.fileName = upsert.path.substr(slash + 1);
+            fileInfo.directory = slash == 0 ? "/" : upsert.path.substr(0, slash);
+            id = m_index->fileIndex.Append(fileInfo);
+            IndexEntry(id);
+            AdjustMountEntries(fileInfo.directory, 1);
+            if (upsert.descend) {
+                newDirs.push_back(upsert.path);
+            }
+        } else {
+            id = it->second;
+        }
+
+        m_index->fileIndex.ResetType(id, upsert.isDirectory);
+        if (!m_config.index.lazyMetadata) {
+            DMFileInfo fileInfo;
+            fileInfo.fullPath = upsert.path;
+            fileInfo.isDirectory = upsert.isDirectory;
+            LoadMetadata(fileInfo);
+            m_index->fileIndex.SetMetadata(id, fileInfo.fileSize, fileInfo.modifyTime);
+        }
+    }
+
+    if (!rescanRoots.empty()) {
+        const size_t firstNew = m_index->fileIndex.size();
+        CrawlRoots(rescanRoots);
+        for (uint32_t i = static_cast<uint32_t>(firstNew); i < m_index->fileIndex.size(); ++i) {
+            IndexEntry(i);
+            if (m_index->fileIndex.IsDirectory(i)) {
+                newDirs.push_back(m_index->fileIndex.FullPath(i));
+            }
+        }
+    }
+}
+
+bool DmfilesearchImpl::ReadDirStamp(const std::string& dirPath, DMDirStamp& stamp) const {
+#ifndef _WIN32
+    struct stat st;
+    if (lstat(dirPath.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return false;
+    }
+    stamp = DMDirStampFromStat(st);
+    return true;
+#else
+    std::error_code ec;
+    if (!fs::is_directory(fs::symlink_status(dirPath, ec))) {
+        return false;
+    }
+    stamp.mtime = static_cast<int64_t>(fs::last_write_time(dirPath, ec).time_since_epoch().count());
+    stamp.ctime = stamp.mtime;
+    return !ec;
+#endif
+}
+
+void DmfilesearchImpl::CaptureDirStamps(const std::vector<std::string>& dirs) {
+    if (dirs.empty()) {
+        return;
+    }
+    BeginUpdate();
+    for (const auto& dir : dirs) {
+        DMDirStamp stamp;
+        if (ReadDirStamp(dir, stamp)) {
+            m_index->dirStamps[dir] = stamp;
+        }
+    }
+}
+
+// 只 stat 目录, 时间戳变化的目录写入 changedDirs 并更新记录; 已消失的目录由其父目录的变化处理.
+// 先只读比较, 有变化时才复制工作副本
+void DmfilesearchImpl::CollectChangedDirectories(std::vector<std::string>& changedDirs) {
+    std::vector<std::pair<std::string, DMDirStamp>> updated;
+    std::vector<std::string> vanished;
+    m_index->dirStamps.ForEach([&](const std::string& dir, const DMDirStamp& recorded) {
+        DMDirStamp stamp;
+        if (!ReadDirStamp(dir, stamp)) {
+            // 根路径没有父目录, 消失时自己核对
+            if (IsRootPath(dir)) {
+                changedDirs.push_back(dir);
+            }
+            vanished.push_back(dir);
+            return;
+        }
+        if (stamp != recorded) {
+            updated.emplace_back(dir, stamp);
+            changedDirs.push_back(dir);
+        }
+    });
+    if (updated.empty() && vanished.empty()) {
+        return;
+    }
+
+    BeginUpdate();
+    for (auto& dirStamp : updated) {
+        m_index->dirStamps[dirStamp.first] = dirStamp.second;
+    }
+    for (const auto& dir : vanished) {
+        m_index->dirStamps.Erase(dir);
+    }
+}
+
+// 变化目录的直接子项: 索引中已有的和磁盘上现有的合起来交给 ApplyChanges 核对
+void DmfilesearchImpl::ListDirectoryChanges(const std::vector<std::string>& dirs, std::set<std::string>& paths) const {
+    if (dirs.empty()) {
+        return;
+    }
+    std::unordered_set<std::string_view> dirSet(dirs.begin(), dirs.end());
+    const DMFileTable& fileIndex = m_index->fileIndex;
+    std::vector<bool> changed(fileIndex.DirCount(), false);
+    for (uint32_t dirId = 0; dirId < fileIndex.DirCount(); ++dirId) {
+        changed[dirId] = dirSet.count(fileIndex.DirPath(dirId)) > 0;
+    }
+    for (uint32_t i = 0; i < fileIndex.size(); ++i) {
+        if (changed[fileIndex.Directory(i)]) {
+            paths.insert(fileIndex.FullPath(i));
+        }
+    }
+
+    for (const auto& dir : dirs) {
+        std::error_code ec;
+        for (fs::directory_iterator it(dir, ec); !ec && it != fs::directory_iterator(); it.increment(ec)) {
+            std::string path = dir;
+            if (path.back() != '/') {
+                path.push_back('/');
+            }
+            path.append(it->path().filename().string());
+            paths.insert(std::move(path));
+        }
+    }
+}
+
+// 调用方持有 m_indexLock
+void DmfilesearchImpl::RefreshDirectories(std::vector<std::string>& newDirs) {
+    auto startTime = std::chrono::high_resolution_clock::now();
+    CompileFilters();
+
+    const size_t checkedDirs = m_index->dirStamps.size();
+    std::vector<std::string> changedDirs;
+    CollectChangedDirectories(changedDirs);
+
+    std::set<std::string> paths;
+    ListDirectoryChanges(changedDirs, paths);
+    if (!paths.empty()) {
+        ApplyChanges(paths, std::set<std::string>(), newDirs);
+    }
+
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::high_resolution_clock::now() - startTime);
+    std::cout << "增量刷新完成: 检查 " << checkedDirs << " 个目录, " << changedDirs.size()
+              << " 个有变化, 共索引 " << m_index->fileIndex.size() << " 项，耗时 " << duration.count() << "ms" << std::endl;
+}
+
+bool DMAPI DmfilesearchImpl::Refresh() {
+    std::shared_ptr<const DMIndexSnapshot> snapshot = AcquireSnapshot();
+    if (snapshot->rootPaths.empty()) {
+        std::cout << "索引为空，请先构建索引" << std::endl;
+        return false;
+    }
+    if (!snapshot->progress.complete) {
+        std::cout << "索引构建中，请稍候..." << std::endl;
+        return false;
+    }
+
+    // 旧版本索引文件没有目录时间戳, 只能完整构建
+    if (snapshot->dirStamps.empty()) {
+        std::cout << "索引中没有目录时间戳，执行完整构建" << std::endl;
+        DMStringList rootPaths = snapshot->rootPaths;
+        snapshot.reset();
+        if (rootPaths.size() == 1) {
+            BuildIndex(rootPaths[0]);
+        } else {
+            BuildIndexMultiple(rootPaths);
+        }
+        return true;
+    }
+
+    // 监视中由监视线程执行, 以便为新目录添加监视
+    if (m_watchThread.joinable()) {
+        m_refreshRequested = true;
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(m_indexLock);
+    std::vector<std::string> newDirs;
+    RefreshDirectories(newDirs);
+    PublishIndex();
+    return true;
+}
@@ -0,0 +1,723 @@
+﻿// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <iostream>
+#include <filesystem>
+
+#include "libdmfilesearch_watch.h"
+#include "libdmfilesearch_impl.h"
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/fanotify.h>
+#include <sys/vfs.h>
+#endif
+
+#if defined(__linux__) && defined(FAN_REPORT_DFID_NAME)
+#define DM_HAS_FANOTIFY 1
+#endif
+
+namespace fs = std::filesystem;
+
+#ifdef __linux__
+static const uint32_t DM_WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+    IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW;
+static const size_t DM_INOTIFY_BUFFER_SIZE = 64 * 1024;
+#endif
+
+#ifdef DM_HAS_FANOTIFY
+static const uint64_t DM_FANOTIFY_MASK = FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM | FAN_MOVED_TO |
+    FAN_ATTRIB | FAN_CLOSE_WRITE | FAN_ONDIR;
+static const size_t DM_FANOTIFY_BUFFER_SIZE = 64 * 1024;
+#endif
+
+void DMChangeSet::Clear() {
+    paths.clear();
+    rescanDirs.clear();
+    activeDirs.clear();
+    overflow = false;
+}
+
+DMInotifyWatcher::~DMInotifyWatcher() {
+    Close();
+}
+
+bool DMInotifyWatcher::Open(const std::vector<std::string>&) {
+#ifdef __linux__
+    if (m_fd >= 0) {
+        return true;
+    }
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0) {
+        std::cerr << "inotify 初始化失败: " << strerror(errno) << std::endl;
+        return false;
+    }
+    m_buffer.resize(DM_INOTIFY_BUFFER_SIZE);
+    m_failedWatches = 0;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void DMInotifyWatcher::Close() {
+#ifdef __linux__
+    if (m_fd >= 0) {
+        close(m_fd);
+        m_fd = -1;
+    }
+#endif
+    m_wdPaths.clear();
+    m_pathWds.clear();
+}
+
+bool DMInotifyWatcher::AddWatch(const std::string& dirPath) {
+#ifdef __linux__
+    int wd = inotify_add_watch(m_fd, dirPath.c_str(), DM_WATCH_MASK);
+    if (wd < 0) {
+        // 符号链接或已消失的目录不算失败
+        if (errno == ENOSPC || errno == ENOMEM) {
+            ++m_failedWatches;
+        }
+        return false;
+    }
+    // 同一目录重复添加时内核返回原来的 wd
+    auto it = m_wdPaths.find(wd);
+    if (it != m_wdPaths.end() && it->second != dirPath) {
+        m_pathWds.erase(it->second);
+    }
+    m_wdPaths[wd] = dirPath;
+    m_pathWds[dirPath] = wd;
+    return true;
+#else
+    (void)dirPath;
+    return false;
+#endif
+}
+
+void DMInotifyWatcher::RemoveWatchTree(const std::string& dirPath) {
+    auto it = m_pathWds.lower_bound(dirPath);
+    while (it != m_pathWds.end()) {
+        const std::string& path = it->first;
+        if (path.compare(0, dirPath.size(), dirPath) != 0) {
+            break;
+        }
+        if (path.size() > dirPath.size() && path[dirPath.size()] != '/') {
+            ++it;
+            continue;
+        }
+#ifdef __linux__
+        inotify_rm_watch(m_fd, it->second);
+#endif
+        m_wdPaths.erase(it->second);
+        it = m_pathWds.erase(it);
+    }
+}
+
+bool DMInotifyWatcher::ReadEvents(int timeoutMs, DMChangeSet& changes) {
+#ifdef __linux__
+    struct pollfd pfd;
+    pfd.fd = m_fd;
+    pfd.events = POLLIN;
+    int ready = poll(&pfd, 1, timeoutMs);
+    if (ready < 0) {
+        return errno == EINTR;
+    }
+    if (ready == 0) {
+        return true;
+    }
+
+    for (;;) {
+        ssize_t bytes = read(m_fd, m_buffer.data(), m_buffer.size());
+        if (bytes < 0) {
+            return errno == EAGAIN || errno == EINTR;
+        }
+        if (bytes == 0) {
+            return true;
+        }
+
+        for (ssize_t offset = 0; offset < bytes;) {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(m_buffer.data() + offset);
+            offset += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                changes.overflow = true;
+                continue;
+            }
+
+            auto it = m_wdPaths.find(event->wd);
+            if (it == m_wdPaths.end()) {
+                continue;
+            }
+            const std::string dirPath = it->second;
+
+            if (event->mask & IN_IGNORED) {
+                m_pathWds.erase(dirPath);
+                m_wdPaths.erase(it);
+                continue;
+            }
+
+            changes.activeDirs.insert(dirPath);
+
+            // 监视的目录自身被删除或移走
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+                changes.paths.insert(dirPath);
+                continue;
+            }
+            if (event->len == 0) {
+                continue;
+            }
+
+            std::string path = dirPath;
+            if (path.back() != '/') {
+                path.push_back('/');
+            }
+            path.append(event->name);
+
+            // 移走或删除的目录: watch 会跟随 inode, 必须按旧路径移除
+            if ((event->mask & IN_ISDIR) && (event->mask & (IN_MOVED_FROM | IN_DELETE))) {
+                RemoveWatchTree(path);
+            }
+            changes.paths.insert(std::move(path));
+        }
+    }
+#else
+    (void)timeoutMs;
+    (void)changes;
+    return false;
+#endif
+}
+
+DMFanotifyWatcher::~DMFanotifyWatcher() {
+    Close();
+}
+
+bool DMFanotifyWatcher::Open(const std::vector<std::string>& rootPaths) {
+#ifdef DM_HAS_FANOTIFY
+    if (m_fd >= 0) {
+        return true;
+    }
+    m_fd = fanotify_init(FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK | FAN_REPORT_DFID_NAME, O_RDONLY | O_LARGEFILE);
+    if (m_fd < 0) {
+        std::cerr << "fanotify 初始化失败: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // 每个文件系统只标记一次, 事件路径是规范化的绝对路径, 需换算回索引中的根路径形式
+    for (const auto& rootPath : rootPaths) {
+        std::error_code ec;
+        std::string canonical = fs::canonical(rootPath, ec).string();
+        if (ec) {
+            continue;
+        }
+        m_roots.emplace_back(canonical, rootPath);
+
+        struct statfs sfs;
+        if (statfs(canonical.c_str(), &sfs) != 0) {
+            continue;
+        }
+        uint64_t fsid = 0;
+        memcpy(&fsid, &sfs.f_fsid, sizeof(fsid));
+        if (m_mountFds.count(fsid)) {
+            continue;
+        }
+
+        if (fanotify_mark(m_fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, DM_FANOTIFY_MASK, AT_FDCWD, canonical.c_str()) != 0) {
+            std::cerr << "fanotify 标记文件系统失败 " << canonical << ": " << strerror(errno) << std::endl;
+            Close();
+            return false;
+        }
+        m_mountFds[fsid] = open(canonical.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+
+    m_buffer.resize(DM_FANOTIFY_BUFFER_SIZE);
+    return !m_mountFds.empty();
+#else
+    (void)rootPaths;
+    return false;
+#endif
+}
+
+void DMFanotifyWatcher::Close() {
+#ifdef DM_HAS_FANOTIFY
+    for (const auto& mountFd : m_mountFds) {
+        if (mountFd.second >= 0) {
+            close(mountFd.second);
+        }
+    }
+    if (m_fd >= 0) {
+        close(m_fd);
+        m_fd = -1;
+    }
+#endif
+    m_mountFds.clear();
+    m_handlePaths.clear();
+    m_roots.clear();
+}
+
+// 文件句柄解析为目录的绝对路径, 结果按 fsid+句柄缓存
+bool DMFanotifyWatcher::ResolveDirectory(uint64_t fsid, const void* handle, std::string& dirPath) {
+#ifdef DM_HAS_FANOTIFY
+    const struct file_handle* fileHandle = static_cast<const struct file_handle*>(handle);
+    const size_t handleSize = sizeof(struct file_handle) + fileHandle->handle_bytes;
+
+    std::string key(reinterpret_cast<const char*>(&fsid), sizeof(fsid));
+    key.append(static_cast<const char*>(handle), handleSize);
+    auto it = m_handlePaths.find(key);
+    if (it != m_handlePaths.end()) {
+        dirPath = it->second;
+        return true;
+    }
+
+    auto mountFd = m_mountFds.find(fsid);
+    if (mountFd == m_mountFds.end() || mountFd->second < 0) {
+        return false;
+    }
+
+    // open_by_handle_at 需要可写的句柄副本
+    std::vector<char> handleCopy(static_cast<const char*>(handle), static_cast<const char*>(handle) + handleSize);
+    int fd = open_by_handle_at(mountFd->second, reinterpret_cast<struct file_handle*>(handleCopy.data()),
+        O_PATH | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    char linkPath[64];
+    char target[4096];
+    snprintf(linkPath, sizeof(linkPath), "/proc/self/fd/%d", fd);
+    ssize_t len = readlink(linkPath, target, sizeof(target) - 1);
+    close(fd);
+    if (len <= 0) {
+        return false;
+    }
+    dirPath.assign(target, static_cast<size_t>(len));
+
+    if (m_handlePaths.size() >= MAX_CACHED_HANDLES) {
+        m_handlePaths.clear();
+    }
+    m_handlePaths[key] = dirPath;
+    return true;
+#else
+    (void)fsid;
+    (void)handle;
+    (void)dirPath;
+    return false;
+#endif
+}
+
+// 规范化路径在某个根路径之下时换算为索引中的路径形式
+bool DMFanotifyWatcher::MapToIndexPath(const std::string& path, std::string& indexPath) const {
+    for (const auto& root : m_roots) {
+        const std::string& canonical = root.first;
+        const std::string& original = root.second;
+        if (path != canonical && !(canonical == "/" ||
+            (path.size() > canonical.size() && path.compare(0, canonical.size(), canonical) == 0 &&
+             path[canonical.size()] == '/'))) {
+            continue;
+        }
+        std::string rest = canonical == "/" ? path : path.substr(canonical.size());
+        if (original == "/") {
+            indexPath = rest.empty() ? "/" : rest;
+        } else {
+            indexPath = original + (rest == "/" ? std::string() : rest);
+        }
+        return true;
+    }
+    return false;
+}
+
+bool DMFanotifyWatcher::ReadEvents(int timeoutMs, DMChangeSet& changes) {
+#ifdef DM_HAS_FANOTIFY
+    struct pollfd pfd;
+    pfd.fd = m_fd;
+    pfd.events = POLLIN;
+    int ready = poll(&pfd, 1, timeoutMs);
+    if (ready < 0) {
+        return errno == EINTR;
+    }
+    if (ready == 0) {
+        return true;
+    }
+
+    for (;;) {
+        ssize_t bytes = read(m_fd, m_buffer.data(), m_buffer.size());
+        if (bytes < 0) {
+            return errno == EAGAIN || errno == EINTR;
+        }
+        if (bytes == 0) {
+            return true;
+        }
+
+        const struct fanotify_event_metadata* meta = reinterpret_cast<const struct fanotify_event_metadata*>(m_buffer.data());
+        for (; FAN_EVENT_OK(meta, bytes); meta = FAN_EVENT_NEXT(meta, bytes)) {
+            if (meta->vers != FANOTIFY_METADATA_VERSION) {
+                std::cerr << "fanotify 事件版本不匹配" << std::endl;
+                return false;
+            }
+            if (meta->mask & FAN_Q_OVERFLOW) {
+                changes.overflow = true;
+                continue;
+            }
+
+            const char* info = reinterpret_cast<const char*>(meta) + meta->metadata_len;
+            const char* end = reinterpret_cast<const char*>(meta) + meta->event_len;
+            while (info + sizeof(struct fanotify_event_info_header) <= end) {
+                const struct fanotify_event_info_fid* fid = reinterpret_cast<const struct fanotify_event_info_fid*>(info);
+                if (fid->hdr.len == 0) {
+                    break;
+                }
+                info += fid->hdr.len;
+                if (fid->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME &&
+                    fid->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID) {
+                    continue;
+                }
+
+                uint64_t fsid = 0;
+                memcpy(&fsid, &fid->fsid, sizeof(fsid));
+                const struct file_handle* handle = reinterpret_cast<const struct file_handle*>(fid->handle);
+
+                std::string dirPath;
+                if (!ResolveDirectory(fsid, handle, dirPath)) {
+                    continue;
+                }
+                std::string indexDir;
+                if (!MapToIndexPath(dirPath, indexDir)) {
+                    continue;
+                }
+
+                // 目录被移走或删除后缓存的句柄路径可能已失效
+                if ((meta->mask & FAN_ONDIR) && (meta->mask & (FAN_MOVED_FROM | FAN_DELETE))) {
+                    m_handlePaths.clear();
+                }
+
+                changes.activeDirs.insert(indexDir);
+                const char* name = reinterpret_cast<const char*>(handle->f_handle) + handle->handle_bytes;
+                if (fid->hdr.info_type == FAN_EVENT_INFO_TYPE_DFID || strcmp(name, ".") == 0) {
+                    changes.paths.insert(indexDir);
+                } else {
+                    std::string path = indexDir;
+                    if (path.back() != '/') {
+                        path.push_back('/');
+                    }
+                    path.append(name);
+                    changes.paths.insert(std::move(path));
+                }
+            }
+        }
+    }
+#else
+    (void)timeoutMs;
+    (void)changes;
+    return false;
+#endif
+}
+
+DMPollWatcher::DMPollWatcher(DMPollFunction poll, uint32_t intervalSeconds)
+    : m_poll(std::move(poll)), m_interval(std::max<uint32_t>(intervalSeconds, 1)) {
+}
+
+bool DMPollWatcher::Open(const std::vector<std::string>& rootPaths) {
+    m_rootCount = rootPaths.size();
+    m_lastPoll = std::chrono::steady_clock::now();
+    return true;
+}
+
+bool DMPollWatcher::ReadEvents(int timeoutMs, DMChangeSet& changes) {
+    auto now = std::chrono::steady_clock::now();
+    if (now - m_lastPoll < m_interval) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+        return true;
+    }
+    m_poll(changes);
+    m_lastPoll = std::chrono::steady_clock::now();
+    return true;
+}
+
+// 队列溢出后无法知道丢失了哪些事件, 以各根路径下产生过事件的目录的最近公共祖先为范围重新遍历
+static std::string DMCommonAncestor(const std::string& a, const std::string& b) {
+    size_t len = 0;
+    while (len < a.size() && len < b.size() && a[len] == b[len]) {
+        ++len;
+    }
+    if (len == a.size() && (len == b.size() || b[len] == '/')) {
+        return a;
+    }
+    if (len == b.size() && a[len] == '/') {
+        return b;
+    }
+    size_t pos = a.rfind('/', len);
+    if (pos == std::string::npos) {
+        return std::string();
+    }
+    return a.substr(0, pos == 0 ? 1 : pos);
+}
+
+void DmfilesearchImpl::ResolveOverflow(DMChangeSet& changes) const {
+    for (const auto& root : m_index->rootPaths) {
+        std::string ancestor;
+        bool found = false;
+        for (const auto& dir : changes.activeDirs) {
+            if (dir == root || (dir.size() > root.size() && dir.compare(0, root.size(), root) == 0 &&
+                (root == "/" || dir[root.size()] == '/'))) {
+                ancestor = found ? DMCommonAncestor(ancestor, dir) : dir;
+                found = true;
+            }
+        }
+        if (found) {
+            changes.rescanDirs.insert(ancestor.size() < root.size() ? root : ancestor);
+        }
+    }
+
+    // 没有任何线索时只能重新遍历全部根路径
+    if (changes.rescanDirs.empty()) {
+        changes.rescanDirs.insert(m_index->rootPaths.begin(), m_index->rootPaths.end());
+    }
+    std::cout << "监视事件队列溢出, 重新遍历 " << changes.rescanDirs.size() << " 个目录" << std::endl;
+}
+
+// 与遍历策略一致: 被跳过的挂载点和 oneFileSystem 模式下其他设备上的目录不监视
+bool DmfilesearchImpl::ShouldWatchDirectory(const DMMountTable& mounts, const std::set<uint64_t>& rootDevices,
+    const std::string& dirPath) const {
+    if (!mounts.Empty()) {
+        std::string absolutePath = dirPath;
+        if (absolutePath.empty() || absolutePath[0] != '/') {
+            std::error_code ec;
+            absolutePath = fs::absolute(dirPath, ec).lexically_normal().string();
+        }
+        uint32_t mountId = mounts.FindMountPoint(absolutePath);
+        if (mountId != DMMountTable::INVALID_MOUNT &&
+            m_config.filters.excludeFsTypes.count(mounts.Entries()[mountId].fsType)) {
+            return false;
+        }
+    }
+#ifndef _WIN32
+    if (m_config.index.oneFileSystem) {
+        struct stat st;
+        if (lstat(dirPath.c_str(), &st) != 0 || !rootDevices.count(static_cast<uint64_t>(st.st_dev))) {
+            return false;
+        }
+    }
+#endif
+    return true;
+}
+
+void DmfilesearchImpl::WatchDirectories(const std::vector<std::string>& dirs) {
+    if (!m_watcher->WatchesDirectories()) {
+        return;
+    }
+
+    DMMountTable mounts;
+    mounts.Load();
+
+    std::set<uint64_t> rootDevices;
+#ifndef _WIN32
+    for (const auto& root : m_index->rootPaths) {
+        struct stat st;
+        if (stat(root.c_str(), &st) == 0) {
+            rootDevices.insert(static_cast<uint64_t>(st.st_dev));
+        }
+    }
+#endif
+
+    uint64_t failedBefore = m_watcher->FailedWatches();
+    for (const auto& dir : dirs) {
+        if (ShouldWatchDirectory(mounts, rootDevices, dir)) {
+            m_watcher->AddWatch(dir);
+        }
+    }
+    if (m_watcher->FailedWatches() > failedBefore) {
+        std::cerr << "有 " << m_watcher->FailedWatches() - failedBefore
+                  << " 个目录无法监视 (超出 fs.inotify.max_user_watches, 可改用 fanotify 后端)" << std::endl;
+    }
+}
+
+bool DMAPI DmfilesearchImpl::StartWatch() {
+#ifdef __linux__
+    if (m_watchThread.joinable()) {
+        return true;
+    }
+    if (m_index->rootPaths.empty()) {
+        std::cout << "索引为空，请先构建索引" << std::endl;
+        return false;
+    }
+    m_watcher = CreateWatcher();
+    if (!m_watcher) {
+        return false;
+    }
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(m_indexLock);
+        CompileFilters();
+        EnsurePathIndex();
+
+        std::vector<std::string> dirs(m_index->rootPaths.begin(), m_index->rootPaths.end());
+        for (uint32_t i = 0; i < m_index->fileIndex.size(); ++i) {
+            if (m_index->fileIndex.IsDirectory(i)) {
+                dirs.push_back(m_index->fileIndex.FullPath(i));
+            }
+        }
+        // 旧版本索引文件没有目录时间戳, 以当前状态为基准
+        if (m_index->dirStamps.empty()) {
+            CaptureDirStamps(dirs);
+            PublishIndex();
+        }
+        WatchDirectories(dirs);
+    }
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::high_resolution_clock::now() - startTime);
+    std::cout << "开始监视文件变更 (" << m_watcher->Name() << "): ";
+    if (m_watcher->WatchesDirectories()) {
+        std::cout << m_watcher->WatchCount() << " 个目录";
+    } else if (m_pollWatch) {
+        std::cout << m_index->dirStamps.size() << " 个目录, 每 " << m_config.index.watchPollInterval << " 秒检查一次";
+    } else {
+        std::cout << m_watcher->WatchCount() << " 个文件系统";
+    }
+    std::cout << "，耗时 " << duration.count() << "ms" << std::endl;
+
+    m_watchStop = false;
+    m_watchThread = std::thread(&DmfilesearchImpl::WatchLoop, this);
+    return true;
+#else
+    std::cerr << "当前平台不支持监视模式" << std::endl;
+    return false;
+#endif
+}
+
+void DMAPI DmfilesearchImpl::StopWatch() {
+    if (!m_watchThread.joinable()) {
+        return;
+    }
+    m_watchStop = true;
+    m_watchThread.join();
+    m_watcher->Close();
+    m_watcher.reset();
+    m_pollWatch = false;
+}
+
+// 按配置创建监视后端; fanotify 或 inotify 不可用时退化为定期比较目录时间戳
+std::unique_ptr<DMChangeWatcher> DmfilesearchImpl::CreateWatcher() {
+    std::unique_ptr<DMChangeWatcher> watcher;
+    const std::string& backend = m_config.index.watchBackend;
+    if (backend == "fanotify") {
+        watcher.reset(new DMFanotifyWatcher());
+    } else if (backend != "poll") {
+        watcher.reset(new DMInotifyWatcher());
+    }
+
+    if (watcher && !watcher->Open(m_index->rootPaths)) {
+        std::cerr << watcher->Name() << " 不可用，改为定期比较目录时间戳" << std::endl;
+        watcher.reset();
+    }
+    if (!watcher) {
+        watcher.reset(new DMPollWatcher([this](DMChangeSet& changes) { PollDirectoryChanges(changes); },
+            m_config.index.watchPollInterval));
+        watcher->Open(m_index->rootPaths);
+        m_pollWatch = true;
+    }
+    return watcher;
+}
+
+void DmfilesearchImpl::PollDirectoryChanges(DMChangeSet& changes) {
+    std::lock_guard<std::mutex> lock(m_indexLock);
+    std::vector<std::string> changedDirs;
+    CollectChangedDirectories(changedDirs);
+    ListDirectoryChanges(changedDirs, changes.paths);
+    changes.activeDirs.insert(changedDirs.begin(), changedDirs.end());
+}
+
+// 事件先在 watchBatchMs 窗口内合并, 再整批应用到索引
+void DmfilesearchImpl::WatchLoop() {
+    DMChangeSet changes;
+    auto batchStart = std::chrono::steady_clock::now();
+    auto lastRefresh = std::chrono::steady_clock::now();
+    // SetConfig 可能在其他线程修改 m_config, 监视期间使用启动时的设置
+    uint32_t batchMs = 0;
+    uint32_t rebuildInterval = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_indexLock);
+        batchMs = m_config.index.watchBatchMs;
+        rebuildInterval = m_config.index.rebuildInterval;
+    }
+    const auto batchWindow = std::chrono::milliseconds(batchMs);
+    const auto refreshInterval = std::chrono::seconds(rebuildInterval);
+
+    while (!m_watchStop.load()) {
+        // 按 rebuildInterval 定期增量刷新, 兜底事件丢失或无法监视的目录
+        bool refreshDue = rebuildInterval > 0 && !m_pollWatch &&
+            std::chrono::steady_clock::now() - lastRefresh >= refreshInterval;
+        if (refreshDue || m_refreshRequested.exchange(false)) {
+            std::lock_guard<std::mutex> lock(m_indexLock);
+            std::vector<std::string> newDirs;
+            RefreshDirectories(newDirs);
+            PublishIndex();
+            WatchDirectories(newDirs);
+            lastRefresh = std::chrono::steady_clock::now();
+        }
+
+        bool wasEmpty = changes.Empty();
+        if (!m_watcher->ReadEvents(100, changes)) {
+            std::cerr << "读取监视事件失败，停止监视" << std::endl;
+            break;
+        }
+        if (changes.Empty()) {
+            continue;
+        }
+        if (wasEmpty) {
+            batchStart = std::chrono::steady_clock::now();
+        }
+        if (std::chrono::steady_clock::now() - batchStart < batchWindow) {
+            continue;
+        }
+
+        if (changes.overflow) {
+            ResolveOverflow(changes);
+        }
+
+        std::vector<std::string> newDirs;
+        {
+            std::lock_guard<std::mutex> lock(m_indexLock);
+            ApplyChanges(changes.paths, changes.rescanDirs, newDirs);
+            WatchDirectories(newDirs);
+            // 事件已处理, 更新相关目录的时间戳, 避免下次刷新重复核对
+            CaptureDirStamps(std::vector<std::string>(changes.activeDirs.begin(), changes.activeDirs.end()));
+            PublishIndex();
+        }
+        std::cout << "已应用文件变更: " << changes.paths.size() << " 个路径";
+        if (!changes.rescanDirs.empty()) {
+            std::cout << ", 重新遍历 " << changes.rescanDirs.size() << " 个目录";
+        }
+        std::cout << std::endl;
+        changes.Clear();
+    }
+}
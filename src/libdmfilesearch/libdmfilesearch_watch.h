@@ -0,0 +1,151 @@
+// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef __LIBDMFILESEARCH_WATCH_H_INCLUDE__
+#define __LIBDMFILESEARCH_WATCH_H_INCLUDE__
+#include <map>
+#include <chrono>
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+// 一批合并后的文件系统变更, 同一路径的多次事件只保留一次
+struct DMChangeSet {
+    std::set<std::string> paths;        // 需要与磁盘状态核对的路径
+    std::set<std::string> rescanDirs;   // 需要整体重新遍历的目录
+    std::set<std::string> activeDirs;   // 产生过事件的目录, 队列溢出时据此确定重新遍历范围
+    bool overflow = false;              // 内核事件队列溢出, 有事件丢失
+
+    bool Empty() const { return paths.empty() && rescanDirs.empty() && !overflow; }
+    void Clear();
+};
+
+// 文件系统变更监视的后端
+class DMChangeWatcher
+{
+public:
+    virtual ~DMChangeWatcher() {}
+    virtual const char* Name() const = 0;
+
+    // 只报告 rootPaths 之下的变更
+    virtual bool Open(const std::vector<std::string>& rootPaths) = 0;
+    virtual void Close() = 0;
+
+    // 按目录监视的后端返回 true, 新进入索引的目录需逐个 AddWatch
+    virtual bool WatchesDirectories() const { return false; }
+    virtual bool AddWatch(const std::string&) { return false; }
+
+    // 最多等待 timeoutMs 毫秒, 把读到的事件合并到 changes
+    virtual bool ReadEvents(int timeoutMs, DMChangeSet& changes) = 0;
+
+    virtual size_t WatchCount() const = 0;
+    virtual uint64_t FailedWatches() const { return 0; }
+};
+
+// 基于 inotify 的目录监视, 每个目录一个 watch (仅 Linux)
+class DMInotifyWatcher : public DMChangeWatcher
+{
+public:
+    DMInotifyWatcher() = default;
+    ~DMInotifyWatcher() override;
+    DMInotifyWatcher(const DMInotifyWatcher&) = delete;
+    DMInotifyWatcher& operator=(const DMInotifyWatcher&) = delete;
+
+    const char* Name() const override { return "inotify"; }
+    bool Open(const std::vector<std::string>& rootPaths) override;
+    void Close() override;
+
+    // 监视目录 (不跟随符号链接), 超出 max_user_watches 时返回 false 并计数
+    bool WatchesDirectories() const override { return true; }
+    bool AddWatch(const std::string& dirPath) override;
+    // 移除目录及其所有子目录的 watch (目录被移走或删除)
+    void RemoveWatchTree(const std::string& dirPath);
+
+    bool ReadEvents(int timeoutMs, DMChangeSet& changes) override;
+
+    size_t WatchCount() const override { return m_wdPaths.size(); }
+    uint64_t FailedWatches() const override { return m_failedWatches; }
+
+private:
+    int m_fd = -1;
+    std::unordered_map<int, std::string> m_wdPaths;
+    std::map<std::string, int> m_pathWds;   // 有序, 便于按前缀移除子目录
+    std::vector<char> m_buffer;
+    uint64_t m_failedWatches = 0;
+};
+
+// 基于 fanotify (FAN_REPORT_DFID_NAME) 的整个文件系统监视, 不受 max_user_watches 限制.
+// 事件携带父目录的文件句柄和名称, 句柄经 open_by_handle_at 解析为路径后缓存 (仅 Linux, 需要 CAP_SYS_ADMIN)
+class DMFanotifyWatcher : public DMChangeWatcher
+{
+public:
+    DMFanotifyWatcher() = default;
+    ~DMFanotifyWatcher() override;
+    DMFanotifyWatcher(const DMFanotifyWatcher&) = delete;
+    DMFanotifyWatcher& operator=(const DMFanotifyWatcher&) = delete;
+
+    const char* Name() const override { return "fanotify"; }
+    bool Open(const std::vector<std::string>& rootPaths) override;
+    void Close() override;
+
+    bool ReadEvents(int timeoutMs, DMChangeSet& changes) override;
+
+    size_t WatchCount() const override { return m_mountFds.size(); }
+
+private:
+    bool ResolveDirectory(uint64_t fsid, const void* handle, std::string& dirPath);
+    bool MapToIndexPath(const std::string& path, std::string& indexPath) const;
+
+    static const size_t MAX_CACHED_HANDLES = 65536;
+
+    int m_fd = -1;
+    std::vector<std::pair<std::string, std::string>> m_roots;  // 规范化路径 -> 索引中的根路径
+    std::unordered_map<uint64_t, int> m_mountFds;               // fsid -> 该文件系统上的目录fd
+    std::unordered_map<std::string, std::string> m_handlePaths; // fsid+句柄 -> 目录路径
+    std::vector<char> m_buffer;
+};
+
+// 不支持事件通知时, 定期比较目录时间戳找出变化
+class DMPollWatcher : public DMChangeWatcher
+{
+public:
+    typedef std::function<void(DMChangeSet&)> DMPollFunction;
+
+    DMPollWatcher(DMPollFunction poll, uint32_t intervalSeconds);
+
+    const char* Name() const override { return "poll"; }
+    bool Open(const std::vector<std::string>& rootPaths) override;
+    void Close() override {}
+
+    bool ReadEvents(int timeoutMs, DMChangeSet& changes) override;
+
+    size_t WatchCount() const override { return m_rootCount; }
+
+private:
+    DMPollFunction m_poll;
+    std::chrono::seconds m_interval;
+    std::chrono::steady_clock::time_point m_lastPoll;
+    size_t m_rootCount = 0;
+};
+
+#endif
@@ -0,0 +1,201 @@
+﻿// Copyright (c) 2018 brinkqiang (brink.qiang@gmail.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "gtest.h"
+#include "dmfilesearch.h"
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <algorithm>
+#include <cctype>
+
+namespace fs = std::filesystem;
+
+// 每个用例使用独立的临时目录, 并把 HOME 指向其中, 避免读写用户的配置和索引文件
+class DMTestDir
+{
+public:
+    explicit DMTestDir(const std::string& name) {
+        m_path = (fs::temp_directory_path() / ("dmfilesearchtest_" + name)).string();
+        std::error_code ec;
+        fs::remove_all(m_path, ec);
+        fs::create_directories(m_path + "/home");
+        fs::create_directories(m_path + "/root");
+#ifdef _WIN32
+        _putenv_s("USERPROFILE", (m_path + "/home").c_str());
+#else
+        setenv("HOME", (m_path + "/home").c_str(), 1);
+#endif
+    }
+    ~DMTestDir() {
+        std::error_code ec;
+        fs::remove_all(m_path, ec);
+    }
+
+    std::string Root() const { return m_path + "/root"; }
+
+    void Write(const std::string& relative, const std::string& content = "") const {
+        fs::path path = fs::path(Root()) / relative;
+        fs::create_directories(path.parent_path());
+        std::ofstream ofs(path, std::ios::binary);
+        ofs << content;
+    }
+
+private:
+    std::string m_path;
+};
+
+struct DMModuleDeleter {
+    void operator()(Idmfilesearch* module) const { module->Release(); }
+};
+typedef std::unique_ptr<Idmfilesearch, DMModuleDeleter> DMModulePtr;
+
+// 启用忽略文件, 关闭部分发布和检查点, 使构建同步完成
+static DMModulePtr DMCreateModule(bool useIgnoreFiles) {
+    DMModulePtr module(dmfilesearchGetModule());
+    module->Init();
+    DMConfigData config = module->GetConfig();
+    config.filters.useIgnoreFiles = useIgnoreFiles;
+    config.index.progressiveInterval = 0;
+    config.index.checkpointInterval = 0;
+    config.index.checkpointFile.clear();
+    module->SetConfig(config);
+    return module;
+}
+
+// 返回相对 root 的结果路径, 已排序
+static std::vector<std::string> DMSearchPaths(Idmfilesearch* module, const std::string& root,
+    const std::string& pattern) {
+    std::unique_ptr<DMFileList> results(module->Search(pattern));
+    std::vector<std::string> paths;
+    for (const auto& file : *results) {
+        paths.push_back(file.fullPath.substr(root.size() + 1));
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+// 根目录的 .gitignore 忽略 *.o 和 build/, src/ 下另有 .esignore 忽略 *.tmp
+static void DMWriteIgnoreTree(const DMTestDir& dir) {
+    dir.Write(".gitignore", "*.o\nbuild/\n");
+    dir.Write("src/.esignore", "*.tmp\n");
+    dir.Write("src/a.c");
+    dir.Write("src/old.o");
+}
+
+// 构建后新增的文件和目录
+static void DMWriteIgnoreChanges(const DMTestDir& dir) {
+    dir.Write("src/b.c");
+    dir.Write("src/new.o");
+    dir.Write("src/new.tmp");
+    dir.Write("src/newsub/c.c");
+    dir.Write("src/newsub/inner.o");
+    dir.Write("src/build/out.c");
+}
+
+static const std::vector<std::string> DM_IGNORE_EXPECTED = { "src/a.c", "src/b.c", "src/newsub/c.c" };
+
+TEST(dmfilesearch, refresh_with_ignore_files) {
+    DMTestDir dir("refresh_ignore");
+    DMWriteIgnoreTree(dir);
+    DMModulePtr module = DMCreateModule(true);
+    module->BuildIndex(dir.Root());
+    EXPECT_EQ(DMSearchPaths(module.get(), dir.Root(), ".c"), std::vector<std::string>({ "src/a.c" }));
+
+    // 目录时间戳精度有限, 稍等再修改
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    DMWriteIgnoreChanges(dir);
+    EXPECT_TRUE(module->Refresh());
+
+    EXPECT_EQ(DMSearchPaths(module.get(), dir.Root(), ".c"), DM_IGNORE_EXPECTED);
+    EXPECT_TRUE(DMSearchPaths(module.get(), dir.Root(), ".o").empty());
+    EXPECT_TRUE(DMSearchPaths(module.get(), dir.Root(), ".tmp").empty());
+    EXPECT_TRUE(DMSearchPaths(module.get(), dir.Root(), "build").empty());
+}
+
+#ifdef __linux__
+TEST(dmfilesearch, watch_with_ignore_files) {
+    DMTestDir dir("watch_ignore");
+    DMWriteIgnoreTree(dir);
+    DMModulePtr module = DMCreateModule(true);
+    module->BuildIndex(dir.Root());
+    ASSERT_TRUE(module->StartWatch());
+
+    DMWriteIgnoreChanges(dir);
+
+    // 等待监视线程合并并应用这批变更
+    for (int i = 0; i < 50 && DMSearchPaths(module.get(), dir.Root(), ".c") != DM_IGNORE_EXPECTED; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    module->StopWatch();
+
+    EXPECT_EQ(DMSearchPaths(module.get(), dir.Root(), ".c"), DM_IGNORE_EXPECTED);
+    EXPECT_TRUE(DMSearchPaths(module.get(), dir.Root(), ".o").empty());
+    EXPECT_TRUE(DMSearchPaths(module.get(), dir.Root(), ".tmp").empty());
+    EXPECT_TRUE(DMSearchPaths(module.get(), dir.Root(), "build").empty());
+}
+#endif
+
+static std::string DMFoldName(const std::string& name) {
+    std::string folded = name;
+    std::transform(folded.begin(), folded.end(), folded.begin(), ::tolower);
+    return folded;
+}
+
+// 前缀查询的结果按编号排列, 按名称排序后同名 (不区分大小写) 的项保持原来的相对顺序
+TEST(dmfilesearch, sort_prefix_results_by_name) {
+    DMTestDir dir("sort_prefix");
+    const char* names[] = { "Foo.c", "foo.b", "FOO.a", "foo.a", "foobar", "Fo" };
+    for (const char* sub : { "d1", "d2", "d3" }) {
+        for (const char* name : names) {
+            dir.Write(std::string(sub) + "/" + name);
+        }
+    }
+    DMModulePtr module = DMCreateModule(false);
+    module->BuildIndex(dir.Root());
+
+    DMSearchOptions options;
+    options.prefixMatch = true;
+    std::unique_ptr<DMFileList> results(module->SearchWithOptions("foo", options));
+    ASSERT_EQ(results->size(), 15u);
+
+    DMFileList expected = *results;
+    std::stable_sort(expected.begin(), expected.end(), [](const DMFileInfo& a, const DMFileInfo& b) {
+        return DMFoldName(a.fileName) < DMFoldName(b.fileName);
+    });
+    module->SortResults(*results, "name");
+    ASSERT_EQ(results->size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ((*results)[i].fullPath, expected[i].fullPath);
+    }
+
+    // prefix* 走同一条路径, 排序结果相同
+    std::unique_ptr<DMFileList> globResults(module->Search("foo*"));
+    module->SortResults(*globResults, "name");
+    ASSERT_EQ(globResults->size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ((*globResults)[i].fullPath, expected[i].fullPath);
+    }
+}
@@ -3,10 +3,17 @@
 #include <vector>
 #include <sstream>
 #include <memory>
+#include <thread>
+#include <chrono>
+#include <csignal>
 #include "dmfilesearch.h"
 #include "dmfix_win.h"
 
 Idmfilesearch* g_searchEngine = nullptr;
+volatile std::sig_atomic_t g_stopWatch = 0;
+
+// 监视模式下定期保存索引的间隔 (秒)
+static const int DM_WATCH_SAVE_INTERVAL = 60;
 
 // 命令行参数结构
 struct CmdArgs {
@@ -22,6 +29,15 @@ struct CmdArgs {
     bool quickSearch = false;
     bool clearIndex = false;
     bool showVersion = false;
+    bool useIgnoreFiles = false;
+    bool oneFileSystem = false;
+    bool showStats = false;
+    bool watch = false;
+    bool refresh = false;
+    bool buildRequested = false;
+    std::string watchBackend;
+    std::string searchEngine;
+    std::vector<std::string> priorityDirectories;
     std::vector<std::string> includeExtensions;
     std::vector<std::string> excludeExtensions;
     std::vector<std::string> excludeDirectories;
@@ -46,10 +62,18 @@ void ShowHelp() {
     std::cout << "  --save FILE             保存索引到文件" << std::endl;
     std::cout << "  --load FILE             从文件加载索引" << std::endl;
     std::cout << "  --clear                 清空当前索引" << std::endl;
+    std::cout << "  --refresh               增量刷新索引 (只重新列出有变化的目录)" << std::endl;
+    std::cout << "  -x, --one-file-system   不跨越文件系统边界" << std::endl;
+    std::cout << "  --priority DIR          首次构建时优先遍历该目录 (可多次指定)" << std::endl;
+    std::cout << "  --stats                 显示索引统计 (按挂载点)" << std::endl;
+    std::cout << "  --watch                 持续监视文件变更并增量更新索引 (配合 --save 定期保存)" << std::endl;
+    std::cout << "  --watch-backend NAME    监视后端: inotify|fanotify|poll" << std::endl;
+    std::cout << "  --engine NAME           子串搜索引擎: auto|scan|trigram|suffix" << std::endl;
     
     std::cout << "\n搜索选项:" << std::endl;
     std::cout << "  -c, --case              区分大小写" << std::endl;
     std::cout << "  -w, --whole-word        全词匹配" << std::endl;
+    std::cout << "  --prefix                名称以模式开头" << std::endl;
     std::cout << "  -r, --regex             使用正则表达式" << std::endl;
     std::cout << "  -p, --path              在完整路径中搜索" << std::endl;
     std::cout << "  -d, --dirs-only         仅搜索目录" << std::endl;
@@ -61,6 +85,7 @@ void ShowHelp() {
     std::cout << "  --ext EXT               仅包含指定扩展名 (如: --ext .txt)" << std::endl;
     std::cout << "  --exclude-ext EXT       排除指定扩展名（多个扩展名用逗号分隔，如：cpp,cc,cxx）" << std::endl;
     std::cout << "  --exclude-dir DIR       排除指定目录" << std::endl;
+    std::cout << "  --ignore-files          遵循 .gitignore/.ignore/.esignore 规则" << std::endl;
     
     std::cout << "\n排序选项:" << std::endl;
     std::cout << "  --sort-by name|size|date|path  结果排序方式" << std::endl;
@@ -111,6 +136,7 @@ bool ParseArguments(int argc, char* argv[], CmdArgs& args) {
             if (i + 1 < argc) {
                 args.rootPaths.push_back(argv[++i]);
                 args.buildIndex = true;
+                args.buildRequested = true;
             } else {
                 std::cerr << "错误: " << arg << " 需要路径参数" << std::endl;
                 return false;
@@ -120,6 +146,7 @@ bool ParseArguments(int argc, char* argv[], CmdArgs& args) {
             if (i + 1 < argc) {
                 args.rootPaths = SplitString(argv[++i], ',');
                 args.buildIndex = true;
+                args.buildRequested = true;
             } else {
                 std::cerr << "错误: " << arg << " 需要路径列表参数" << std::endl;
                 return false;
@@ -152,6 +179,9 @@ bool ParseArguments(int argc, char* argv[], CmdArgs& args) {
         else if (arg == "-w" || arg == "--whole-word") {
             args.options.wholeWord = true;
         }
+        else if (arg == "--prefix") {
+            args.options.prefixMatch = true;
+        }
         else if (arg == "-r" || arg == "--regex") {
             args.options.useRegex = true;
         }
@@ -213,6 +243,45 @@ bool ParseArguments(int argc, char* argv[], CmdArgs& args) {
                 return false;
             }
         }
+        else if (arg == "--ignore-files") {
+            args.useIgnoreFiles = true;
+        }
+        else if (arg == "-x" || arg == "--one-file-system") {
+            args.oneFileSystem = true;
+        }
+        else if (arg == "--priority") {
+            if (i + 1 < argc) {
+                args.priorityDirectories.push_back(argv[++i]);
+            } else {
+                std::cerr << "错误: --priority 需要目录参数" << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--stats") {
+            args.showStats = true;
+        }
+        else if (arg == "--refresh") {
+            args.refresh = true;
+        }
+        else if (arg == "--watch") {
+            args.watch = true;
+        }
+        else if (arg == "--watch-backend") {
+            if (i + 1 < argc) {
+                args.watchBackend = argv[++i];
+            } else {
+                std::cerr << "错误: --watch-backend 需要后端名称参数" << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--engine") {
+            if (i + 1 < argc) {
+                args.searchEngine = argv[++i];
+            } else {
+                std::cerr << "错误: --engine 需要引擎名称参数" << std::endl;
+                return false;
+            }
+        }
         else if (arg == "--sort-by") {
             if (i + 1 < argc) {
                 args.sortBy = argv[++i];
@@ -241,6 +310,11 @@ bool ParseArguments(int argc, char* argv[], CmdArgs& args) {
         }
     }
     
+    // 加载索引或增量刷新时, 除非显式指定 -b/-m, 不再默认构建当前目录
+    if ((args.loadIndex || args.refresh) && !args.buildRequested) {
+        args.buildIndex = false;
+    }
+    
     return true;
 }
 
@@ -254,12 +328,68 @@ void InitializeSearchEngine() {
     }
 }
 
+void OnStopSignal(int) {
+    g_stopWatch = 1;
+}
+
+// 持续监视直到收到 SIGINT/SIGTERM, 索引有变化时定期保存
+void RunWatch(const CmdArgs& args) {
+    if (!g_searchEngine->StartWatch()) {
+        return;
+    }
+    std::signal(SIGINT, OnStopSignal);
+    std::signal(SIGTERM, OnStopSignal);
+    std::cout << "监视中，按 Ctrl+C 退出" << std::endl;
+
+    uint64_t savedGeneration = g_searchEngine->GetIndexGeneration();
+    auto lastSave = std::chrono::steady_clock::now();
+    while (!g_stopWatch) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        if (!args.saveIndex || g_searchEngine->GetIndexGeneration() == savedGeneration) {
+            continue;
+        }
+        if (std::chrono::steady_clock::now() - lastSave >= std::chrono::seconds(DM_WATCH_SAVE_INTERVAL)) {
+            savedGeneration = g_searchEngine->GetIndexGeneration();
+            g_searchEngine->SaveIndex(args.indexFile);
+            lastSave = std::chrono::steady_clock::now();
+        }
+    }
+
+    g_searchEngine->StopWatch();
+    if (args.saveIndex && g_searchEngine->GetIndexGeneration() != savedGeneration) {
+        g_searchEngine->SaveIndex(args.indexFile);
+    }
+}
+
 void ExecuteCommands(const CmdArgs& args) {
     InitializeSearchEngine();
     
     // 设置搜索选项
     g_searchEngine->SetSearchOptions(args.options);
 
+    // 命令行覆盖配置文件
+    DMConfigData config = g_searchEngine->GetConfig();
+    if (args.useIgnoreFiles) {
+        config.filters.useIgnoreFiles = true;
+    }
+    if (args.oneFileSystem) {
+        config.index.oneFileSystem = true;
+    }
+    if (!args.watchBackend.empty()) {
+        config.index.watchBackend = args.watchBackend;
+    }
+    if (!args.priorityDirectories.empty()) {
+        config.index.priorityDirectories = args.priorityDirectories;
+    }
+    if (!args.searchEngine.empty()) {
+        config.index.searchEngine = args.searchEngine;
+    }
+    // 构建后保存索引时, 中断的构建可以从索引文件旁的检查点继续
+    if (args.saveIndex && config.index.checkpointFile.empty()) {
+        config.index.checkpointFile = args.indexFile + ".ckpt";
+    }
+    g_searchEngine->SetConfig(config);
+
     // 清空过滤器
     g_searchEngine->ClearFilters();
 
@@ -304,6 +434,11 @@ void ExecuteCommands(const CmdArgs& args) {
         }
     }
     
+    // 增量刷新
+    if (args.refresh) {
+        g_searchEngine->Refresh();
+    }
+    
     // 保存索引
     if (args.saveIndex) {
         if (!g_searchEngine->SaveIndex(args.indexFile)) {
@@ -335,9 +470,18 @@ void ExecuteCommands(const CmdArgs& args) {
     }
     
     // 显示索引统计
-    uint32_t indexedCount = g_searchEngine->GetIndexedFileCount();
-    if (indexedCount > 0) {
-        std::cout << "\n当前索引包含 " << indexedCount << " 个文件/目录" << std::endl;
+    if (args.showStats) {
+        g_searchEngine->PrintIndexStats();
+    } else {
+        uint32_t indexedCount = g_searchEngine->GetIndexedFileCount();
+        if (indexedCount > 0) {
+            std::cout << "\n当前索引包含 " << indexedCount << " 个文件/目录" << std::endl;
+        }
+    }
+    
+    // 监视模式
+    if (args.watch) {
+        RunWatch(args);
     }
 }
 